@@ -138,7 +138,8 @@ static camera3_device_ops hal_dev_ops = {
 Camera3HAL::Camera3HAL(int cameraId, const hw_module_t* module) :
     mCameraId(cameraId),
     mCameraHw(nullptr),
-    mRequestThread(nullptr)
+    mRequestThread(nullptr),
+    mOpenTime(systemTime())
 {
     LOGI("@%s", __FUNCTION__);
 
@@ -174,8 +175,11 @@ status_t Camera3HAL::init(void)
         goto bail;
     }
 
-    mRequestThread = std::unique_ptr<RequestThread>(new RequestThread(mCameraId, mCameraHw));
+    mRequestThread = std::unique_ptr<RequestThread>(new RequestThread(mCameraId, mCameraHw,
+                                                                      mOpenTime));
 
+    LOGI("KPI: camera %d open took %" PRId64 " us", mCameraId,
+         (systemTime() - mOpenTime) / 1000);
     return NO_ERROR;
 
 bail:
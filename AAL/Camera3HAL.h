@@ -69,6 +69,7 @@ private:
     int mCameraId;
     ICameraHw *mCameraHw;
     std::unique_ptr<RequestThread> mRequestThread;
+    nsecs_t mOpenTime;  /*!< systemTime() when the device was opened */
     camera3_device_t   mDevice;
 };
 
@@ -44,7 +44,8 @@ Camera3Request::Camera3Request():
         mCallback(nullptr),
         mRequestId(0),
         mCameraId(-1),
-        mSequenceId(-1)
+        mSequenceId(-1),
+        mArrivalTime(0)
 {
     LOGI("@%s Creating request with pointer %p", __FUNCTION__, this);
     deInit();
@@ -89,7 +90,7 @@ void Camera3Request::dumpSetting()
 
         camera_metadata_entry_t entry;
         uint8_t intent = 0;
-        entry = mSettings.find(ANDROID_CONTROL_CAPTURE_INTENT);
+        entry = mSettings->find(ANDROID_CONTROL_CAPTURE_INTENT);
         if (entry.count == 1) {
             intent = entry.data.u8[0];
         }
@@ -100,7 +101,7 @@ void Camera3Request::dumpSetting()
         LOGI("%s filename is %s", __FUNCTION__, fileName.data());
         int fd = open(fileName.data(), O_RDWR | O_CREAT, 0666);
         if (fd != -1) {
-            mSettings.dump(fd, 2);
+            mSettings->dump(fd, 2);
         } else {
             LOGE("dumpSetting: open failed, errmsg: %s\n", strerror(errno));
         }
@@ -124,7 +125,7 @@ void Camera3Request::dumpResults()
 
         camera_metadata_entry_t entry;
         uint8_t intent = 0;
-        entry = mSettings.find(ANDROID_CONTROL_CAPTURE_INTENT);
+        entry = mSettings->find(ANDROID_CONTROL_CAPTURE_INTENT);
         if (entry.count == 1) {
             intent = entry.data.u8[0];
         }
@@ -153,7 +154,7 @@ Camera3Request::deInit()
     mOutStreams.clear();
     mInitialized = false;
     mMembers.mSettings.clear();
-    mSettings.clear();
+    mSettings.reset();
     mOutputBuffers.clear();
     mInputBuffer.reset();
     mBuffersPerFormat.clear();
@@ -163,7 +164,8 @@ Camera3Request::deInit()
 status_t
 Camera3Request::init(camera3_capture_request* req,
                      IRequestCallback* cb,
-                     CameraMetadata &settings, int cameraId)
+                     const std::shared_ptr<const CameraMetadata> &settings,
+                     int cameraId)
 {
     status_t status = NO_ERROR;
     PERFORMANCE_HAL_ATRACE_PARAM1("reqId", req->frame_number);
@@ -258,9 +260,10 @@ Camera3Request::init(camera3_capture_request* req,
 
     mRequestId = req->frame_number;
     mCameraId = cameraId;
+    mArrivalTime = systemTime();
     mRequest3 = *req;
     mCallback = cb;
-    mSettings = settings;   // Read only setting metadata buffer
+    mSettings = settings;   // Read only setting metadata buffer, not copied
     mInitialized = true;
     mError = false;
     mMetadtaFilled = false;
@@ -421,7 +424,13 @@ Camera3Request::getAndWaitforFilledResults(unsigned int index)
 const CameraMetadata*
 Camera3Request::getSettings() const
 {
-    return mInitialized? &mSettings : nullptr;
+    return mInitialized? mSettings.get() : nullptr;
+}
+
+std::shared_ptr<const CameraMetadata>
+Camera3Request::getSharedSettings() const
+{
+    return mInitialized? mSettings : nullptr;
 }
 
 /******************************************************************************
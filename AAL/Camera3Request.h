@@ -27,6 +27,7 @@
 
 #include "CameraStreamNode.h"
 #include "CameraBuffer.h"
+#include "Utils.h"
 USING_METADATA_NAMESPACE;
 NAMESPACE_DECLARATION {
 
@@ -109,7 +110,9 @@ public:
     Camera3Request();
     virtual ~Camera3Request();
     status_t init(camera3_capture_request* req,
-                  IRequestCallback* cb, CameraMetadata &settings, int cameraId);
+                  IRequestCallback* cb,
+                  const std::shared_ptr<const CameraMetadata> &settings,
+                  int cameraId);
     void deInit();
 
     /* access methods */
@@ -123,6 +126,8 @@ public:
     void notifyFinalmetaFilled();
     CameraMetadata* getAndWaitforFilledResults(unsigned int index);
     const CameraMetadata* getSettings() const;
+    /* the same settings object for as long as they do not change */
+    std::shared_ptr<const CameraMetadata> getSharedSettings() const;
     bool isAnyBufActive();
     int waitAllBufsSignaled();
 
@@ -135,6 +140,8 @@ public:
 
     void setSequenceId(int sequenceId) {mSequenceId = sequenceId; }
     int sequenceId() const {return mSequenceId; }
+    /* systemTime() when the framework queued the request */
+    nsecs_t arrivalTime() const {return mArrivalTime; }
     void dumpSetting();
     void dumpResults();
 
@@ -172,9 +179,11 @@ private:  /* types and members */
     bool mError;
 
     bool  mInitialized;
-    CameraMetadata mSettings; /* request settings metadata. Always contains a
-                                    valid metadata buffer even if the request
-                                    had nullptr */
+    std::shared_ptr<const CameraMetadata> mSettings; /* request settings metadata.
+                                    Always contains a valid metadata buffer even
+                                    if the request had nullptr. Shared with the
+                                    requests before and after it that have the
+                                    same settings */
      std::mutex mAccessLock;  /* protects mInBuffers, mOutBuffers and mRequestId,
                             to ensure thread safe access to private
                             camera3_capture_request and camera3_stream_buffer
@@ -182,6 +191,7 @@ private:  /* types and members */
     unsigned int mRequestId;    /* the frame_count from the original request struct */
     int mCameraId;
     int mSequenceId;
+    nsecs_t mArrivalTime;
     camera3_capture_request mRequest3;
     std::vector<camera3_stream_buffer> mOutBuffers;
     std::vector<camera3_stream_buffer> mInBuffers;
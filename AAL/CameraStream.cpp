@@ -29,6 +29,7 @@ CameraStream::CameraStream(int seqNo, camera3_stream_t * stream,
                                                           mSeqNo(seqNo),
                                                           mCallback(callback),
                                                           mOutputBuffersInHal(0),
+                                                          mMappingCache(std::make_shared<BufferMappingCache>()),
                                                           mStream3(stream),
                                                           mFrameCount(0),
                                                           mLastFrameCount(0)
@@ -87,6 +87,10 @@ public:
     int32_t outBuffersInHal() { return mOutputBuffersInHal; }
     int getStreamType() { return mStreamType; }
 
+    /* gralloc registrations and mappings of the buffers of this stream */
+    std::shared_ptr<BufferMappingCache> mappingCache() const { return mMappingCache; }
+    void clearMappingCache() { mMappingCache->clear(); }
+
 private: /* Methods */
     // CameraStreamNode override API
     virtual status_t configure(void);
@@ -100,6 +104,7 @@ private: /* Members */
     std::atomic<int32_t> mOutputBuffersInHal;
 
     std::vector<std::shared_ptr<CameraBuffer> > mCamera3Buffers;
+    std::shared_ptr<BufferMappingCache> mMappingCache;
     camera3_stream_t * mStream3; /* one stream of config_streams from client which not owned here */
     std::vector<Camera3Request*>      mPendingRequests;
     std::mutex mPendingLock; /* Protects mPendingRequests */
@@ -33,7 +33,7 @@ const metadata_value_t streamTypeValues[] = {
     { "BIDIRECTIONAL", CAMERA3_STREAM_BIDIRECTIONAL }
 };
 
-RequestThread::RequestThread(int cameraId, ICameraHw *aCameraHW) :
+RequestThread::RequestThread(int cameraId, ICameraHw *aCameraHW, nsecs_t openTime) :
     MessageThread(this, "Cam3ReqThread"),
     mCameraId(cameraId),
     mCameraHw(aCameraHW),
@@ -46,7 +46,8 @@ RequestThread::RequestThread(int cameraId, ICameraHw *aCameraHW) :
     mInitialized(false),
     mResultProcessor(nullptr),
     mPipelineDepth(-1),
-    mStreamSeqNo(0)
+    mStreamSeqNo(0),
+    mOpenTime(openTime)
 {
     LOGD("@%s", __FUNCTION__);
 
@@ -89,7 +90,7 @@ RequestThread::init(const camera3_callback_ops_t *callback_ops)
     mPipelineDepth = mPipelineDepth > 0 ? mPipelineDepth : DEFAULT_PIPELINE_DEPTH;
     LOGD("@%s : Pipeline Depth :%d", __FUNCTION__, mPipelineDepth);
 
-    mResultProcessor = new ResultProcessor(this, callback_ops);
+    mResultProcessor = new ResultProcessor(this, callback_ops, mOpenTime);
     mCameraHw->registerErrorCallback(mResultProcessor);
     mActiveRequest.reserve(MAX_REQUEST_IN_PROCESS_NUM);
     mActiveRequest.clear();
@@ -142,7 +143,7 @@ RequestThread::handleConfigureStreams(Message & msg)
     LOGI("@%s", __FUNCTION__);
 
     status_t status = NO_ERROR;
-    mLastSettings.clear();
+    mLastSettings.reset();
     mWaitingRequest = nullptr;
 
     uint32_t streamsNum = msg.data.streams.list->num_streams;
@@ -208,6 +209,11 @@ RequestThread::handleConfigureStreams(Message & msg)
     deleteStreams(true);
 
     waitRequestsDrain();
+
+    // buffers of the kept streams may be reallocated by the framework
+    for (unsigned int i = 0; i < mStreams.size(); i++)
+        static_cast<CameraStream *>(mStreams.at(i)->priv)->clearMappingCache();
+
     status = mCameraHw->configStreams(mStreams, operation_mode);
     if (status != NO_ERROR) {
         LOGE("Error configuring the streams @%s:%d", __FUNCTION__, __LINE__);
@@ -282,11 +288,18 @@ RequestThread::handleProcessCaptureRequest(Message & msg)
      * check that now.
      */
     if (msg.data.request3.request3->settings) {
-        MetadataHelper::dumpMetadata(msg.data.request3.request3->settings);
-        // This assignment implies a memcopy.
-        // mLastSettings has a copy of the current settings
-        mLastSettings = msg.data.request3.request3->settings;
-    } else if (mLastSettings.isEmpty()) {
+        const camera_metadata_t *settings = msg.data.request3.request3->settings;
+        MetadataHelper::dumpMetadata(settings);
+        // keep sharing the copy we have if the settings did not change, that
+        // tells the PSL they are the same without comparing them again
+        if (mLastSettings.get() == nullptr ||
+            !MetadataHelper::sameMetadata(*mLastSettings, settings)) {
+            // This assignment implies a memcopy.
+            std::shared_ptr<CameraMetadata> copy = std::make_shared<CameraMetadata>();
+            *copy = settings;
+            mLastSettings = copy;
+        }
+    } else if (mLastSettings.get() == nullptr || mLastSettings->isEmpty()) {
         status = BAD_VALUE;
         LOGE("ERROR: nullptr settings for the first request!");
         goto badRequest;
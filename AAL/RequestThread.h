@@ -36,7 +36,7 @@ NAMESPACE_DECLARATION {
 class RequestThread: public IMessageHandler,
                      public MessageThread {
 public:
-    RequestThread(int cameraId, ICameraHw *aCameraHW);
+    RequestThread(int cameraId, ICameraHw *aCameraHW, nsecs_t openTime);
     virtual ~RequestThread();
 
     status_t init(const camera3_callback_ops_t *callback_ops);
@@ -160,7 +160,9 @@ private:  /* members */
                                            captures to be finished.
                                            It is one item from mRequestsPool */
     int mBlockAction;   /*!< the action if request is blocked */
-    CameraMetadata mLastSettings;
+    /* settings of the last request that had some, shared read only with the
+       requests using them */
+    std::shared_ptr<const CameraMetadata> mLastSettings;
 
     bool mInitialized;  /*!< tracking the status of the RequestThread */
     /* *********************************************************************
@@ -175,6 +177,7 @@ private:  /* members */
     std::vector<Camera3Request*> mActiveRequest;
     uint8_t mPipelineDepth;
     unsigned int mStreamSeqNo;
+    nsecs_t mOpenTime;  /*!< systemTime() when the device was opened */
 
 };
 
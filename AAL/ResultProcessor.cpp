@@ -26,14 +26,16 @@
 NAMESPACE_DECLARATION {
 
 ResultProcessor::ResultProcessor(RequestThread * aReqThread,
-                                 const camera3_callback_ops_t * cbOps) :
+                                 const camera3_callback_ops_t * cbOps,
+                                 nsecs_t openTime) :
     mRequestThread(aReqThread),
     mMessageQueue("ResultProcessor", MESSAGE_ID_MAX),
     mMessageThread(new MessageThread(this,"ResultProcessor")),
     mCallbackOps(cbOps),
     mThreadRunning(true),
     mPartialResultCount(0),
-    mNextRequestId(0)
+    mNextRequestId(0),
+    mOpenTime(openTime)
 {
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
     mReqStatePool.init(MAX_REQUEST_IN_TRANSIT);
@@ -140,37 +142,50 @@ void ResultProcessor::messageThreadLoop(void)
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
 
     mThreadRunning = true;
+    std::vector<Message> msgs;
     while (mThreadRunning) {
-        status_t status = NO_ERROR;
-        Message msg;
-        mMessageQueue.receive(&msg);
-        PERFORMANCE_HAL_ATRACE_PARAM1("msg", msg.id);
-        switch (msg.id) {
-        case MESSAGE_ID_EXIT:
-            status = handleMessageExit();
-            break;
-        case MESSAGE_ID_SHUTTER_DONE:
-            status = handleShutterDone(msg);
-            break;
-        case MESSAGE_ID_METADATA_DONE:
-            status = handleMetadataDone(msg);
-            break;
-        case MESSAGE_ID_BUFFER_DONE:
-            status = handleBufferDone(msg);
-            break;
-        case MESSAGE_ID_REGISTER_REQUEST:
-            status = handleRegisterRequest(msg);
-            break;
-        case MESSAGE_ID_DEVICE_ERROR:
-            handleDeviceError();
-            break;
-        default:
-           LOGE("Wrong message id %d", msg.id);
-           status = BAD_VALUE;
-           break;
+        /*
+         * shutter, metadata and buffer done events of a frame usually arrive
+         * in a burst, handle all of them with a single wakeup
+         */
+        mMessageQueue.receiveAll(&msgs);
+        PERFORMANCE_HAL_ATRACE_PARAM1("batch", msgs.size());
+        for (size_t i = 0; i < msgs.size() && mThreadRunning; i++) {
+            handleMessage(msgs[i]);
         }
-        mMessageQueue.reply(msg.id, status);
+        msgs.clear();
+    }
+}
+
+void ResultProcessor::handleMessage(Message &msg)
+{
+    status_t status = NO_ERROR;
+    PERFORMANCE_HAL_ATRACE_PARAM1("msg", msg.id);
+    switch (msg.id) {
+    case MESSAGE_ID_EXIT:
+        status = handleMessageExit();
+        break;
+    case MESSAGE_ID_SHUTTER_DONE:
+        status = handleShutterDone(msg);
+        break;
+    case MESSAGE_ID_METADATA_DONE:
+        status = handleMetadataDone(msg);
+        break;
+    case MESSAGE_ID_BUFFER_DONE:
+        status = handleBufferDone(msg);
+        break;
+    case MESSAGE_ID_REGISTER_REQUEST:
+        status = handleRegisterRequest(msg);
+        break;
+    case MESSAGE_ID_DEVICE_ERROR:
+        handleDeviceError();
+        break;
+    default:
+       LOGE("Wrong message id %d", msg.id);
+       status = BAD_VALUE;
+       break;
     }
+    mMessageQueue.reply(msg.id, status);
 }
 
 status_t ResultProcessor::shutterDone(Camera3Request* request,
@@ -606,6 +621,12 @@ void ResultProcessor::processCaptureResult(RequestState_t* reqState, camera3_cap
     }
 
     mCallbackOps->process_capture_result(mCallbackOps, result);
+
+    if (mOpenTime && result->num_output_buffers > 0) {
+        LOGI("KPI: camera %d open to first frame %" PRId64 " us",
+             reqState->request->getCameraId(), (systemTime() - mOpenTime) / 1000);
+        mOpenTime = 0;
+    }
 }
 
 /**
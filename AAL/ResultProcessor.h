@@ -58,7 +58,8 @@ class Camera3Request;
 class ResultProcessor : public IErrorCallback, public IRequestCallback, public IMessageHandler {
 public:
     ResultProcessor(RequestThread * aReqThread,
-                    const camera3_callback_ops_t * cbOps);
+                    const camera3_callback_ops_t * cbOps,
+                    nsecs_t openTime);
     virtual ~ResultProcessor();
     status_t requestExitAndWait();
     status_t registerRequest(Camera3Request *request);
@@ -165,6 +166,7 @@ private:  /* types  and constants */
 private:  /* methods */
     /* IMessageHandler overloads */
     virtual void messageThreadLoop(void);
+    void handleMessage(Message &msg);
     status_t handleMessageExit();
     status_t handleShutterDone(Message &msg);
     status_t handleMetadataDone(Message &msg);
@@ -195,6 +197,8 @@ private:  /* members */
     typedef std::pair<int, RequestState_t*> RequestsInTransitPair;
     unsigned int mPartialResultCount;
     int mNextRequestId;     /*!> used to ensure shutter callbacks are sequential*/
+    nsecs_t mOpenTime;      /*!> when the device was opened, 0 once the first
+                                 frame is returned */
     /*!> Sorted List of request id's that have metadata ready for return.
          The metadata for that request id should be present in the mRequestInTransit vector. */
     std::list<int> mRequestsPendingMetaReturn;
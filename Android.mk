@@ -54,7 +54,15 @@ MEDIACONTROLLERSRC = common/mediacontroller/MediaController.cpp \
                      common/mediacontroller/MediaEntity.cpp
 
 IMAGEPROCESSSRC = common/imageProcess/ColorConverter.cpp \
-                  common/imageProcess/ImageScalerCore.cpp
+                  common/imageProcess/ColorConvertKernels.cpp \
+                  common/imageProcess/ImageScalerCore.cpp \
+                  common/imageProcess/StripeExecutor.cpp
+
+# in-process rkisp1 kernel stand-in for running the HAL without camera
+# hardware, left out of user builds
+ifneq ($(filter eng userdebug,$(TARGET_BUILD_VARIANT)),)
+VIRTUALDEVSRC = common/virtualdev/VirtualKernel.cpp
+endif
 
 COMMONSRC = common/SysCall.cpp \
             common/Camera3V4l2Format.cpp \
@@ -76,11 +84,13 @@ JPEGSRC = common/jpeg/ExifCreater.cpp \
           common/jpeg/EXIFMaker.cpp \
           common/jpeg/EXIFMetaData.cpp \
           common/jpeg/ImgEncoderCore.cpp \
+          common/jpeg/EncodeBufferArena.cpp \
           common/jpeg/ImgEncoder.cpp \
           common/jpeg/JpegMakerCore.cpp \
           common/jpeg/ImgHWEncoder.cpp \
           common/jpeg/JpegMaker.cpp \
-          common/jpeg/jpeg_compressor.cpp
+          common/jpeg/jpeg_compressor.cpp \
+          common/jpeg/JpegStripEncoder.cpp
 
 GCSSSRC = common/gcss/graph_query_manager.cpp \
           common/gcss/gcss_item.cpp \
@@ -96,6 +106,7 @@ LOCAL_SRC_FILES := \
     $(PLATFORMDATASRC) \
     $(MEDIACONTROLLERSRC) \
     $(IMAGEPROCESSSRC) \
+    $(VIRTUALDEVSRC) \
     $(COMMONSRC) \
     $(JPEGSRC) \
     $(PSLSRC) \
@@ -151,6 +162,11 @@ ifeq ($(strip $(Have3AControlLoop)), true)
 CPPHACKS += \
     -DHAVE_3A_CONTROL_LOOP
 endif
+
+ifneq ($(strip $(VIRTUALDEVSRC)),)
+CPPHACKS += \
+    -DCAMERA_VIRTUAL_KERNEL
+endif
 LOCAL_CFLAGS += -Wno-error
 LOCAL_CPPFLAGS := $(CPPHACKS)
 
@@ -178,6 +194,7 @@ ALLINCLUDES = \
               -I$(LOCAL_PATH)/common/3a \
               -I$(LOCAL_PATH)/common/mediacontroller \
               -I$(LOCAL_PATH)/common/v4l2dev \
+              -I$(LOCAL_PATH)/common/virtualdev \
               -I$(LOCAL_PATH)/AAL \
               -I$(LOCAL_PATH)/common/imageProcess \
               -I$(LOCAL_PATH)/common/jpeg \
@@ -234,4 +251,6 @@ LOCAL_MODULE:= camera.$(TARGET_BOARD_HARDWARE)
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/tools/benchmark/Android.mk
 endif
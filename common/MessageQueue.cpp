@@ -21,8 +21,17 @@ NAMESPACE_DECLARATION {
 
 template <class MessageType, class MessageId>
 MessageQueue<MessageType, MessageId>::MessageQueue(const char*name,
-                                             int numReply):
+                                             int numReply,
+                                             unsigned int ringCapacity):
     mName(name)
+    ,mRing(nullptr)
+    ,mRingMask(0)
+    ,mRingHead(0)
+    ,mRingTail(0)
+    ,mConsumerWaiting(false)
+    ,mProducerWaiting(false)
+    ,mRingHasDrops(false)
+    ,mRingProducer(std::thread::id())
     ,mNumReply(numReply)
     ,mReplyMutex(nullptr)
     ,mReplyCondition(nullptr)
@@ -33,6 +42,14 @@ MessageQueue<MessageType, MessageId>::MessageQueue(const char*name,
         mReplyCondition = new std::condition_variable[numReply];
         mReplyStatus = new status_t[numReply];
     }
+
+    if (ringCapacity > 0) {
+        unsigned int capacity = 1;
+        while (capacity < ringCapacity)
+            capacity <<= 1;
+        mRing = new MessageType[capacity];
+        mRingMask = capacity - 1;
+    }
 }
 
 template <class MessageType, class MessageId>
@@ -54,6 +71,9 @@ MessageQueue<MessageType, MessageId>::~MessageQueue()
         delete [] mReplyStatus;
         mReplyStatus = nullptr;
     }
+
+    delete [] mRing;
+    mRing = nullptr;
 }
 
 template <class MessageType, class MessageId>
@@ -75,7 +95,15 @@ status_t MessageQueue<MessageType, MessageId>::send(MessageType *msg,
         return BAD_VALUE;
     }
 
-    {
+    if (mRing) {
+        if (!ringIsProducer())
+            return INVALID_OPERATION;
+        if (notDefReplyId) {
+            std::lock_guard<std::mutex> l(mReplyMutex[replyId]);
+            mReplyStatus[replyId] = WOULD_BLOCK;
+        }
+        ringSend(msg);
+    } else {
         std::lock_guard<std::mutex> l(mQueueMutex);
         MessageType data = *msg;
         mList.push_front(data);
@@ -109,7 +137,17 @@ status_t MessageQueue<MessageType, MessageId>::remove(MessageId id,
     if(isEmpty())
         return status;
 
-    {
+    if (mRing) {
+        // the consumer owns the ring slots, let it drop the messages
+        if (vect) {
+            LOGE("Camera_MessageQueue error: %s can't return removed messages in ring mode", mName);
+            return INVALID_OPERATION;
+        }
+        std::lock_guard<std::mutex> l(mQueueMutex);
+        RingDrop drop = { id, mRingTail.load() };
+        mRingDrops.push_back(drop);
+        mRingHasDrops = true;
+    } else {
         std::lock_guard<std::mutex> l(mQueueMutex);
         typename std::list<MessageType>::iterator it = mList.begin();
         while (it != mList.end()) {
@@ -138,11 +176,19 @@ status_t MessageQueue<MessageType, MessageId>::receive(MessageType *msg,
             unsigned int timeout_ms)
 {
     status_t status = NO_ERROR;
+
+    if (mRing)
+        return ringReceive(msg, timeout_ms);
+
     std::unique_lock<std::mutex> l(mQueueMutex);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
 
     while (isEmptyLocked()) {
         if (timeout_ms) {
-            mQueueCondition.wait_for(l, std::chrono::milliseconds(timeout_ms));
+            if (mQueueCondition.wait_until(l, deadline) == std::cv_status::timeout &&
+                isEmptyLocked())
+                return TIMED_OUT;
         } else {
             mQueueCondition.wait(l);
         }
@@ -152,11 +198,179 @@ status_t MessageQueue<MessageType, MessageId>::receive(MessageType *msg,
         }
     }
 
-    *msg = *(--mList.end());
-    mList.erase(--mList.end());
+    *msg = std::move(mList.back());
+    mList.pop_back();
     return status;
 }
 
+template <class MessageType, class MessageId>
+status_t MessageQueue<MessageType, MessageId>::receiveBatch(std::vector<MessageType> *msgs,
+            unsigned int max, unsigned int timeout_ms)
+{
+    MessageType msg;
+
+    msgs->clear();
+
+    if (mRing) {
+        if (ringReceive(&msg, timeout_ms) == TIMED_OUT)
+            return TIMED_OUT;
+        msgs->push_back(std::move(msg));
+        while ((max == 0 || msgs->size() < max) && ringPop(&msg))
+            msgs->push_back(std::move(msg));
+        return NO_ERROR;
+    }
+
+    std::unique_lock<std::mutex> l(mQueueMutex);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+
+    while (isEmptyLocked()) {
+        if (timeout_ms) {
+            if (mQueueCondition.wait_until(l, deadline) == std::cv_status::timeout &&
+                isEmptyLocked())
+                return TIMED_OUT;
+        } else {
+            mQueueCondition.wait(l);
+        }
+
+        if (isEmptyLocked()) {
+            LOGE("Camera_MessageQueue - woke with mCount == 0\n");
+        }
+    }
+
+    // oldest messages are at the back of the list
+    while (!mList.empty() && (max == 0 || msgs->size() < max)) {
+        msgs->push_back(std::move(mList.back()));
+        mList.pop_back();
+    }
+
+    return NO_ERROR;
+}
+
+/*
+ * The first thread that sends becomes the producer of the ring, a send from
+ * any other thread is refused instead of corrupting the ring.
+ */
+template <class MessageType, class MessageId>
+bool MessageQueue<MessageType, MessageId>::ringIsProducer()
+{
+    std::thread::id self = std::this_thread::get_id();
+    std::thread::id producer = std::thread::id();
+    if (mRingProducer.compare_exchange_strong(producer, self) || producer == self)
+        return true;
+
+    LOGE("Camera_MessageQueue error: %s is a single producer ring, send refused", mName);
+    return false;
+}
+
+template <class MessageType, class MessageId>
+status_t MessageQueue<MessageType, MessageId>::ringSend(MessageType *msg)
+{
+    unsigned int tail = mRingTail.load(std::memory_order_relaxed);
+
+    if (tail - mRingHead.load() > mRingMask) {
+        LOGD("Camera_MessageQueue: %s ring full, wait for consumer", mName);
+        std::unique_lock<std::mutex> l(mQueueMutex);
+        mProducerWaiting = true;
+        mRingSpaceCondition.wait(l, [&] { return tail - mRingHead.load() <= mRingMask; });
+        mProducerWaiting = false;
+    }
+
+    mRing[tail & mRingMask] = *msg;
+    mRingTail.store(tail + 1);
+
+    // only pay for the wakeup if the consumer is about to sleep
+    if (mConsumerWaiting.load()) {
+        std::lock_guard<std::mutex> l(mQueueMutex);
+        mQueueCondition.notify_one();
+    }
+
+    return NO_ERROR;
+}
+
+template <class MessageType, class MessageId>
+status_t MessageQueue<MessageType, MessageId>::ringReceive(MessageType *msg,
+            unsigned int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+
+    while (!ringPop(msg)) {
+        std::unique_lock<std::mutex> l(mQueueMutex);
+        mConsumerWaiting = true;
+        if (mRingHead.load() == mRingTail.load()) {
+            if (timeout_ms) {
+                if (mQueueCondition.wait_until(l, deadline) == std::cv_status::timeout &&
+                    mRingHead.load() == mRingTail.load()) {
+                    mConsumerWaiting = false;
+                    return TIMED_OUT;
+                }
+            } else {
+                mQueueCondition.wait(l);
+            }
+        }
+        mConsumerWaiting = false;
+
+        if (mRingHead.load() == mRingTail.load()) {
+            LOGE("Camera_MessageQueue - woke with mCount == 0\n");
+        }
+    }
+
+    return NO_ERROR;
+}
+
+template <class MessageType, class MessageId>
+bool MessageQueue<MessageType, MessageId>::ringPop(MessageType *msg)
+{
+    while (true) {
+        unsigned int head = mRingHead.load(std::memory_order_relaxed);
+
+        if (head == mRingTail.load())
+            return false;
+
+        MessageType &slot = mRing[head & mRingMask];
+        bool dropped = mRingHasDrops.load() && ringIsDropped(slot, head);
+        if (!dropped)
+            *msg = std::move(slot);
+        // don't let the slot hold references until it is reused
+        slot = MessageType();
+        mRingHead.store(head + 1);
+
+        if (mProducerWaiting.load()) {
+            std::lock_guard<std::mutex> l(mQueueMutex);
+            mRingSpaceCondition.notify_one();
+        }
+
+        if (!dropped)
+            return true;
+    }
+}
+
+template <class MessageType, class MessageId>
+bool MessageQueue<MessageType, MessageId>::ringIsDropped(const MessageType &msg,
+            unsigned int seq)
+{
+    bool dropped = false;
+    std::lock_guard<std::mutex> l(mQueueMutex);
+
+    typename std::vector<RingDrop>::iterator it = mRingDrops.begin();
+    while (it != mRingDrops.end()) {
+        if ((int)(seq - it->tail) >= 0) {
+            // every message queued before this remove() has been seen
+            it = mRingDrops.erase(it);
+            continue;
+        }
+        if (msg.id == it->id)
+            dropped = true;
+        it++;
+    }
+
+    if (mRingDrops.empty())
+        mRingHasDrops = false;
+
+    return dropped;
+}
+
 template <class MessageType, class MessageId>
 void MessageQueue<MessageType, MessageId>::reply(MessageId replyId, status_t status)
 {
@@ -24,6 +24,8 @@
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <thread>
 #include "LogHelper.h"
 #include <chrono>
 
@@ -32,13 +34,25 @@
 
 NAMESPACE_DECLARATION {
 
+/*
+ * By default messages are stored in a mutex protected list. Queues with a
+ * single producer thread can pass ringCapacity to use a bounded lock-free
+ * SPSC ring instead: slots are preallocated, messages are moved out on
+ * receive() and the consumer is only signalled when it is actually sleeping.
+ * A full ring blocks the producer until the consumer frees a slot. The first
+ * thread that sends is the producer, send() from another thread fails with
+ * INVALID_OPERATION.
+ * remove() may still be called from any thread in ring mode, the removed
+ * messages are then dropped by the consumer.
+ */
 template <class MessageType, class MessageId>
 class MessageQueue {
 
     // constructor / destructor
 public:
     explicit MessageQueue(const char *name, // for debugging
-            int numReply = 0);    // set numReply only if you need synchronous messages
+            int numReply = 0,     // set numReply only if you need synchronous messages
+            unsigned int ringCapacity = 0); // set only if there is a single producer
 
     ~MessageQueue();
 
@@ -52,10 +66,21 @@ public:
 
     status_t remove(MessageId id, std::vector<MessageType> *vect = nullptr);
 
-    // Pop a message from the queue
+    // Pop a message from the queue. With a timeout, TIMED_OUT if nothing
+    // arrived within timeout_ms
     status_t receive(MessageType *msg,
             unsigned int timeout_ms = MESSAGE_QUEUE_RECEIVE_TIMEOUT_MSEC_INFINITE);
 
+    // Pop up to |max| pending messages (all of them if |max| is 0) in arrival
+    // order, taking the queue lock once. Blocks like receive() while empty.
+    status_t receiveBatch(std::vector<MessageType> *msgs, unsigned int max,
+            unsigned int timeout_ms = MESSAGE_QUEUE_RECEIVE_TIMEOUT_MSEC_INFINITE);
+
+    status_t receiveAll(std::vector<MessageType> *msgs,
+            unsigned int timeout_ms = MESSAGE_QUEUE_RECEIVE_TIMEOUT_MSEC_INFINITE) {
+        return receiveBatch(msgs, 0, timeout_ms);
+    }
+
     // Unblock the caller of send and indicate the status of the received message
     void reply(MessageId replyId, status_t status);
 
@@ -73,13 +98,37 @@ private:
     // with mQueueMutex taken
     inline bool isEmptyLocked() { return sizeLocked() == 0; }
 
-    inline int sizeLocked() { return mList.size(); }
+    inline int sizeLocked() { return mRing ? ringSize() : mList.size(); }
+
+    // SPSC ring helpers
+    inline int ringSize() { return mRingTail.load() - mRingHead.load(); }
+    bool ringIsProducer();
+    status_t ringSend(MessageType *msg);
+    status_t ringReceive(MessageType *msg, unsigned int timeout_ms);
+    bool ringPop(MessageType *msg);
+    bool ringIsDropped(const MessageType &msg, unsigned int seq);
 
     const char *mName;
-    std::mutex mQueueMutex; /* protects mList */
+    std::mutex mQueueMutex; /* protects mList, mRingDrops */
     std::condition_variable mQueueCondition;
     std::list<MessageType> mList;
 
+    MessageType *mRing;
+    unsigned int mRingMask;
+    std::atomic<unsigned int> mRingHead; /* written by the consumer only */
+    std::atomic<unsigned int> mRingTail; /* written by the producer only */
+    std::atomic<bool> mConsumerWaiting;
+    std::atomic<bool> mProducerWaiting;
+    std::condition_variable mRingSpaceCondition;
+    /* pending remove() calls, messages with |id| and seq below |tail| are dropped */
+    struct RingDrop {
+        MessageId id;
+        unsigned int tail;
+    };
+    std::vector<RingDrop> mRingDrops;
+    std::atomic<bool> mRingHasDrops;
+    std::atomic<std::thread::id> mRingProducer; /* the only thread that sends */
+
     const int mNumReply;
     std::mutex *mReplyMutex; /* protects mReplayStatus */
     std::condition_variable* mReplyCondition;
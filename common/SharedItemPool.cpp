@@ -21,14 +21,20 @@ NAMESPACE_DECLARATION {
 
 template <class ItemType>
 SharedItemPool<ItemType>::SharedItemPool(const char*name):
+    mFreeHead(0),
+    mFreeNext(nullptr),
     mAllocated(nullptr),
     mCapacity(0),
     mDeleter(this),
+    mWaiters(0),
+    mAvailableCount(0),
+    mHighWaterMark(0),
+    mAcquireFailures(0),
+    mAcquireWaits(0),
     mTraceReturns(false),
     mName(name),
     mResetter(nullptr)
 {
-    CLEAR(mMutex);
 }
 
 template <class ItemType>
@@ -40,139 +46,171 @@ SharedItemPool<ItemType>::~SharedItemPool()
 template <class ItemType>
 status_t SharedItemPool<ItemType>::init(int32_t capacity,  void (*resetter)(ItemType*))
 {
-    int32_t status = OK;
+    std::lock_guard<std::mutex> l(mMutex);
     if (mCapacity != 0) {
         LOGE("trying to initialize pool twice ?");
         return INVALID_OPERATION;
     }
-    status = pthread_mutex_init(&mMutex, nullptr);
-    if (status != 0) {
-        LOGE("Pool mutex failed to initialize [%d]",status);
-        return NO_INIT;
-    }
-    pthread_mutex_lock(&mMutex);
     mResetter = resetter;
-    mCapacity = capacity;
-    mAvailable.reserve(capacity);
     mAllocated = new ItemType[capacity];
+    mFreeNext = new std::atomic<int32_t>[capacity];
 
+    // item 0 on top so the first acquisitions come out in index order
     for (int32_t i = 0; i < capacity; i++) {
-        mAvailable.push_back(&mAllocated[i]);
+        mFreeNext[i].store(i + 1 < capacity ? i + 1 : -1, std::memory_order_relaxed);
     }
+    mFreeHead.store(packHead(0, capacity > 0 ? 0 : -1));
+    mAvailableCount = capacity;
+    mHighWaterMark = 0;
+    mAcquireFailures = 0;
+    mAcquireWaits = 0;
+    mCapacity = capacity;
     LOGI("Shared pool %s init with %d items", mName, capacity);
-    pthread_mutex_unlock(&mMutex);
     return OK;
 }
 
 template <class ItemType>
 bool SharedItemPool<ItemType>::isFull()
 {
-    int32_t status = pthread_mutex_lock (&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to lock mutex on availableItems @%s pool[%d]",
-                mName, status);
-        return false;
-    }
-    bool ret = (mAvailable.size() == mCapacity);
-    status = pthread_mutex_unlock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to unlock mutex on availableItems @%s pool[%d]",
-                mName, status);
-        return false;
-    }
-    return ret;
+    return (size_t)mAvailableCount.load() == mCapacity;
 }
 
 template <class ItemType>
 status_t SharedItemPool<ItemType>::deInit()
 {
-    int32_t status = pthread_mutex_lock(&mMutex);
+    std::lock_guard<std::mutex> l(mMutex);
     if (mCapacity == 0) {
         LOGI("Shared pool %s isn't initialized or already de-initialized",
                 mName);
-        status = pthread_mutex_unlock(&mMutex);
-        if (CC_UNLIKELY(status != 0)) {
-            LOGE("Failed to unlock mutex on acquire item @%s pool[%d]",
-                mName, status);
-            return UNKNOWN_ERROR;
-        }
         return OK;
     }
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to lock mutex on destroying @%s pool[%d]",
-                mName, status);
-        return UNKNOWN_ERROR;
-    }
-    if (mAvailable.size() != mCapacity) {
-        LOGE("Not all items are returned when destroying pool %s (%zu/%zu)!",
-                mName, mAvailable.size(), mCapacity);
+    if ((size_t)mAvailableCount.load() != mCapacity) {
+        LOGE("Not all items are returned when destroying pool %s (%d/%zu)!",
+                mName, mAvailableCount.load(), mCapacity);
     }
+    LOGI("Shared pool %s: capacity %zu, high-water %d, acquire failures %u, waits %u",
+            mName, mCapacity, mHighWaterMark.load(), mAcquireFailures.load(),
+            mAcquireWaits.load());
     delete [] mAllocated;
     mAllocated = nullptr;
-    mAvailable.clear();
+    delete [] mFreeNext;
+    mFreeNext = nullptr;
+    mFreeHead.store(packHead(0, -1));
+    mAvailableCount = 0;
     mCapacity = 0;
-    status = pthread_mutex_unlock(&mMutex);
-    status |= pthread_mutex_destroy(&mMutex);
-    LOGI("Shared pool %s deinit done. Status %d", mName, status);
-    return status;
+    LOGI("Shared pool %s deinit done.", mName);
+    return OK;
+}
+
+template <class ItemType>
+int32_t SharedItemPool<ItemType>::popIndex()
+{
+    uint64_t head = mFreeHead.load(std::memory_order_acquire);
+    int32_t index;
+
+    do {
+        index = headIndex(head);
+        if (index < 0)
+            return -1;
+        // may read a stale next if we lose the race, the tag makes the CAS fail then
+        int32_t next = mFreeNext[index].load(std::memory_order_relaxed);
+        if (mFreeHead.compare_exchange_weak(head, packHead(headTag(head) + 1, next),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+            break;
+    } while (true);
+
+    int32_t inUse = mCapacity - (mAvailableCount.fetch_sub(1) - 1);
+    int32_t mark = mHighWaterMark.load(std::memory_order_relaxed);
+    while (inUse > mark &&
+           !mHighWaterMark.compare_exchange_weak(mark, inUse, std::memory_order_relaxed));
+
+    return index;
+}
+
+template <class ItemType>
+void SharedItemPool<ItemType>::pushIndex(int32_t index)
+{
+    uint64_t head = mFreeHead.load(std::memory_order_relaxed);
+
+    do {
+        mFreeNext[index].store(headIndex(head), std::memory_order_relaxed);
+    } while (!mFreeHead.compare_exchange_weak(head, packHead(headTag(head) + 1, index),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    mAvailableCount.fetch_add(1);
 }
 
 template <class ItemType>
 status_t SharedItemPool<ItemType>::acquireItem(std::shared_ptr<ItemType> &item)
 {
     item.reset();
-    int32_t status = pthread_mutex_lock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to lock mutex on acquire item @%s pool[%d]",
-                mName, status);
-        return UNKNOWN_ERROR;
-    }
-    if (mAvailable.empty()) {
-        pthread_mutex_unlock(&mMutex);
+    if (CC_UNLIKELY(mCapacity == 0)) {
+        LOGE("acquire item from uninitialized pool %s", mName);
         return INVALID_OPERATION;
     }
-    std::shared_ptr<ItemType> sh(mAvailable[0], mDeleter);
-    mAvailable.erase(mAvailable.begin());
-    item = sh;
-    status = pthread_mutex_unlock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to unlock mutex on acquire item @%s pool[%d]",
-                mName, status);
-        return UNKNOWN_ERROR;
+
+    int32_t index = popIndex();
+    if (index < 0) {
+        mAcquireFailures++;
+        return INVALID_OPERATION;
     }
-    LOGP("shared pool %s acquire items %p", mName, sh.get());
+
+    item = std::shared_ptr<ItemType>(&mAllocated[index], mDeleter);
+    LOGP("shared pool %s acquire items %p", mName, item.get());
     return OK;
 }
 
 template <class ItemType>
-size_t SharedItemPool<ItemType>::availableItems()
+status_t SharedItemPool<ItemType>::acquireItem(std::shared_ptr<ItemType> &item,
+                                               unsigned int timeout_ms)
 {
-    int32_t status = pthread_mutex_lock (&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to lock mutex on availableItems @%s pool[%d]",
-                mName, status);
-        return 0;
+    status_t status = acquireItem(item);
+    if (status == OK || mCapacity == 0)
+        return status;
+
+    mAcquireWaits++;
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::unique_lock<std::mutex> l(mMutex);
+    mWaiters++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int32_t index;
+    while ((index = popIndex()) < 0) {
+        if (mReleaseCondition.wait_until(l, deadline) == std::cv_status::timeout) {
+            index = popIndex();
+            break;
+        }
     }
-    size_t ret = mAvailable.size();
-    status = pthread_mutex_unlock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to unlock mutex on availableItems @%s pool[%d]",
-                mName, status);
-        return 0;
+    mWaiters--;
+
+    if (index < 0) {
+        LOGW("shared pool %s: no item released in %u ms", mName, timeout_ms);
+        return TIMED_OUT;
     }
-    return ret;
+
+    item = std::shared_ptr<ItemType>(&mAllocated[index], mDeleter);
+    LOGP("shared pool %s acquire items %p after wait", mName, item.get());
+    return OK;
 }
 
 template <class ItemType>
-status_t SharedItemPool<ItemType>::_releaseItem(ItemType *item)
+size_t SharedItemPool<ItemType>::availableItems()
 {
-    int32_t status = pthread_mutex_lock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to lock mutex on release item @%s pool[%d]",
-                mName, status);
-        return UNKNOWN_ERROR;
-    }
+    return mAvailableCount.load();
+}
+
+template <class ItemType>
+void SharedItemPool<ItemType>::dump()
+{
+    LOGI("Shared pool %s: capacity %zu, in use %zu, high-water %d, acquire failures %u, waits %u",
+            mName, mCapacity, mCapacity - availableItems(), mHighWaterMark.load(),
+            mAcquireFailures.load(), mAcquireWaits.load());
+}
 
+template <class ItemType>
+status_t SharedItemPool<ItemType>::_releaseItem(ItemType *item)
+{
     if (mResetter)
         mResetter(item);
 
@@ -181,12 +219,13 @@ status_t SharedItemPool<ItemType>::_releaseItem(ItemType *item)
     PRINT_BACKTRACE_LINUX();
     }
 
-    mAvailable.push_back(item);
-    status = pthread_mutex_unlock(&mMutex);
-    if (CC_UNLIKELY(status != 0)) {
-        LOGE("Failed to unlock mutex on release item @%s pool[%d]",
-                mName, status);
-        return UNKNOWN_ERROR;
+    pushIndex(item - mAllocated);
+
+    // only take the lock when somebody is blocked in acquireItem()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mWaiters.load() > 0) {
+        std::lock_guard<std::mutex> l(mMutex);
+        mReleaseCondition.notify_all();
     }
     return OK;
 }
@@ -18,7 +18,11 @@
 #define CAMERA3_HAL_SHAREDITEMPOOL_H_
 
 #include <vector>
-#include <pthread.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
 #include "LogHelper.h"
 #include "CommonUtilMacros.h"
 /**
@@ -46,6 +50,12 @@
  * When the element is recycled to the pool it can be reset via a client
  * provided method.
  *
+ * The free items are kept in a lock-free stack of indexes (Treiber stack
+ * with a tag against ABA), so acquire and release are a single CAS when
+ * uncontended. Only a blocking acquire with a timeout ever takes a lock.
+ * Per-thread caches are deliberately not used, the pools hold a handful of
+ * items and a cache would strand them on threads that don't need them.
+ *
  */
 
 NAMESPACE_DECLARATION {
@@ -94,22 +104,46 @@ public:
      *
      * \param item[OUT] shared pointer to an item.
      * \return OK
-     * \return UNKNOWN_ERROR: issues with the mutex lock
      * \return INVALID_OPERATION: Pool is empty, you cannot acquire.
      */
     status_t acquireItem(std::shared_ptr<ItemType> &item);
 
+    /**
+     * Acquire an item from the pool, waiting up to timeout_ms for an item to
+     * be released if the pool is empty.
+     *
+     * \param item[OUT] shared pointer to an item.
+     * \param timeout_ms[IN] maximum time to wait
+     * \return OK
+     * \return TIMED_OUT: no item was released in time.
+     * \return INVALID_OPERATION: pool is not initialized.
+     */
+    status_t acquireItem(std::shared_ptr<ItemType> &item, unsigned int timeout_ms);
+
     /**
      * Returns the number of currently available items
-     * It there would be issues acquiring the lock the method returns 0
-     * available items.
      *
      * \return item count
      */
     size_t availableItems();
 
+    /**
+     * Print the occupancy counters of the pool: capacity, items in use,
+     * high-water mark of items in use and failed/blocking acquisitions.
+     */
+    void dump();
+
 private:
     status_t _releaseItem(ItemType *item);
+    int32_t popIndex();
+    void pushIndex(int32_t index);
+
+    /* free stack head: tag in the high 32 bits, index + 1 in the low ones */
+    static uint64_t packHead(uint32_t tag, int32_t index) {
+        return ((uint64_t)tag << 32) | (uint32_t)(index + 1);
+    }
+    static int32_t headIndex(uint64_t head) { return (int32_t)(uint32_t)head - 1; }
+    static uint32_t headTag(uint64_t head) { return (uint32_t)(head >> 32); }
 
     class ItemDeleter
     {
@@ -122,11 +156,19 @@ private:
         SharedItemPool* mPool;
     };
 private: /* members */
-    std::vector<ItemType*>   mAvailable; /* SharedItemPool doesn't have ownership */
+    std::atomic<uint64_t> mFreeHead;
+    std::atomic<int32_t> *mFreeNext; /* next free index, per item */
     ItemType           *mAllocated;
     size_t              mCapacity;
     ItemDeleter         mDeleter;
-    pthread_mutex_t     mMutex; /* protects mAvailable, mAllocated, mCapacity, mTraceReturns */
+    std::mutex          mMutex; /* protects init/deInit, used by blocking acquire */
+    std::condition_variable mReleaseCondition;
+    std::atomic<int32_t> mWaiters;
+    /* occupancy counters */
+    std::atomic<int32_t> mAvailableCount;
+    std::atomic<int32_t> mHighWaterMark;
+    std::atomic<uint32_t> mAcquireFailures;
+    std::atomic<uint32_t> mAcquireWaits;
     bool                mTraceReturns;
     const char         *mName;
     void (*mResetter)(ItemType*);
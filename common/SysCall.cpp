@@ -17,10 +17,14 @@
 
 #define LOG_TAG "SysCall"
 
+#include <dirent.h>
+#include <string.h>
 #include "SysCall.h"
 
 NAMESPACE_DECLARATION {
 
+SysCallBackend *SysCall::sBackend = nullptr;
+
 SysCall::SysCall()
 {
 }
@@ -31,22 +35,75 @@ SysCall::~SysCall()
 
 int SysCall::open(const char *pathname, int flags)
 {
+    if (sBackend)
+        return sBackend->open(pathname, flags);
     return ::open(pathname, flags);
 }
 
 int SysCall::close(int fd)
 {
+    if (sBackend)
+        return sBackend->close(fd);
     return ::close(fd);
 }
 
 int SysCall::ioctl(int fd, int request, void *arg)
 {
+    if (sBackend)
+        return sBackend->ioctl(fd, request, arg);
     return ::ioctl(fd, request, (void *)arg);
 }
 
 int SysCall::poll(struct pollfd *pfd, nfds_t nfds, int timeout)
 {
+    // backend file descriptors are pollable kernel objects
     return ::poll(pfd, nfds, timeout);
 }
 
+void *SysCall::mmap(void *addr, size_t length, int prot, int flags,
+                    int fd, off_t offset)
+{
+    if (sBackend)
+        return sBackend->mmap(addr, length, prot, flags, fd, offset);
+    return ::mmap(addr, length, prot, flags, fd, offset);
+}
+
+int SysCall::stat(const char *pathname, struct stat *st)
+{
+    if (sBackend)
+        return sBackend->stat(pathname, st);
+    return ::stat(pathname, st);
+}
+
+ssize_t SysCall::readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    if (sBackend)
+        return sBackend->readlink(pathname, buf, bufsiz);
+    return ::readlink(pathname, buf, bufsiz);
+}
+
+int SysCall::listDir(const char *dirname, std::vector<std::string> &names)
+{
+    if (sBackend)
+        return sBackend->listDir(dirname, names);
+
+    DIR *dir = opendir(dirname);
+    if (dir == nullptr)
+        return -1;
+
+    struct dirent *dirEnt;
+    while ((dirEnt = readdir(dir)) != nullptr) {
+        if (strcmp(dirEnt->d_name, ".") == 0 || strcmp(dirEnt->d_name, "..") == 0)
+            continue;
+        names.push_back(dirEnt->d_name);
+    }
+    closedir(dir);
+    return 0;
+}
+
+void SysCall::setBackend(SysCallBackend *backend)
+{
+    sBackend = backend;
+}
+
 } NAMESPACE_DECLARATION_END
@@ -22,8 +22,35 @@
 #include <poll.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
 
 NAMESPACE_DECLARATION {
+/**
+ * \class SysCallBackend
+ *
+ * Replacement for the kernel side of the device calls made through SysCall.
+ * A backend handles the paths and file descriptors it owns and forwards
+ * everything else to the real system calls. Returns and errno follow the
+ * system calls they replace.
+ */
+class SysCallBackend
+{
+public:
+    virtual ~SysCallBackend() {}
+
+    virtual int open(const char *pathname, int flags) = 0;
+    virtual int close(int fd) = 0;
+    virtual int ioctl(int fd, int request, void *arg) = 0;
+    virtual void *mmap(void *addr, size_t length, int prot, int flags,
+                       int fd, off_t offset) = 0;
+    virtual int stat(const char *pathname, struct stat *st) = 0;
+    virtual ssize_t readlink(const char *pathname, char *buf, size_t bufsiz) = 0;
+    virtual int listDir(const char *dirname, std::vector<std::string> &names) = 0;
+};
+
 class SysCall
 {
 public:
@@ -34,6 +61,23 @@ public:
     static int close(int fd);
     static int ioctl(int fd, int request, void *arg);
     static int poll(struct pollfd *pfd, nfds_t nfds, int timeout);
+    static void *mmap(void *addr, size_t length, int prot, int flags,
+                      int fd, off_t offset);
+    static int stat(const char *pathname, struct stat *st);
+    static ssize_t readlink(const char *pathname, char *buf, size_t bufsiz);
+    /* names of the entries of a directory, without "." and ".." */
+    static int listDir(const char *dirname, std::vector<std::string> &names);
+
+    /**
+     * Routes the calls above to backend instead of the kernel, nullptr
+     * restores the kernel. Only meant to be called before any device is
+     * opened, the backend must outlive every user of SysCall.
+     */
+    static void setBackend(SysCallBackend *backend);
+    static bool hasBackend() { return sBackend != nullptr; }
+
+private:
+    static SysCallBackend *sBackend;
 };
 } NAMESPACE_DECLARATION_END
 
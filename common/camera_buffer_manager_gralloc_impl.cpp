@@ -382,7 +382,7 @@ int CameraBufferManagerImpl::Unlock(buffer_handle_t buffer) {
 }
 
 
-int CameraBufferManagerImpl::FlushCache(buffer_handle_t buffer) {
+int CameraBufferManagerImpl::SyncCache(buffer_handle_t buffer, uint64_t flags) {
     int fd = -1;
 
     if (gm_module_ && gm_module_->perform)
@@ -395,13 +395,21 @@ int CameraBufferManagerImpl::FlushCache(buffer_handle_t buffer) {
     }
 
     struct dma_buf_sync sync_args;
-    sync_args.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW;
+    sync_args.flags = flags;
     if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync_args))
         return -EINVAL;
 
     return 0;
 }
 
+int CameraBufferManagerImpl::FlushCache(buffer_handle_t buffer) {
+    return SyncCache(buffer, DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW);
+}
+
+int CameraBufferManagerImpl::InvalidateCache(buffer_handle_t buffer) {
+    return SyncCache(buffer, DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW);
+}
+
 int CameraBufferManagerImpl::GetHandleFd(buffer_handle_t buffer) {
     int fd = -1;
 
@@ -74,10 +74,12 @@ public:
                   struct android_ycbcr* out_ycbcr) final;
     int Unlock(buffer_handle_t buffer) final;
     int FlushCache(buffer_handle_t buffer) final;
+    int InvalidateCache(buffer_handle_t buffer) final;
     int GetHandleFd(buffer_handle_t buffer) final;
 
 private:
     static int GetHalPixelFormat(buffer_handle_t buffer);
+    int SyncCache(buffer_handle_t buffer, uint64_t flags);
 private:
     friend class CameraBufferManager;
 
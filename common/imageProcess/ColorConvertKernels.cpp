@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ColorConvertKernels"
+
+#include "LogHelper.h"
+#include "ColorConvertKernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLOR_KERNELS_NEON
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLOR_KERNELS_X86
+#endif
+
+NAMESPACE_DECLARATION {
+
+////////////////////////////////////////////////////////////////////
+// Scalar reference
+////////////////////////////////////////////////////////////////////
+
+static void interleave_c(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[2 * i] = a[i];
+        dst[2 * i + 1] = b[i];
+    }
+}
+
+static void deinterleave_c(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; i++) {
+        a[i] = src[2 * i];
+        b[i] = src[2 * i + 1];
+    }
+}
+
+static void pick2_c(uint8_t *dst, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = src[2 * i];
+}
+
+static void pick4_c(uint8_t *dst, const uint8_t *src, int offset, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = src[4 * i + offset];
+}
+
+static void yuyvToVU_c(uint8_t *dst, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[2 * i] = src[4 * i + 3];
+        dst[2 * i + 1] = src[4 * i + 1];
+    }
+}
+
+static const ColorConvertKernels sScalarKernels = {
+    "scalar", interleave_c, deinterleave_c, pick2_c, pick4_c, yuyvToVU_c
+};
+
+#ifdef COLOR_KERNELS_NEON
+////////////////////////////////////////////////////////////////////
+// NEON, 16 elements per iteration
+////////////////////////////////////////////////////////////////////
+
+static void interleave_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8(a + i);
+        v.val[1] = vld1q_u8(b + i);
+        vst2q_u8(dst + 2 * i, v);
+    }
+    interleave_c(dst + 2 * i, a + i, b + i, n - i);
+}
+
+static void deinterleave_neon(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t v = vld2q_u8(src + 2 * i);
+        vst1q_u8(a + i, v.val[0]);
+        vst1q_u8(b + i, v.val[1]);
+    }
+    deinterleave_c(a + i, b + i, src + 2 * i, n - i);
+}
+
+static void pick2_neon(uint8_t *dst, const uint8_t *src, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t v = vld2q_u8(src + 2 * i);
+        vst1q_u8(dst + i, v.val[0]);
+    }
+    pick2_c(dst + i, src + 2 * i, n - i);
+}
+
+static void pick4_neon(uint8_t *dst, const uint8_t *src, int offset, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + 4 * i);
+        switch (offset) {
+        case 0: vst1q_u8(dst + i, v.val[0]); break;
+        case 1: vst1q_u8(dst + i, v.val[1]); break;
+        case 2: vst1q_u8(dst + i, v.val[2]); break;
+        default: vst1q_u8(dst + i, v.val[3]); break;
+        }
+    }
+    pick4_c(dst + i, src + 4 * i, offset, n - i);
+}
+
+static void yuyvToVU_neon(uint8_t *dst, const uint8_t *src, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + 4 * i);
+        uint8x16x2_t vu;
+        vu.val[0] = v.val[3];
+        vu.val[1] = v.val[1];
+        vst2q_u8(dst + 2 * i, vu);
+    }
+    yuyvToVU_c(dst + 2 * i, src + 4 * i, n - i);
+}
+
+static const ColorConvertKernels sNeonKernels = {
+    "neon", interleave_neon, deinterleave_neon, pick2_neon, pick4_neon, yuyvToVU_neon
+};
+
+static bool cpuHasNeon()
+{
+#if defined(__aarch64__)
+    return true;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif // COLOR_KERNELS_NEON
+
+#ifdef COLOR_KERNELS_X86
+////////////////////////////////////////////////////////////////////
+// SSE2, 16 elements per iteration
+////////////////////////////////////////////////////////////////////
+
+__attribute__((target("sse2")))
+static void interleave_sse2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(va, vb));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(va, vb));
+    }
+    interleave_c(dst + 2 * i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void deinterleave_sse2(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i even = _mm_packus_epi16(_mm_and_si128(v0, mask), _mm_and_si128(v1, mask));
+        __m128i odd = _mm_packus_epi16(_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8));
+        _mm_storeu_si128((__m128i *)(a + i), even);
+        _mm_storeu_si128((__m128i *)(b + i), odd);
+    }
+    deinterleave_c(a + i, b + i, src + 2 * i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void pick2_sse2(uint8_t *dst, const uint8_t *src, int n)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_packus_epi16(_mm_and_si128(v0, mask), _mm_and_si128(v1, mask)));
+    }
+    pick2_c(dst + i, src + 2 * i, n - i);
+}
+
+// byte 'offset' of each 32 bit lane of 64 source bytes
+__attribute__((target("sse2")))
+static inline __m128i pick4x16_sse2(const uint8_t *src, __m128i shift)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i v0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i *)src), shift), mask);
+    __m128i v1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i *)(src + 16)), shift), mask);
+    __m128i v2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i *)(src + 32)), shift), mask);
+    __m128i v3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i *)(src + 48)), shift), mask);
+    return _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+}
+
+__attribute__((target("sse2")))
+static void pick4_sse2(uint8_t *dst, const uint8_t *src, int offset, int n)
+{
+    const __m128i shift = _mm_cvtsi32_si128(offset * 8);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i), pick4x16_sse2(src + 4 * i, shift));
+    pick4_c(dst + i, src + 4 * i, offset, n - i);
+}
+
+__attribute__((target("sse2")))
+static void yuyvToVU_sse2(uint8_t *dst, const uint8_t *src, int n)
+{
+    const __m128i shiftU = _mm_cvtsi32_si128(8);
+    const __m128i shiftV = _mm_cvtsi32_si128(24);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i u = pick4x16_sse2(src + 4 * i, shiftU);
+        __m128i v = pick4x16_sse2(src + 4 * i, shiftV);
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(v, u));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(v, u));
+    }
+    yuyvToVU_c(dst + 2 * i, src + 4 * i, n - i);
+}
+
+static const ColorConvertKernels sSse2Kernels = {
+    "sse2", interleave_sse2, deinterleave_sse2, pick2_sse2, pick4_sse2, yuyvToVU_sse2
+};
+
+////////////////////////////////////////////////////////////////////
+// AVX2, 32 elements per iteration. pack/unpack work per 128 bit lane,
+// hence the cross lane permutes.
+////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static void interleave_avx2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i lo = _mm256_unpacklo_epi8(va, vb);
+        __m256i hi = _mm256_unpackhi_epi8(va, vb);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_sse2(dst + 2 * i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void deinterleave_avx2(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        __m256i even = _mm256_packus_epi16(_mm256_and_si256(v0, mask), _mm256_and_si256(v1, mask));
+        __m256i odd = _mm256_packus_epi16(_mm256_srli_epi16(v0, 8), _mm256_srli_epi16(v1, 8));
+        _mm256_storeu_si256((__m256i *)(a + i), _mm256_permute4x64_epi64(even, 0xd8));
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_permute4x64_epi64(odd, 0xd8));
+    }
+    deinterleave_sse2(a + i, b + i, src + 2 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void pick2_avx2(uint8_t *dst, const uint8_t *src, int n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        __m256i even = _mm256_packus_epi16(_mm256_and_si256(v0, mask), _mm256_and_si256(v1, mask));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(even, 0xd8));
+    }
+    pick2_sse2(dst + i, src + 2 * i, n - i);
+}
+
+static const ColorConvertKernels sAvx2Kernels = {
+    "avx2", interleave_avx2, deinterleave_avx2, pick2_avx2, pick4_sse2, yuyvToVU_sse2
+};
+#endif // COLOR_KERNELS_X86
+
+std::vector<const ColorConvertKernels*> getSupportedColorConvertKernels()
+{
+    std::vector<const ColorConvertKernels*> kernels;
+    kernels.push_back(&sScalarKernels);
+
+#ifdef COLOR_KERNELS_NEON
+    if (cpuHasNeon())
+        kernels.push_back(&sNeonKernels);
+#endif
+#ifdef COLOR_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        kernels.push_back(&sSse2Kernels);
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back(&sAvx2Kernels);
+#endif
+
+    return kernels;
+}
+
+const ColorConvertKernels &getScalarColorConvertKernels()
+{
+    return sScalarKernels;
+}
+
+static const ColorConvertKernels *selectColorConvertKernels()
+{
+    const ColorConvertKernels *kernels = getSupportedColorConvertKernels().back();
+    LOGI("@%s: using %s color conversion kernels", __FUNCTION__, kernels->name);
+    return kernels;
+}
+
+const ColorConvertKernels &getColorConvertKernels()
+{
+    static const ColorConvertKernels *sKernels = selectColorConvertKernels();
+    return *sKernels;
+}
+
+} NAMESPACE_DECLARATION_END
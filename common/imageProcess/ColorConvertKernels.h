@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CAMERA3_HAL_COLOR_CONVERT_KERNELS_H_
+#define _CAMERA3_HAL_COLOR_CONVERT_KERNELS_H_
+
+#include <stdint.h>
+#include <vector>
+#include "UtilityMacros.h"
+
+NAMESPACE_DECLARATION {
+/**
+ * \struct ColorConvertKernels
+ *
+ * Byte shuffling primitives the color converters are built from, one row
+ * at a time. Every implementation produces exactly the same bytes as the
+ * scalar one; n is the number of output elements (or pairs).
+ */
+struct ColorConvertKernels {
+    const char *name;
+
+    /* dst[2i] = a[i], dst[2i + 1] = b[i] */
+    void (*interleave)(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n);
+    /* a[i] = src[2i], b[i] = src[2i + 1] */
+    void (*deinterleave)(uint8_t *a, uint8_t *b, const uint8_t *src, int n);
+    /* dst[i] = src[2i], luma of YUY2 */
+    void (*pick2)(uint8_t *dst, const uint8_t *src, int n);
+    /* dst[i] = src[4i + offset], offset in [0, 3], chroma of YUY2 */
+    void (*pick4)(uint8_t *dst, const uint8_t *src, int offset, int n);
+    /* dst[2i] = src[4i + 3], dst[2i + 1] = src[4i + 1], YUY2 chroma to VU */
+    void (*yuyvToVU)(uint8_t *dst, const uint8_t *src, int n);
+};
+
+/* fastest implementation supported by the running CPU, chosen once */
+const ColorConvertKernels &getColorConvertKernels();
+
+/* reference implementation */
+const ColorConvertKernels &getScalarColorConvertKernels();
+
+/* every implementation supported by the running CPU, scalar first; used by
+ * camera_colorconvert_benchmark to check and time each of them */
+std::vector<const ColorConvertKernels*> getSupportedColorConvertKernels();
+
+} NAMESPACE_DECLARATION_END
+#endif // _CAMERA3_HAL_COLOR_CONVERT_KERNELS_H_
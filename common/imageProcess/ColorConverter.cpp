@@ -23,9 +23,104 @@
 #include <linux/videodev2.h>
 #include "UtilityMacros.h"
 #include "ColorConverter.h"
+#include "StripeExecutor.h"
+#include "ColorConvertKernels.h"
 #include "LogHelper.h"
 
 NAMESPACE_DECLARATION {
+/*
+ * Row kernels. They process rows [begin, end) and derive every address
+ * from the row index, so that StripeExecutor can split them in stripes.
+ * The per row work goes to the SIMD primitives of ColorConvertKernels.
+ */
+
+// plain copy of width bytes per row
+static void copyRows(unsigned char *dst, int dstStride,
+                     const unsigned char *src, int srcStride,
+                     int width, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+        STDCOPY(dst + i * dstStride, src + i * srcStride, width);
+}
+
+// dst = a0 b0 a1 b1 ..., count pairs per row
+static void interleaveRows(unsigned char *dst, int dstStride,
+                           const unsigned char *srcA, const unsigned char *srcB,
+                           int srcStride, int count, int begin, int end)
+{
+    const ColorConvertKernels &k = getColorConvertKernels();
+
+    for (int i = begin; i < end; i++)
+        k.interleave(dst + i * dstStride, srcA + i * srcStride, srcB + i * srcStride, count);
+}
+
+// even bytes of the first count bytes go to dstA, odd ones to dstB
+static void deinterleaveRows(unsigned char *dstA, int aStride,
+                             unsigned char *dstB, int bStride,
+                             const unsigned char *src, int srcStride,
+                             int count, int begin, int end)
+{
+    const ColorConvertKernels &k = getColorConvertKernels();
+
+    for (int i = begin; i < end; i++) {
+        const unsigned char *s = src + i * srcStride;
+        unsigned char *a = dstA + i * aStride;
+        unsigned char *b = dstB + i * bStride;
+        k.deinterleave(a, b, s, count / 2);
+        if (count & 1)
+            a[count / 2] = s[count - 1];
+    }
+}
+
+// YUY2 lines to planar Y, with U taken from the even lines and V from the
+// odd ones
+static void yuy2ToPlanarRows(unsigned char *dstY, int yStride,
+                             unsigned char *dstU, unsigned char *dstV, int cStride,
+                             const unsigned char *src, int srcStride,
+                             int width, int begin, int end)
+{
+    const ColorConvertKernels &k = getColorConvertKernels();
+    const int wHalf = width >> 1;
+
+    for (int i = begin; i < end; i++) {
+        const unsigned char *s = src + i * srcStride;
+        k.pick2(dstY + i * yStride, s, width);
+
+        if (i & 1)
+            k.pick4(dstV + (i >> 1) * cStride, s, 3, wHalf);
+        else
+            k.pick4(dstU + (i >> 1) * cStride, s, 1, wHalf);
+    }
+}
+
+// YUY2 lines to NV21, chroma is taken from the odd lines. Each odd line
+// writes width / 2 V and (width + 1) / 2 U samples.
+static void yuyvToNV21Rows(unsigned char *dstY, unsigned char *dstVU,
+                           const unsigned char *src, int srcStride,
+                           int width, int begin, int end)
+{
+    const ColorConvertKernels &k = getColorConvertKernels();
+
+    for (int i = begin; i < end; i++) {
+        const unsigned char *s = src + i * srcStride;
+        k.pick2(dstY + i * width, s, width);
+
+        if (!(i & 1))
+            continue;
+        if (!(width & 1)) {
+            k.yuyvToVU(dstVU + (i >> 1) * width, s, width / 2);
+        } else {
+            // V and U rows start at different offsets for odd widths
+            unsigned char *v = dstVU + (i >> 1) * 2 * (width / 2);
+            unsigned char *u = dstVU + 1 + (i >> 1) * 2 * ((width + 1) / 2);
+            for (int j = 0; j < width / 2; j++)
+                v[j * 2] = s[j * 4 + 3];
+            for (int j = 0; j < (width + 1) / 2; j++)
+                u[j * 2] = s[j * 4 + 1];
+        }
+    }
+}
+
 // covert YV12 (Y plane, V plane, U plane) to NV21 (Y plane, interlaced VU bytes)
 void convertYV12ToNV21(int width, int height, int srcStride, int dstStride, void *src, void *dst)
 {
@@ -40,29 +135,18 @@ void convertYV12ToNV21(int width, int height, int srcStride, int dstStride, void
     if (srcStride == dstStride) {
         STDCOPY((int8_t *) dst, (int8_t *) src, dstStride * height);
     } else {
-        for (int i = 0; i < height; i++) {
-            STDCOPY(dstPtr, srcPtr, width);
-            srcPtr += srcStride;
-            dstPtr += dstStride;
-        }
+        StripeExecutor::run(height, [=](int begin, int end) {
+            copyRows(dstPtr, dstStride, srcPtr, srcStride, width, begin, end);
+        });
     }
 
     // interlace the VU data
     unsigned char *srcPtrV = (unsigned char *)src + height*srcStride;
     unsigned char *srcPtrU = srcPtrV + cStride*hhalf;
     dstPtr = (unsigned char *)dst + dstStride*height;
-    for (int i = 0; i < hhalf; ++i) {
-        unsigned char *pDstVU = dstPtr;
-        unsigned char *pSrcV = srcPtrV;
-        unsigned char *pSrcU = srcPtrU;
-        for (int j = 0; j < whalf; ++j) {
-            *pDstVU ++ = *pSrcV ++;
-            *pDstVU ++ = *pSrcU ++;
-        }
-        dstPtr += vuStride;
-        srcPtrV += cStride;
-        srcPtrU += cStride;
-    }
+    StripeExecutor::run(hhalf, [=](int begin, int end) {
+        interleaveRows(dstPtr, vuStride, srcPtrV, srcPtrU, cStride, whalf, begin, end);
+    });
 }
 
 // copy YV12 to YV12 (Y plane, V plan, U plan) in case of different stride length
@@ -123,11 +207,10 @@ void convertNV12ToYV12(int width, int height, int srcStride, void *src, void *ds
         STDCOPY(dstPtr, srcPtr, ySize);
         srcPtr += ySize;
     } else if (srcStride > width) {
-        for (int i = 0; i < height; i++) {
-            STDCOPY(dstPtr, srcPtr, width);
-            srcPtr += srcStride;
-            dstPtr += yStride;
-        }
+        StripeExecutor::run(height, [=](int begin, int end) {
+            copyRows(dstPtr, yStride, srcPtr, srcStride, width, begin, end);
+        });
+        srcPtr += srcStride * height;
     } else {
         LOGE("bad src stride value");
         return;
@@ -136,15 +219,10 @@ void convertNV12ToYV12(int width, int height, int srcStride, void *src, void *ds
     // deinterlace the UV data
     int halfHeight = height / 2;
     int halfWidth = width / 2;
-    for ( int i = 0; i < halfHeight; ++i) {
-        for ( int j = 0; j < halfWidth; ++j) {
-            dstPtrV[j] = srcPtr[j * 2 + 1];
-            dstPtrU[j] = srcPtr[j * 2];
-        }
-        srcPtr += srcStride;
-        dstPtrV += cStride;
-        dstPtrU += cStride;
-    }
+    StripeExecutor::run(halfHeight, [=](int begin, int end) {
+        deinterleaveRows(dstPtrU, cStride, dstPtrV, cStride, srcPtr, srcStride,
+                         halfWidth * 2, begin, end);
+    });
 }
 
 // convert NV12 (Y plane, interlaced UV bytes) to YV12 (Y plane, V plane, U plane)
@@ -166,26 +244,20 @@ void align16ConvertNV12ToYV12(int width, int height, int srcStride, void *src, v
         STDCOPY(dstPtr, srcPtr, ySize);
         srcPtr += ySize;
     } else if (srcStride > width) {
-        for (int i = 0; i < height; i++) {
-            STDCOPY(dstPtr, srcPtr, width);
-            srcPtr += srcStride;
-            dstPtr += yStride;
-        }
+        StripeExecutor::run(height, [=](int begin, int end) {
+            copyRows(dstPtr, yStride, srcPtr, srcStride, width, begin, end);
+        });
+        srcPtr += srcStride * height;
     } else {
         LOGE("bad src stride value");
         return;
     }
 
     // deinterlace the UV data
-    for ( int i = 0; i < height / 2; ++i) {
-        for ( int j = 0; j < width / 2; ++j) {
-            dstPtrV[j] = srcPtr[j * 2 + 1];
-            dstPtrU[j] = srcPtr[j * 2];
-        }
-        srcPtr += srcStride;
-        dstPtrV += cStride;
-        dstPtrU += cStride;
-    }
+    StripeExecutor::run(height / 2, [=](int begin, int end) {
+        deinterleaveRows(dstPtrU, cStride, dstPtrV, cStride, srcPtr, srcStride,
+                         (width / 2) * 2, begin, end);
+    });
 }
 
 // P411's Y, U, V are seperated. But the YUY2's Y, U and V are interleaved.
@@ -200,65 +272,34 @@ void YUY2ToP411(int width, int height, int stride, void *src, void *dst)
     unsigned char *dstPtrU = (unsigned char *) dst + ySize;
     unsigned char *dstPtrV = (unsigned char *) dst + ySize + cSize;
 
-    for (int i = 0; i < height; i++) {
-        //The first line of the source
-        //Copy first Y Plane first
-        for (int j=0; j < width; j++) {
-            dstPtr[j] = srcPtr[j*2];
-        }
-
-        if (i & 1) {
-            //Copy the V plane
-            for (int k = 0; k < wHalf; k++) {
-                dstPtrV[k] = srcPtr[k * 4 + 3];
-            }
-            dstPtrV = dstPtrV + wHalf;
-        } else {
-            //Copy the U plane
-            for (int k = 0; k< wHalf; k++) {
-                dstPtrU[k] = srcPtr[k * 4 + 1];
-            }
-            dstPtrU = dstPtrU + wHalf;
-        }
-
-        srcPtr = srcPtr + stride * 2;
-        dstPtr = dstPtr + width;
-    }
+    StripeExecutor::run(height, [=](int begin, int end) {
+        yuy2ToPlanarRows(dstPtr, width, dstPtrU, dstPtrV, wHalf,
+                         srcPtr, stride * 2, width, begin, end);
+    });
 }
 
 // P411's Y, U, V are separated. But the NV12's U and V are interleaved.
 void NV12ToP411Separate(int width, int height, int stride,
                                 void *srcY, void *srcUV, void *dst)
 {
-    int i, j, p, q;
     unsigned char *psrcY = (unsigned char *) srcY;
     unsigned char *pdstY = (unsigned char *) dst;
     unsigned char *pdstU, *pdstV;
     unsigned char *psrcUV;
 
     // copy Y data
-    for (i = 0; i < height; i++) {
-        STDCOPY(pdstY, psrcY, width);
-        pdstY += width;
-        psrcY += stride;
-    }
+    StripeExecutor::run(height, [=](int begin, int end) {
+        copyRows(pdstY, width, psrcY, stride, width, begin, end);
+    });
 
     // copy U data and V data
     psrcUV = (unsigned char *)srcUV;
     pdstU = (unsigned char *)dst + width * height;
     pdstV = pdstU + width * height / 4;
-    p = q = 0;
-    for (i = 0; i < height / 2; i++) {
-        for (j = 0; j < width; j++) {
-            if (j % 2 == 0) {
-                pdstU[p] = (psrcUV[i * stride + j] & 0xFF);
-                p++;
-           } else {
-                pdstV[q] = (psrcUV[i * stride + j] & 0xFF);
-                q++;
-            }
-        }
-    }
+    StripeExecutor::run(height / 2, [=](int begin, int end) {
+        deinterleaveRows(pdstU, (width + 1) / 2, pdstV, width / 2,
+                         psrcUV, stride, width, begin, end);
+    });
 }
 
 // P411's Y, U, V are seperated. But the NV12's U and V are interleaved.
@@ -272,35 +313,24 @@ void NV12ToP411(int width, int height, int stride, void *src, void *dst)
 void NV21ToP411Separate(int width, int height, int stride,
                         void *srcY, void *srcUV, void *dst)
 {
-    int i, j, p, q;
     unsigned char *psrcY = (unsigned char *) srcY;
     unsigned char *pdstY = (unsigned char *) dst;
     unsigned char *pdstU, *pdstV;
     unsigned char *psrcUV;
 
     // copy Y data
-    for (i = 0; i < height; i++) {
-        STDCOPY(pdstY, psrcY, width);
-        pdstY += width;
-        psrcY += stride;
-    }
+    StripeExecutor::run(height, [=](int begin, int end) {
+        copyRows(pdstY, width, psrcY, stride, width, begin, end);
+    });
 
     // copy U data and V data
     psrcUV = (unsigned char *)srcUV;
     pdstU = (unsigned char *)dst + width * height;
     pdstV = pdstU + width * height / 4;
-    p = q = 0;
-    for (i = 0; i < height / 2; i++) {
-        for (j = 0; j < width; j++) {
-            if ((j & 1) == 0) {
-                pdstV[p] = (psrcUV[i * stride + j] & 0xFF);
-                p++;
-           } else {
-                pdstU[q] = (psrcUV[i * stride + j] & 0xFF);
-                q++;
-            }
-        }
-    }
+    StripeExecutor::run(height / 2, [=](int begin, int end) {
+        deinterleaveRows(pdstV, (width + 1) / 2, pdstU, width / 2,
+                         psrcUV, stride, width, begin, end);
+    });
 }
 
 // P411's Y, U, V are seperated. But the NV21's U and V are interleaved.
@@ -334,6 +364,21 @@ void repadYUV420(int width, int height, int srcStride, int dstStride, void *src,
         return;
     }
 
+    // separate buffers: every line is independent
+    if ((unsigned char *)dst >= (unsigned char *)src + sySize + 2*scSize ||
+        (unsigned char *)src >= (unsigned char *)dst + dySize + 2*dcSize) {
+        unsigned char *s = (unsigned char *)src;
+        unsigned char *d = (unsigned char *)dst;
+        StripeExecutor::run(height, [=](int begin, int end) {
+            copyRows(d, dstStride, s, srcStride, width, begin, end);
+        });
+        // both chroma planes as one run of lines
+        StripeExecutor::run(hhalf * 2, [=](int begin, int end) {
+            copyRows(d + dySize, dcStride, s + sySize, scStride, whalf, begin, end);
+        });
+        return;
+    }
+
     // copy V(YV12 case) or U(YU12 case) plane line by line
     sptr = (unsigned char *)src + sySize + 2*scSize - scStride;
     dptr = (unsigned char *)dst + dySize + 2*dcSize - dcStride;
@@ -371,99 +416,54 @@ void convertYUYVToYV12(int width, int height, int srcStride, int dstStride, void
 {
     int ySize = width * height;
     int cSize = ALIGN16(dstStride/2) * height / 2;
-    int wHalf = width >> 1;
 
     unsigned char *srcPtr = (unsigned char *) src;
     unsigned char *dstPtr = (unsigned char *) dst;
     unsigned char *dstPtrV = (unsigned char *) dst + ySize;
     unsigned char *dstPtrU = (unsigned char *) dst + ySize + cSize;
+    const int cStride = ALIGN16(dstStride>>1);
 
-    for (int i = 0; i < height; i++) {
-        //The first line of the source
-        //Copy first Y Plane first
-        for (int j=0; j < width; j++) {
-            dstPtr[j] = srcPtr[j*2];
-        }
-
-        if (i & 1) {
-            //Copy the V plane
-            for (int k = 0; k< wHalf; k++) {
-                dstPtrV[k] = srcPtr[k * 4 + 3];
-            }
-            dstPtrV = dstPtrV + ALIGN16(dstStride>>1);
-        } else {
-            //Copy the U plane
-            for (int k = 0; k< wHalf; k++) {
-                dstPtrU[k] = srcPtr[k * 4 + 1];
-            }
-            dstPtrU = dstPtrU + ALIGN16(dstStride>>1);
-        }
-
-        srcPtr = srcPtr + srcStride * 2;
-        dstPtr = dstPtr + width;
-    }
+    StripeExecutor::run(height, [=](int begin, int end) {
+        yuy2ToPlanarRows(dstPtr, width, dstPtrU, dstPtrV, cStride,
+                         srcPtr, srcStride * 2, width, begin, end);
+    });
 }
 
 // covert YUYV(YUY2, YUV422 format) to NV21 (Y plane, interlaced VU bytes)
 void convertYUYVToNV21(int width, int height, int srcStride, void *src, void *dst)
 {
     int ySize = width * height;
-    int u_counter=1, v_counter=0;
 
     unsigned char *srcPtr = (unsigned char *) src;
     unsigned char *dstPtr = (unsigned char *) dst;
     unsigned char *dstPtrUV = (unsigned char *) dst + ySize;
 
-    for (int i=0; i < height; i++) {
-        //The first line of the source
-        //Copy first Y Plane first
-        for (int j=0; j < width * 2; j++) {
-            if (j % 2 == 0)
-                dstPtr[j/2] = srcPtr[j];
-            if (i%2) {
-                if (( j % 4 ) == 3) {
-                    dstPtrUV[v_counter] = srcPtr[j]; //V plane
-                    v_counter += 2;
-                }
-                if (( j % 4 ) == 1) {
-                    dstPtrUV[u_counter] = srcPtr[j]; //U plane
-                    u_counter += 2;
-                }
-            }
-        }
-
-        srcPtr = srcPtr + srcStride * 2;
-        dstPtr = dstPtr + width;
-    }
+    StripeExecutor::run(height, [=](int begin, int end) {
+        yuyvToNV21Rows(dstPtr, dstPtrUV, srcPtr, srcStride * 2, width, begin, end);
+    });
 }
 
 void convertNV12ToYUYV(int srcWidth, int srcHeight, int srcStride, int dstStride, const void *src, void *dst)
 {
-    int y_counter = 0, u_counter = 1, v_counter = 3, uv_counter = 0;
+    const ColorConvertKernels &k = getColorConvertKernels();
     unsigned char *srcYPtr = (unsigned char *) src;
     unsigned char *srcUVPtr = (unsigned char *)src + srcWidth * srcHeight;
     unsigned char *dstPtr = (unsigned char *) dst;
 
+    // Each line stores Y to the even bytes of its first 2 * srcWidth bytes
+    // and 2 * srcWidth chroma bytes to the odd bytes of 4 * srcWidth bytes.
+    // The lines may overlap, so they are kept in order.
     for (int i = 0; i < srcHeight; i++) {
-        for (int k = 0; k < srcWidth; k++) {
-                dstPtr[y_counter] = srcYPtr[k];
-                y_counter += 2;
-                dstPtr[u_counter] = srcUVPtr[uv_counter];
-                u_counter += 4;
-                dstPtr[v_counter] = srcUVPtr[uv_counter + 1];
-                v_counter += 4;
-                uv_counter += 2;
-        }
+        k.interleave(dstPtr, srcYPtr, srcUVPtr, srcWidth);
+        for (int m = srcWidth; m < 2 * srcWidth; m++)
+            dstPtr[2 * m + 1] = srcUVPtr[m];
+
         if ((i % 2) == 0) {
             srcUVPtr = srcUVPtr + srcStride;
         }
 
         dstPtr = dstPtr + 2 * dstStride;
         srcYPtr = srcYPtr + srcStride;
-        u_counter = 1;
-        v_counter = 3;
-        y_counter = 0;
-        uv_counter = 0;
     }
 }
 
@@ -19,6 +19,7 @@
 
 #include "LogHelper.h"
 #include "ImageScalerCore.h"
+#include "StripeExecutor.h"
 #include <libyuv.h>
 #include <linux/videodev2.h>
 
@@ -83,13 +84,24 @@ void ImageScalerCore::downScaleYUY2Image(unsigned char *dest, const unsigned cha
 
     const int scale_w = (src_w<<8) / dest_w; // scale factors
     const int scale_h = (src_h<<8) / dest_h;
-    int dx, dy;
     int macro_pixel_width = dest_w >> 1;
+
+    StripeExecutor::run(dest_h, [=](int begin, int end) {
+        downScaleYUY2Rows(dest, src, dest_stride, src_stride,
+                          scale_w, scale_h, macro_pixel_width, begin, end);
+    });
+}
+
+void ImageScalerCore::downScaleYUY2Rows(unsigned char *dest, const unsigned char *src,
+    int dest_stride, int src_stride, int scale_w, int scale_h,
+    int macro_pixel_width, int begin, int end)
+{
     int src_i, src_j; // the left up coordinates of src that correspond to (j,i) in dest
     unsigned int val_1, val_2; // for bi-linear-interpolation
+    int dx, dy;
     int i,j,k;
 
-    for(i=0; i < dest_h; ++i) {
+    for(i=begin; i < end; ++i) {
         src_i = i * scale_h;
         dy = src_i & 0xff;
         src_i >>= 8;
@@ -158,16 +170,23 @@ void ImageScalerCore::downScaleAndCropNv12Image(unsigned char *dest, const unsig
     uint8_t *src_y = (uint8_t *)src + offset;
     uint8_t *src_uv = (uint8_t *)src + total_height * src_stride + offset/2;
 
-    libyuv::ScalePlane(src_y, src_stride, width, height,
-                       dest, dest_stride, dest_w, dest_h,
-                       libyuv::kFilterNone);
+    uint8_t *dest_uv = dest + dest_stride * dest_h;
 
-    dest += dest_stride * dest_h;
-    libyuv::ScalePlane_16((uint16_t *)src_uv, src_stride/2,
-                          width/2, height/2,
-                          (uint16_t *)dest, dest_stride/2,
-                          dest_w/2, dest_h/2,
-                          libyuv::kFilterNone);
+    // libyuv picks its own source rows, so the planes are the unit of work
+    StripeExecutor::run(2, [=](int begin, int end) {
+        for (int plane = begin; plane < end; plane++) {
+            if (plane == 0)
+                libyuv::ScalePlane(src_y, src_stride, width, height,
+                                   dest, dest_stride, dest_w, dest_h,
+                                   libyuv::kFilterNone);
+            else
+                libyuv::ScalePlane_16((uint16_t *)src_uv, src_stride/2,
+                                      width/2, height/2,
+                                      (uint16_t *)dest_uv, dest_stride/2,
+                                      dest_w/2, dest_h/2,
+                                      libyuv::kFilterNone);
+        }
+    }, 1, 1);
 }
 
 void ImageScalerCore::cropComposeCopy(void *src, void *dst, unsigned int size)
@@ -184,10 +203,6 @@ void ImageScalerCore::cropComposeUpscaleNV12_bl(
     unsigned int dstCropLeft, unsigned int dstCropTop,
     unsigned int dstCropW, unsigned int dstCropH)
 {
-    static const int BILINEAR = 1;
-    static const unsigned int FP_1  = 1 << MFP;       // Fixed point 1.0
-    static const unsigned int FRACT = (1 << MFP) - 1; // Fractional part mask
-    unsigned int dx, dy, sx, sy;
     unsigned char *s = (unsigned char *)src;
     unsigned char *d = (unsigned char *)dst;
     unsigned int sx0, sy0, dx0, dy0, dx1, dy1;
@@ -207,7 +222,42 @@ void ImageScalerCore::cropComposeUpscaleNV12_bl(
     dy0 = dstCropTop;
     dx1 = dstCropLeft + dstCropW;
     dy1 = dstCropTop + dstCropH;
-    for (dy = dy0, sy = sy0; dy < dy1; dy++, sy += syd) {
+    // the start position of a stripe wraps around like the running sum of
+    // the single threaded loop did, so the result does not depend on stripes
+    StripeExecutor::run(dy1 - dy0, [=](int begin, int end) {
+        cropComposeUpscaleLumaRows(s, srcStride, d, dstStride,
+                                   sx0, sxd, sy0 + begin * syd, syd,
+                                   dx0, dx1, dy0 + begin, dy0 + end);
+    });
+
+    // Upscale chrominance
+    s = (unsigned char *)src + srcStride*srcH;
+    d = (unsigned char *)dst + dstStride*dstH;
+    sx0 = srcCropLeft << (MFP - 1);
+    sy0 = srcCropTop << (MFP - 1);
+    dx0 = dstCropLeft >> 1;
+    dy0 = dstCropTop >> 1;
+    dx1 = (dstCropLeft + dstCropW) >> 1;
+    dy1 = (dstCropTop + dstCropH) >> 1;
+    StripeExecutor::run(dy1 - dy0, [=](int begin, int end) {
+        cropComposeUpscaleChromaRows(s, srcStride, d, dstStride,
+                                     sx0, sxd, sy0 + begin * syd, syd,
+                                     dx0, dx1, dy0 + begin, dy0 + end);
+    });
+}
+
+void ImageScalerCore::cropComposeUpscaleLumaRows(
+    const unsigned char *s, unsigned int srcStride,
+    unsigned char *d, unsigned int dstStride,
+    unsigned int sx0, unsigned int sxd, unsigned int sy, unsigned int syd,
+    unsigned int dx0, unsigned int dx1, unsigned int dyBegin, unsigned int dyEnd)
+{
+    static const int BILINEAR = 1;
+    static const unsigned int FP_1  = 1 << MFP;       // Fixed point 1.0
+    static const unsigned int FRACT = (1 << MFP) - 1; // Fractional part mask
+    unsigned int dx, dy, sx;
+
+    for (dy = dyBegin; dy < dyEnd; dy++, sy += syd) {
         for (dx = dx0, sx = sx0; dx < dx1; dx++, sx += sxd) {
             unsigned int sxi = sx >> MFP;
             unsigned int syi = sy >> MFP;
@@ -227,17 +277,17 @@ void ImageScalerCore::cropComposeUpscaleNV12_bl(
             d[dstStride*dy+dx] = s0;
         }
     }
+}
 
-    // Upscale chrominance
-    s = (unsigned char *)src + srcStride*srcH;
-    d = (unsigned char *)dst + dstStride*dstH;
-    sx0 = srcCropLeft << (MFP - 1);
-    sy0 = srcCropTop << (MFP - 1);
-    dx0 = dstCropLeft >> 1;
-    dy0 = dstCropTop >> 1;
-    dx1 = (dstCropLeft + dstCropW) >> 1;
-    dy1 = (dstCropTop + dstCropH) >> 1;
-    for (dy = dy0, sy = sy0; dy < dy1; dy++, sy += syd) {
+void ImageScalerCore::cropComposeUpscaleChromaRows(
+    const unsigned char *s, unsigned int srcStride,
+    unsigned char *d, unsigned int dstStride,
+    unsigned int sx0, unsigned int sxd, unsigned int sy, unsigned int syd,
+    unsigned int dx0, unsigned int dx1, unsigned int dyBegin, unsigned int dyEnd)
+{
+    unsigned int dx, dy, sx;
+
+    for (dy = dyBegin; dy < dyEnd; dy++, sy += syd) {
         for (dx = dx0, sx = sx0; dx < dx1; dx++, sx += sxd) {
             unsigned int sxi = sx >> MFP;
             unsigned int syi = sy >> MFP;
@@ -246,5 +296,119 @@ void ImageScalerCore::cropComposeUpscaleNV12_bl(
         }
     }
 }
+
+void ImageScalerCore::buildScaleTaps(std::vector<ScaleTaps> &taps, unsigned int count,
+    unsigned int start, unsigned int size, unsigned int step, bool mirror)
+{
+    static const unsigned int FRACT = (1 << MFP) - 1;
+    const unsigned int last = start + size - 1;
+
+    taps.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int j = mirror ? count - 1 - i : i;
+        unsigned int pos = (start << MFP) + j * step;
+        unsigned int index = pos >> MFP;
+
+        if (index >= last) {
+            taps[i].index = last;
+            taps[i].next = last;
+            taps[i].frac = 0;
+        } else {
+            taps[i].index = index;
+            taps[i].next = index + 1;
+            taps[i].frac = pos & FRACT;
+        }
+    }
+}
+
+// luma rows 2 * band and 2 * band + 1, chroma row band
+void ImageScalerCore::cropScaleBand(
+    const unsigned char *srcY, const unsigned char *srcUV, unsigned int srcStride,
+    unsigned char *dstY, unsigned char *dstUV, unsigned int dstStride,
+    const ScaleTaps *lumaX, const ScaleTaps *lumaY,
+    const ScaleTaps *chromaX, const ScaleTaps *chromaY,
+    unsigned int dstW, unsigned int dstH, bool swapUV,
+    unsigned int band)
+{
+    static const unsigned int FP_1 = 1 << MFP;
+
+    for (unsigned int y = band * 2; y < band * 2 + 2 && y < dstH; y++) {
+        const unsigned char *r0 = srcY + lumaY[y].index * srcStride;
+        const unsigned char *r1 = srcY + lumaY[y].next * srcStride;
+        unsigned int fy = lumaY[y].frac;
+        unsigned int fy1 = FP_1 - fy;
+        unsigned char *d = dstY + y * dstStride;
+
+        for (unsigned int x = 0; x < dstW; x++) {
+            const ScaleTaps &t = lumaX[x];
+            unsigned int fx1 = FP_1 - t.frac;
+            unsigned int top = (r0[t.index] * fx1 + r0[t.next] * t.frac) >> MFP;
+            unsigned int bottom = (r1[t.index] * fx1 + r1[t.next] * t.frac) >> MFP;
+            d[x] = (top * fy1 + bottom * fy) >> MFP;
+        }
+    }
+
+    if (band >= dstH / 2)
+        return;
+
+    const unsigned char *c0 = srcUV + chromaY[band].index * srcStride;
+    const unsigned char *c1 = srcUV + chromaY[band].next * srcStride;
+    unsigned int fy = chromaY[band].frac;
+    unsigned int fy1 = FP_1 - fy;
+    unsigned char *d = dstUV + band * dstStride;
+    const unsigned int first = swapUV ? 1 : 0;
+
+    for (unsigned int x = 0; x < dstW / 2; x++) {
+        const ScaleTaps &t = chromaX[x];
+        unsigned int fx1 = FP_1 - t.frac;
+        unsigned int i0 = t.index * 2, i1 = t.next * 2;
+        for (unsigned int c = 0; c < 2; c++) {
+            unsigned int top = (c0[i0 + c] * fx1 + c0[i1 + c] * t.frac) >> MFP;
+            unsigned int bottom = (c1[i0 + c] * fx1 + c1[i1 + c] * t.frac) >> MFP;
+            d[x * 2 + (c ^ first)] = (top * fy1 + bottom * fy) >> MFP;
+        }
+    }
+}
+
+void ImageScalerCore::cropScaleNV12Or21(
+    const void *src, unsigned int srcH, unsigned int srcStride, bool srcNV21,
+    unsigned int srcCropLeft, unsigned int srcCropTop,
+    unsigned int srcCropW, unsigned int srcCropH,
+    void *dst, unsigned int dstW, unsigned int dstH, unsigned int dstStride,
+    bool dstNV21, bool mirror)
+{
+    if (!src || !dst) {
+        LOGE("buffer pointer is nullptr");
+        return;
+    }
+    if (srcCropW < 2 || srcCropH < 2 || dstW < 2 || dstH < 2) {
+        LOGE("@%s: invalid size, crop %ux%u, dst %ux%u", __FUNCTION__,
+             srcCropW, srcCropH, dstW, dstH);
+        return;
+    }
+
+    unsigned int sxd = ((srcCropW<<MFP) + (dstW>>1)) / dstW;
+    unsigned int syd = ((srcCropH<<MFP) + (dstH>>1)) / dstH;
+
+    std::vector<ScaleTaps> lumaX, lumaY, chromaX, chromaY;
+    buildScaleTaps(lumaX, dstW, srcCropLeft, srcCropW, sxd, mirror);
+    buildScaleTaps(lumaY, dstH, srcCropTop, srcCropH, syd, false);
+    buildScaleTaps(chromaX, dstW / 2, srcCropLeft / 2, srcCropW / 2, sxd, mirror);
+    buildScaleTaps(chromaY, dstH / 2, srcCropTop / 2, srcCropH / 2, syd, false);
+
+    const unsigned char *srcY = (const unsigned char *)src;
+    const unsigned char *srcUV = srcY + srcStride * srcH;
+    unsigned char *dstY = (unsigned char *)dst;
+    unsigned char *dstUV = dstY + dstStride * dstH;
+    const ScaleTaps *lx = lumaX.data(), *ly = lumaY.data();
+    const ScaleTaps *cx = chromaX.data(), *cy = chromaY.data();
+    bool swapUV = srcNV21 != dstNV21;
+
+    StripeExecutor::run((dstH + 1) / 2, [=](int begin, int end) {
+        for (int band = begin; band < end; band++)
+            cropScaleBand(srcY, srcUV, srcStride, dstY, dstUV, dstStride,
+                          lx, ly, cx, cy, dstW, dstH, swapUV, band);
+    }, 1, StripeExecutor::kMinStripeRows / 2);
+}
 } NAMESPACE_DECLARATION_END
 
@@ -18,6 +18,7 @@
 #ifndef _IMAGESCALER_CORE_H_
 #define _IMAGESCALER_CORE_H_
 #include <memory>
+#include <vector>
 #include "CommonBuffer.h"
 
 NAMESPACE_DECLARATION {
@@ -52,6 +53,36 @@ private:
 
 private:
     static void cropComposeCopy(void *src, void *dst, unsigned int size);
+
+    /* row kernels, process destination rows [begin, end) */
+    static void downScaleYUY2Rows(unsigned char *dest, const unsigned char *src,
+        int dest_stride, int src_stride, int scale_w, int scale_h,
+        int macro_pixel_width, int begin, int end);
+    static void cropComposeUpscaleLumaRows(
+        const unsigned char *s, unsigned int srcStride,
+        unsigned char *d, unsigned int dstStride,
+        unsigned int sx0, unsigned int sxd, unsigned int sy, unsigned int syd,
+        unsigned int dx0, unsigned int dx1, unsigned int dyBegin, unsigned int dyEnd);
+    static void cropComposeUpscaleChromaRows(
+        const unsigned char *s, unsigned int srcStride,
+        unsigned char *d, unsigned int dstStride,
+        unsigned int sx0, unsigned int sxd, unsigned int sy, unsigned int syd,
+        unsigned int dx0, unsigned int dx1, unsigned int dyBegin, unsigned int dyEnd);
+
+    struct ScaleTaps {
+        unsigned int index; /*!< first source sample */
+        unsigned int next;  /*!< second source sample, clamped to the crop */
+        unsigned int frac;  /*!< weight of the second sample, MFP bits */
+    };
+    static void buildScaleTaps(std::vector<ScaleTaps> &taps, unsigned int count,
+        unsigned int start, unsigned int size, unsigned int step, bool mirror);
+    static void cropScaleBand(
+        const unsigned char *srcY, const unsigned char *srcUV, unsigned int srcStride,
+        unsigned char *dstY, unsigned char *dstUV, unsigned int dstStride,
+        const ScaleTaps *lumaX, const ScaleTaps *lumaY,
+        const ScaleTaps *chromaX, const ScaleTaps *chromaY,
+        unsigned int dstW, unsigned int dstH, bool swapUV,
+        unsigned int band);
 public:
     static void cropComposeUpscaleNV12_bl(
         void *src, unsigned int srcH, unsigned int srcStride,
@@ -61,6 +92,19 @@ public:
         unsigned int dstCropLeft, unsigned int dstCropTop,
         unsigned int dstCropW, unsigned int dstCropH);
 
+    /*
+     * Crop, bilinear scale (luma and chroma), optional horizontal mirror
+     * and NV12 <-> NV21 conversion in a single pass over memory.
+     * Output rows are produced in luma pair + chroma row bands so the
+     * source lines are read while still in cache.
+     */
+    static void cropScaleNV12Or21(
+        const void *src, unsigned int srcH, unsigned int srcStride, bool srcNV21,
+        unsigned int srcCropLeft, unsigned int srcCropTop,
+        unsigned int srcCropW, unsigned int srcCropH,
+        void *dst, unsigned int dstW, unsigned int dstH, unsigned int dstStride,
+        bool dstNV21, bool mirror);
+
 };
 
 } NAMESPACE_DECLARATION_END
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "StripeExecutor"
+
+#include <sys/prctl.h>
+#include "LogHelper.h"
+#include "StripeExecutor.h"
+
+NAMESPACE_DECLARATION {
+
+const int StripeExecutor::kMinStripeRows;
+const int StripeExecutor::kMaxThreads;
+
+StripeExecutor &StripeExecutor::getInstance()
+{
+    static StripeExecutor sInstance;
+    return sInstance;
+}
+
+StripeExecutor::StripeExecutor() :
+    mJob(nullptr),
+    mJobSeq(0),
+    mExit(false)
+{
+    int threads = std::thread::hardware_concurrency();
+    if (threads > kMaxThreads)
+        threads = kMaxThreads;
+
+    // the caller of run() is the first worker
+    for (int i = 1; i < threads; i++)
+        mWorkers.push_back(std::thread(&StripeExecutor::workerLoop, this));
+
+    LOGI("@%s: %zu stripe workers", __FUNCTION__, mWorkers.size());
+}
+
+StripeExecutor::~StripeExecutor()
+{
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        mExit = true;
+    }
+    mWorkCond.notify_all();
+    for (auto &worker : mWorkers)
+        worker.join();
+}
+
+void StripeExecutor::run(int rows, const StripeFunc &func, int align, int minRows)
+{
+    if (rows <= 0)
+        return;
+
+    getInstance().execute(rows, func, align, minRows);
+}
+
+int StripeExecutor::concurrency()
+{
+    return getInstance().mWorkers.size() + 1;
+}
+
+void StripeExecutor::execute(int rows, const StripeFunc &func, int align, int minRows)
+{
+    int stripes = mWorkers.size() + 1;
+    if (minRows < 1)
+        minRows = 1;
+    if (rows / minRows < stripes)
+        stripes = rows / minRows;
+
+    std::unique_lock<std::mutex> runLock(mRunLock, std::try_to_lock);
+    if (stripes < 2 || !runLock.owns_lock()) {
+        func(0, rows);
+        return;
+    }
+
+    Job job;
+    job.func = &func;
+    job.rows = rows;
+    job.align = align < 1 ? 1 : align;
+    job.stripes = stripes;
+    job.next = 0;
+    job.done = 0;
+    job.users = 0;
+
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        mJob = &job;
+        mJobSeq++;
+    }
+    mWorkCond.notify_all();
+
+    runStripes(&job);
+
+    std::unique_lock<std::mutex> l(mLock);
+    mDoneCond.wait(l, [&job] { return job.done == job.stripes && job.users == 0; });
+    mJob = nullptr;
+}
+
+void StripeExecutor::runStripes(Job *job)
+{
+    int i;
+    while ((i = job->next++) < job->stripes) {
+        int begin = (int64_t)job->rows * i / job->stripes;
+        int end = (int64_t)job->rows * (i + 1) / job->stripes;
+        begin -= begin % job->align;
+        if (i + 1 < job->stripes)
+            end -= end % job->align;
+        else
+            end = job->rows;
+        if (end > begin)
+            (*job->func)(begin, end);
+        job->done++;
+    }
+}
+
+void StripeExecutor::workerLoop()
+{
+    prctl(PR_SET_NAME, (unsigned long)"StripeWorker", 0, 0, 0);
+
+    unsigned int seenSeq = 0;
+    std::unique_lock<std::mutex> l(mLock);
+    while (true) {
+        mWorkCond.wait(l, [this, &seenSeq] { return mExit || mJobSeq != seenSeq; });
+        if (mExit)
+            break;
+        seenSeq = mJobSeq;
+
+        Job *job = mJob;
+        if (job == nullptr)
+            continue;
+        job->users++;
+        l.unlock();
+
+        runStripes(job);
+
+        l.lock();
+        job->users--;
+        if (job->done == job->stripes && job->users == 0)
+            mDoneCond.notify_all();
+    }
+}
+
+} NAMESPACE_DECLARATION_END
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CAMERA3_HAL_STRIPE_EXECUTOR_H_
+#define _CAMERA3_HAL_STRIPE_EXECUTOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "UtilityMacros.h"
+
+NAMESPACE_DECLARATION {
+/**
+ * \class StripeExecutor
+ *
+ * Splits a software image kernel into horizontal stripes and runs them on
+ * a small process wide worker pool. The calling thread takes part in the
+ * work and run() returns once every stripe is done.
+ *
+ * Kernels must produce each output row only from the stripe bounds they are
+ * given (no state carried across rows), so the result is identical to a
+ * single threaded run.
+ *
+ * Only one job runs on the pool at a time; a concurrent or nested run()
+ * executes the whole range on the calling thread.
+ */
+class StripeExecutor {
+public:
+    /* func(begin, end) processes rows [begin, end) */
+    typedef std::function<void(int, int)> StripeFunc;
+
+    /**
+     * \param rows      number of rows of the job
+     * \param func      kernel for one stripe
+     * \param align     stripe boundaries are multiples of this (e.g. 2 for
+     *                  4:2:0 chroma pairs)
+     * \param minRows   smallest stripe worth handing to another thread
+     */
+    static void run(int rows, const StripeFunc &func,
+                    int align = 1, int minRows = kMinStripeRows);
+
+    /* number of threads a job can run on, the caller included */
+    static int concurrency();
+
+    static const int kMinStripeRows = 32;
+
+private:
+    struct Job {
+        const StripeFunc *func;
+        int rows;
+        int align;
+        int stripes;
+        std::atomic<int> next;
+        std::atomic<int> done;
+        int users;
+    };
+
+    StripeExecutor();
+    ~StripeExecutor();
+    static StripeExecutor &getInstance();
+
+    void execute(int rows, const StripeFunc &func, int align, int minRows);
+    void runStripes(Job *job);
+    void workerLoop();
+
+private:
+    static const int kMaxThreads = 6;
+
+    std::mutex mRunLock;        /*!< one job at a time */
+    std::mutex mLock;           /*!< protects mJob, mJobSeq, mExit */
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    Job *mJob;
+    unsigned int mJobSeq;
+    bool mExit;
+    std::vector<std::thread> mWorkers;
+};
+
+} NAMESPACE_DECLARATION_END
+#endif // _CAMERA3_HAL_STRIPE_EXECUTOR_H_
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EncodeBufferArena"
+
+#include <stdlib.h>
+#include "LogHelper.h"
+#include "Camera3V4l2Format.h"
+#include "EncodeBufferArena.h"
+
+NAMESPACE_DECLARATION {
+
+const size_t EncodeBufferArena::kMinClassSize;
+const unsigned int EncodeBufferArena::kMaxIdlePerClass;
+
+std::shared_ptr<EncodeBufferArena> EncodeBufferArena::create()
+{
+    return std::shared_ptr<EncodeBufferArena>(new EncodeBufferArena());
+}
+
+EncodeBufferArena::EncodeBufferArena() :
+    mAllocs(0),
+    mReuses(0)
+{
+}
+
+EncodeBufferArena::~EncodeBufferArena()
+{
+    LOGI("@%s: %u allocations, %u reuses", __FUNCTION__, mAllocs, mReuses);
+    trim();
+}
+
+/**
+ * Rounds up to 1/8 of the enclosing power of two, so a class wastes at most
+ * 12.5% while sizes a few lines apart still share it.
+ */
+size_t EncodeBufferArena::sizeClass(size_t size)
+{
+    if (size <= kMinClassSize)
+        return kMinClassSize;
+
+    size_t pow2 = kMinClassSize;
+    while (pow2 * 2 <= size)
+        pow2 *= 2;
+    size_t granule = pow2 / 8;
+
+    return (size + granule - 1) / granule * granule;
+}
+
+std::shared_ptr<CommonBuffer> EncodeBufferArena::acquire(const BufferProps &props)
+{
+    if (props.type != BMT_HEAP) {
+        LOGE("@%s: only heap buffers are supported", __FUNCTION__);
+        return nullptr;
+    }
+
+    size_t size = props.size > 0 ? props.size
+                                 : frameSize(props.format, props.stride, props.height);
+    if (size == 0) {
+        LOGE("@%s: invalid buffer %dx%d fmt:%x", __FUNCTION__,
+             props.width, props.height, props.format);
+        return nullptr;
+    }
+    size_t cls = sizeClass(size);
+
+    void *block = nullptr;
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        auto it = mFree.find(cls);
+        if (it != mFree.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+            mReuses++;
+        } else {
+            mAllocs++;
+        }
+    }
+
+    if (!block) {
+        block = malloc(cls);
+        if (!block) {
+            LOGE("@%s: failed to allocate %zu bytes", __FUNCTION__, cls);
+            return nullptr;
+        }
+        LOGI("@%s: new block of %zu bytes for %dx%d", __FUNCTION__,
+             cls, props.width, props.height);
+    }
+
+    std::weak_ptr<EncodeBufferArena> arena = shared_from_this();
+    CommonBuffer *buf = new CommonBuffer(props, block);
+    return std::shared_ptr<CommonBuffer>(buf, [arena, cls, block](CommonBuffer *b) {
+        recycle(arena, cls, block, b);
+    });
+}
+
+void EncodeBufferArena::recycle(std::weak_ptr<EncodeBufferArena> arena,
+                                size_t cls, void *block, CommonBuffer *buf)
+{
+    delete buf;
+
+    std::shared_ptr<EncodeBufferArena> self = arena.lock();
+    if (self) {
+        std::lock_guard<std::mutex> l(self->mLock);
+        std::vector<void*> &freeList = self->mFree[cls];
+        if (freeList.size() < kMaxIdlePerClass) {
+            freeList.reserve(kMaxIdlePerClass);
+            freeList.push_back(block);
+            return;
+        }
+    }
+
+    free(block);
+}
+
+void EncodeBufferArena::trim()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    for (auto &cls : mFree) {
+        for (void *block : cls.second)
+            free(block);
+        cls.second.clear();
+    }
+}
+
+} NAMESPACE_DECLARATION_END
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CAMERA3_HAL_ENCODE_BUFFER_ARENA_H_
+#define _CAMERA3_HAL_ENCODE_BUFFER_ARENA_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "CommonBuffer.h"
+
+NAMESPACE_DECLARATION {
+/**
+ * \class EncodeBufferArena
+ *
+ * Heap memory for the intermediate buffers of the software JPEG encoder
+ * (YU12 staging, scaled main and thumbnail inputs, thumbnail output).
+ *
+ * Requests are rounded up to a size class, so buffers of nearby
+ * resolutions share the same blocks. A released block goes back to the
+ * free list of its class instead of the system allocator, and is handed
+ * out again to the next request of that class.
+ *
+ * The returned CommonBuffer does not own its memory; dropping the last
+ * reference recycles the block. Blocks released after the arena is gone
+ * are freed.
+ */
+class EncodeBufferArena : public std::enable_shared_from_this<EncodeBufferArena> {
+public:
+    static std::shared_ptr<EncodeBufferArena> create();
+    ~EncodeBufferArena();
+
+    /* props.type must be BMT_HEAP, props.size overrides the frame size */
+    std::shared_ptr<CommonBuffer> acquire(const BufferProps &props);
+
+    /* release every idle block */
+    void trim();
+
+private:
+    EncodeBufferArena();
+    static size_t sizeClass(size_t size);
+    static void recycle(std::weak_ptr<EncodeBufferArena> arena,
+                        size_t cls, void *block, CommonBuffer *buf);
+
+private:
+    static const size_t kMinClassSize = 4096;
+    static const unsigned int kMaxIdlePerClass = 2;
+
+    std::mutex mLock;       /*!< protects mFree and the counters */
+    std::map<size_t, std::vector<void*>> mFree; /*!< size class -> idle blocks */
+    unsigned int mAllocs;   /*!< blocks taken from the system allocator */
+    unsigned int mReuses;   /*!< requests served from the free lists */
+};
+
+} NAMESPACE_DECLARATION_END
+#endif // _CAMERA3_HAL_ENCODE_BUFFER_ARENA_H_
@@ -27,20 +27,37 @@
 
 #include "ColorConverter.h"
 #include "jpeg_compressor.h"
+#include "JpegStripEncoder.h"
 
 NAMESPACE_DECLARATION {
+/**
+ * \struct SwEncodeContext
+ * A libjpeg compressor together with its YU12 staging buffer.
+ * arc::JpegCompressor reads NV12 and NV21 directly; YUYV is converted to
+ * YU12 in the staging buffer first.
+ * Large images are split across the compressors of stripEncoder.
+ */
+struct ImgEncoderCore::SwEncodeContext {
+    arc::JpegCompressor compressor;
+    JpegStripEncoder stripEncoder;
+    std::shared_ptr<CommonBuffer> yu12;
+};
+
 ImgEncoderCore::ImgEncoderCore() :
     mThumbOutBuf(nullptr),
     mJpegDataBuf(nullptr),
     mMainScaled(nullptr),
     mThumbScaled(nullptr),
-    mJpegSetting(nullptr)
+    mJpegSetting(nullptr),
+    mArena(EncodeBufferArena::create()),
+    mJpegStrips(0)
 {
     LOGI("@%s", __FUNCTION__);
 
-    mInternalYU12Size =
-        RESOLUTION_14MP_WIDTH * RESOLUTION_14MP_HEIGHT * 3 / 2;
-    mInternalYU12.reset(new char[mInternalYU12Size]);
+    // 0 picks the strip count by image size, 1 encodes in one piece
+    char property_value[PROPERTY_VALUE_MAX] = {0};
+    property_get("persist.vendor.camera.jpeg.strips", property_value, "0");
+    mJpegStrips = atoi(property_value);
 }
 
 ImgEncoderCore::~ImgEncoderCore()
@@ -68,8 +85,40 @@ void ImgEncoderCore::deInit(void)
     }
 
     mThumbOutBuf.reset();
+    mThumbScaled.reset();
+    mMainScaled.reset();
 
     mJpegDataBuf.reset();
+
+    {
+        std::lock_guard<std::mutex> l(mContextLock);
+        mIdleContexts.clear();
+    }
+    mArena->trim();
+}
+
+/**
+ * acquireHeapBuffer
+ * Get an intermediate heap buffer backed by the encoder arena
+ *
+ * \param size [IN] overrides the frame size of the format if > 0
+ */
+std::shared_ptr<CommonBuffer> ImgEncoderCore::acquireHeapBuffer(int width, int height,
+                                                                int format, int size)
+{
+    BufferProps props;
+    props.width  = width;
+    props.height = height;
+    props.stride = width;
+    props.format = format;
+    props.size   = size;
+    props.type   = BMT_HEAP;
+    // Using width as stride for heap buffer
+    std::shared_ptr<CommonBuffer> buf = mArena->acquire(props);
+    if (!buf)
+        LOGE("Error in allocating %dx%d buffer", width, height);
+
+    return buf;
 }
 
 /**
@@ -97,22 +146,10 @@ void ImgEncoderCore::thumbBufferDownScale(EncodePackage & pkg)
                 mThumbScaled.reset();
             }
             if (!mThumbScaled) {
-                BufferProps props;
-                props.width  = thumbwidth;
-                props.height = thumbheight;
-                props.stride = thumbwidth;
-                props.format = pkg.thumb->v4l2Fmt();
-                props.type   = BMT_HEAP;
-                // Using thumbwidth as stride for heap buffer
-                mThumbScaled = std::make_shared<CommonBuffer>(props);
-                if (!mThumbScaled) {
-                    LOGE("Error in creating shared_ptr mThumbScaled");
-                    return;
-                }
-                if (mThumbScaled->allocMemory()) {
-                    LOGE("Error in allocating buffer with size:%d", mThumbScaled->size());
+                mThumbScaled = acquireHeapBuffer(thumbwidth, thumbheight,
+                                                 pkg.thumb->v4l2Fmt());
+                if (!mThumbScaled)
                     return;
-                }
             }
             ImageScalerCore::downScaleImage(pkg.thumb, mThumbScaled);
             pkg.thumb = mThumbScaled;
@@ -143,22 +180,10 @@ void ImgEncoderCore::mainBufferDownScale(EncodePackage & pkg)
             mMainScaled.reset();
         }
         if (!mMainScaled) {
-            BufferProps props;
-            props.width  = pkg.jpegOut->width();
-            props.height = pkg.jpegOut->height();
-            props.stride = pkg.jpegOut->width();
-            props.format = pkg.main->v4l2Fmt();
-            props.type   = BMT_HEAP;
-            // Use pkg.jpegOut->width() as stride for the heap buffer
-            mMainScaled = std::make_shared<CommonBuffer>(props);
-            if (!mMainScaled) {
-                LOGE("Error in creating shared_ptr mMainScaled");
-                return;
-            }
-            if (mMainScaled->allocMemory()) {
-                LOGE("Error in allocating buffer with size:%d", mMainScaled->size());
+            mMainScaled = acquireHeapBuffer(pkg.jpegOut->width(), pkg.jpegOut->height(),
+                                            pkg.main->v4l2Fmt());
+            if (!mMainScaled)
                 return;
-            }
         }
         ImageScalerCore::downScaleImage(pkg.main, mMainScaled);
         pkg.main = mMainScaled;
@@ -241,23 +266,10 @@ status_t ImgEncoderCore::allocateBufferAndDownScale(EncodePackage & pkg)
                 return UNKNOWN_ERROR;
             }
 
-            BufferProps props;
-            props.width  = thumbwidth;
-            props.height = thumbheight;
-            props.stride = thumbwidth;
-            props.format = pkg.thumb->v4l2Fmt();
-            props.type   = BMT_HEAP;
-            props.size = minThumbBufSize;
-            // Use thumbwidth as stride for the heap buffer
-            mThumbOutBuf = std::make_shared<CommonBuffer>(props);
-            if (!mThumbOutBuf) {
-                LOGE("Error in creating shared_ptr mThumbOutBuf");
-                return NO_MEMORY;
-            }
-            if (mThumbOutBuf->allocMemory()) {
-                LOGE("Error in allocating buffer with size:%d", mThumbOutBuf->size());
+            mThumbOutBuf = acquireHeapBuffer(thumbwidth, thumbheight,
+                                             pkg.thumb->v4l2Fmt(), minThumbBufSize);
+            if (!mThumbOutBuf)
                 return NO_MEMORY;
-            }
         }
     }
 
@@ -294,6 +306,31 @@ status_t ImgEncoderCore::getJpegSettings(EncodePackage & pkg, ExifMetaData& meta
     return status;
 }
 
+std::unique_ptr<ImgEncoderCore::SwEncodeContext> ImgEncoderCore::acquireEncodeContext()
+{
+    std::unique_ptr<SwEncodeContext> ctx;
+    {
+        std::lock_guard<std::mutex> l(mContextLock);
+        if (!mIdleContexts.empty()) {
+            ctx = std::move(mIdleContexts.back());
+            mIdleContexts.pop_back();
+        }
+    }
+
+    if (!ctx) {
+        LOGI("@%s: creating software encoder context", __FUNCTION__);
+        ctx.reset(new SwEncodeContext);
+    }
+
+    return ctx;
+}
+
+void ImgEncoderCore::releaseEncodeContext(std::unique_ptr<SwEncodeContext> ctx)
+{
+    std::lock_guard<std::mutex> l(mContextLock);
+    mIdleContexts.push_back(std::move(ctx));
+}
+
 int ImgEncoderCore::doSwEncode(std::shared_ptr<CommonBuffer> srcBuf,
                                int quality,
                                std::shared_ptr<CommonBuffer> destBuf,
@@ -301,30 +338,51 @@ int ImgEncoderCore::doSwEncode(std::shared_ptr<CommonBuffer> srcBuf,
 {
     LOGI("@%s", __FUNCTION__);
 
-    arc::JpegCompressor jpegCompressor;
+    std::unique_ptr<SwEncodeContext> ctx = acquireEncodeContext();
+    int size = swEncode(*ctx, srcBuf, quality, destBuf, destOffset);
+    releaseEncodeContext(std::move(ctx));
+
+    return size;
+}
 
+int ImgEncoderCore::swEncode(SwEncodeContext &ctx,
+                             std::shared_ptr<CommonBuffer> srcBuf,
+                             int quality,
+                             std::shared_ptr<CommonBuffer> destBuf,
+                             unsigned int destOffset)
+{
     int width = srcBuf->width();
     int height = srcBuf->height();
     int stride = srcBuf->stride();
     void* srcY = srcBuf->data();
     void* srcUV = static_cast<unsigned char*>(srcBuf->data()) + stride * height;
 
-    if (width * height * 3 / 2 > mInternalYU12Size) {
-        mInternalYU12Size = width * height * 3 / 2;
-        mInternalYU12.reset(new char[mInternalYU12Size]);
-    }
-    void* tempBuf = mInternalYU12.get();
-
+    arc::YuvImage image;
     switch (srcBuf->v4l2Fmt()) {
-    case V4L2_PIX_FMT_YUYV:
-        YUY2ToP411(width, height, stride, srcY, tempBuf);
-        break;
     case V4L2_PIX_FMT_NV12:
-        NV12ToP411Separate(width, height, stride, srcY, srcUV, tempBuf);
-        break;
     case V4L2_PIX_FMT_NV21:
-        NV21ToP411Separate(width, height, stride, srcY, srcUV, tempBuf);
+        // read by the compressor as they are
+        image.layout = srcBuf->v4l2Fmt() == V4L2_PIX_FMT_NV12 ?
+                       arc::YuvImage::NV12 : arc::YuvImage::NV21;
+        image.y = static_cast<const uint8_t*>(srcY);
+        image.chroma = static_cast<const uint8_t*>(srcUV);
+        image.width = width;
+        image.height = height;
+        image.stride = stride;
+        break;
+    case V4L2_PIX_FMT_YUYV: {
+        // The staging buffer only grows, so alternating thumbnail and main
+        // encodes keep using the same memory.
+        unsigned int yu12Size = width * height * 3 / 2;
+        if (!ctx.yu12 || ctx.yu12->size() < yu12Size) {
+            ctx.yu12.reset();
+            ctx.yu12 = acquireHeapBuffer(width, height, V4L2_PIX_FMT_YUV420, yu12Size);
+            CheckError(!ctx.yu12, 0, "@%s, no YU12 staging buffer", __FUNCTION__);
+        }
+        YUY2ToP411(width, height, stride, srcY, ctx.yu12->data());
+        image = arc::YuvImage::FromYU12(ctx.yu12->data(), width, height);
         break;
+    }
     default:
         LOGE("%s Unsupported format %d", __FUNCTION__, srcBuf->v4l2Fmt());
         return 0;
@@ -333,13 +391,15 @@ int ImgEncoderCore::doSwEncode(std::shared_ptr<CommonBuffer> srcBuf,
     uint32_t outSize = 0;
     nsecs_t startTime = systemTime();
     void* pDst = static_cast<unsigned char*>(destBuf->data()) + destOffset;
-    bool ret = jpegCompressor.CompressImage(tempBuf,
-                                            width, height, quality,
-                                            nullptr, 0,
-                                            destBuf->size(), pDst,
-                                            &outSize);
-    LOGI("%s: encoding ret:%d, %dx%d need %" PRId64 "ms, jpeg size %u, quality %d)",
-         __FUNCTION__, ret, destBuf->width(), destBuf->height(),
+    int strips = mJpegStrips > 0 ? mJpegStrips :
+                 JpegStripEncoder::defaultStrips(width, height);
+    bool ret = ctx.stripEncoder.compress(ctx.compressor, image,
+                                         quality, strips,
+                                         nullptr, 0,
+                                         destBuf->size(), pDst,
+                                         &outSize);
+    LOGI("%s: encoding ret:%d, %dx%d in %d strips need %" PRId64 "ms, jpeg size %u, quality %d)",
+         __FUNCTION__, ret, destBuf->width(), destBuf->height(), strips,
          (systemTime() - startTime) / 1000000, outSize, quality);
     CheckError(ret == false, 0, "@%s, jpegCompressor.CompressImage() fails",
                __FUNCTION__);
@@ -347,11 +407,57 @@ int ImgEncoderCore::doSwEncode(std::shared_ptr<CommonBuffer> srcBuf,
     return outSize;
 }
 
+/**
+ * encodeThumbnail
+ *
+ * Encodes the thumbnail at the first of quality, quality - 5, quality - 10,
+ * ... that fits in THUMBNAIL_SIZE_LIMITATION, or at the lowest of them when
+ * none does. The encoded size falls with the quality, so after the first
+ * try the candidates are bisected instead of encoded one after another.
+ *
+ * \param quality [IN/OUT] requested quality, the one used on return
+ * \return size of the encoded thumbnail, 0 on failure
+ */
+int ImgEncoderCore::encodeThumbnail(std::shared_ptr<CommonBuffer> thumb,
+                                    std::shared_ptr<CommonBuffer> thumbOut,
+                                    int &quality)
+{
+    std::unique_ptr<SwEncodeContext> ctx = acquireEncodeContext();
+
+    // candidate k is quality - 5 * k, the last one is the lowest above 0
+    int last = quality > 0 ? (quality - 1) / 5 : 0;
+    int encoded = 0;    /* candidate whose output is in thumbOut */
+    int size = swEncode(*ctx, thumb, quality, thumbOut, 0);
+
+    if (size > THUMBNAIL_SIZE_LIMITATION && last > 0) {
+        // the first candidate that fits is in [lo, hi], hi if none fits
+        int lo = 1, hi = last;
+        while (size > 0 && lo < hi) {
+            int mid = (lo + hi) / 2;
+            size = swEncode(*ctx, thumb, quality - 5 * mid, thumbOut, 0);
+            encoded = mid;
+            if (size <= THUMBNAIL_SIZE_LIMITATION)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        if (size > 0 && encoded != lo) {
+            size = swEncode(*ctx, thumb, quality - 5 * lo, thumbOut, 0);
+            encoded = lo;
+        }
+    }
+    releaseEncodeContext(std::move(ctx));
+
+    quality -= 5 * encoded;
+    LOGI("@%s: thumbnail quality %d, size %d", __FUNCTION__, quality, size);
+    return size;
+}
+
 /**
  * encodeSync
  *
  * Do HW or SW encoding of the main buffer of the package
- * Also do SW encoding of the thumb buffer
+ * Also do SW encoding of the thumb buffer, concurrently with the main one
  *
  * \param srcBuf [IN] The input buffer to encode
  * \param metaData [IN] exif metadata
@@ -383,24 +489,21 @@ status_t ImgEncoderCore::encodeSync(EncodePackage & package, ExifMetaData& metaD
     // downscale the buffer for main if scaling is needed
     allocateBufferAndDownScale(package);
 
-    // Encode thumbnail as JPEG in parallel with the HW encoding started earlier
-    if (package.thumb && mThumbOutBuf) {
-        do {
-            LOGI("Encoding thumbnail with quality %d",
-                 mJpegSetting->jpegThumbnailQuality);
-            thumbSize = doSwEncode(package.thumb,
-                                   mJpegSetting->jpegThumbnailQuality,
-                                   mThumbOutBuf);
-            mJpegSetting->jpegThumbnailQuality -= 5;
-        } while (thumbSize > 0 && mJpegSetting->jpegThumbnailQuality > 0 &&
-                thumbSize > THUMBNAIL_SIZE_LIMITATION);
-
-        if (thumbSize > 0) {
-            package.thumbOut = mThumbOutBuf;
-            package.thumbSize = thumbSize;
+    // The thumbnail is encoded on a helper thread while this one encodes
+    // the main picture, each with an encoder context of its own.
+    bool encodeThumb = package.thumb && mThumbOutBuf;
+    std::shared_ptr<CommonBuffer> thumbIn = package.thumb;
+    std::shared_ptr<CommonBuffer> thumbOut = mThumbOutBuf;
+    int thumbQuality = mJpegSetting->jpegThumbnailQuality;
+    std::thread thumbThread;
+    if (encodeThumb) {
+        LOGI("Encoding thumbnail with quality %d", thumbQuality);
+        if (package.encodeAll) {
+            thumbThread = std::thread([this, thumbIn, thumbOut, &thumbQuality, &thumbSize] {
+                thumbSize = encodeThumbnail(thumbIn, thumbOut, thumbQuality);
+            });
         } else {
-            // This is not critical, we can continue with main picture image
-            LOGW("Could not encode thumbnail stream!");
+            thumbSize = encodeThumbnail(thumbIn, thumbOut, thumbQuality);
         }
     } else {
         // No thumb is not critical, we can continue with main picture image
@@ -424,6 +527,20 @@ status_t ImgEncoderCore::encodeSync(EncodePackage & package, ExifMetaData& metaD
         }
     }
 
+    if (thumbThread.joinable())
+        thumbThread.join();
+
+    if (encodeThumb) {
+        mJpegSetting->jpegThumbnailQuality = thumbQuality;
+        if (thumbSize > 0) {
+            package.thumbOut = mThumbOutBuf;
+            package.thumbSize = thumbSize;
+        } else {
+            // This is not critical, we can continue with main picture image
+            LOGW("Could not encode thumbnail stream!");
+        }
+    }
+
     return status;
 }
 
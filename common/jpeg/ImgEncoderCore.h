@@ -20,8 +20,11 @@
 
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include "CommonBuffer.h"
 #include "EXIFMaker.h"
+#include "EncodeBufferArena.h"
 USING_METADATA_NAMESPACE;
 NAMESPACE_DECLARATION {
 /**
@@ -110,6 +113,21 @@ private:  /* Methods */
                    int quality,
                    std::shared_ptr<CommonBuffer> destBuf,
                    unsigned int destOffset = 0);
+
+    /* persistent software encoder state, see SwEncodeContext */
+    struct SwEncodeContext;
+    std::unique_ptr<SwEncodeContext> acquireEncodeContext();
+    void releaseEncodeContext(std::unique_ptr<SwEncodeContext> ctx);
+    int swEncode(SwEncodeContext &ctx,
+                 std::shared_ptr<CommonBuffer> srcBuf,
+                 int quality,
+                 std::shared_ptr<CommonBuffer> destBuf,
+                 unsigned int destOffset);
+    int encodeThumbnail(std::shared_ptr<CommonBuffer> thumb,
+                        std::shared_ptr<CommonBuffer> thumbOut,
+                        int &quality);
+    std::shared_ptr<CommonBuffer> acquireHeapBuffer(int width, int height,
+                                                    int format, int size = 0);
     status_t getJpegSettings(EncodePackage & pkg, ExifMetaData& metaData);
 
 private:  /* Members */
@@ -123,11 +141,16 @@ private:  /* Members */
 
     std::mutex mEncodeLock; /* protect JPEG encoding progress */
 
-    // arc::JpegCompressor needs YU12 format
-    // and the ISP doesn't output YU12 directly.
-    // so a temporary intermediate buffer is needed.
-    std::unique_ptr<char[]> mInternalYU12;
-    unsigned int mInternalYU12Size;
+    // Backs the intermediate buffers above and the YU12 staging buffers,
+    // so a resolution change reuses memory instead of reallocating it.
+    std::shared_ptr<EncodeBufferArena> mArena;
+
+    // Idle software encoder contexts, kept across frames so burst
+    // encoding does not set up libjpeg or allocate staging memory.
+    std::mutex mContextLock; /* protects mIdleContexts */
+    std::vector<std::unique_ptr<SwEncodeContext>> mIdleContexts;
+
+    int mJpegStrips; /* strips of a software encode, 0 for automatic */
 };
 
 } NAMESPACE_DECLARATION_END
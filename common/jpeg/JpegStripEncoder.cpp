@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JpegStripEncoder"
+
+#include <string.h>
+#include <algorithm>
+#include "LogHelper.h"
+#include "StripeExecutor.h"
+#include "JpegStripEncoder.h"
+
+NAMESPACE_DECLARATION {
+
+const int JpegStripEncoder::kRowsPerStripAlign;
+const int JpegStripEncoder::kMcuSize;
+const int JpegStripEncoder::kMinStripPixels;
+
+// room for the headers libjpeg writes in front of a strip
+static const uint32_t kStripHeaderRoom = 1024;
+
+JpegStripEncoder::JpegStripEncoder()
+{
+}
+
+JpegStripEncoder::~JpegStripEncoder()
+{
+}
+
+int JpegStripEncoder::defaultStrips(int width, int height)
+{
+    if (width * height < kMinStripPixels)
+        return 1;
+
+    return StripeExecutor::concurrency();
+}
+
+/**
+ * findScan
+ *
+ * Walks the marker segments of a JPEG up to the start of scan.
+ *
+ * \param sofOffset [OUT] offset of the SOF0 marker
+ * \param scanOffset [OUT] offset of the entropy coded data
+ * \return false if data is not a complete baseline JPEG
+ */
+bool JpegStripEncoder::findScan(const uint8_t *data, uint32_t size,
+                                uint32_t *sofOffset, uint32_t *scanOffset)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8 ||
+        data[size - 2] != 0xFF || data[size - 1] != 0xD9)
+        return false;
+
+    *sofOffset = 0;
+    uint32_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF)
+            return false;
+        uint8_t marker = data[pos + 1];
+        uint32_t length = (data[pos + 2] << 8) | data[pos + 3];
+        if (marker == 0xC0)
+            *sofOffset = pos;
+        pos += 2 + length;
+        if (marker == 0xDA) {
+            *scanOffset = pos;
+            return *sofOffset != 0 && pos + 2 <= size;
+        }
+    }
+    return false;
+}
+
+bool JpegStripEncoder::compress(arc::JpegCompressor &first, const arc::YuvImage &image,
+                                int quality, int strips,
+                                const void *app1, uint32_t app1Size,
+                                uint32_t outBufferSize, void *outBuffer,
+                                uint32_t *outDataSize)
+{
+    const int width = image.width;
+    const int height = image.height;
+    int mcuRows = (height + kMcuSize - 1) / kMcuSize;
+    int mcusPerRow = (width + kMcuSize - 1) / kMcuSize;
+    int groups = (mcuRows + kRowsPerStripAlign - 1) / kRowsPerStripAlign;
+    if (strips > groups)
+        strips = groups;
+
+    if (strips <= 1 || width % 8 != 0 || height % 2 != 0)
+        return first.CompressImage(image, quality, app1, app1Size,
+                                   outBufferSize, outBuffer, outDataSize);
+
+    if (mStrips.size() < (size_t)strips)
+        mStrips.resize(strips);
+
+    const int groupRows = kRowsPerStripAlign * kMcuSize;
+    auto firstRow = [groups, strips, groupRows](int k) {
+        return groups * k / strips * groupRows;
+    };
+
+    // strip 0 goes straight to the output, the others behind it later
+    auto encodeStrip = [&](int k) {
+        Strip &strip = mStrips[k];
+        int begin = firstRow(k);
+        int end = std::min(height, firstRow(k + 1));
+        arc::JpegCompressor *compressor = &first;
+        void *dst = outBuffer;
+        uint32_t dstSize = outBufferSize;
+        if (k > 0) {
+            if (!strip.compressor)
+                strip.compressor.reset(new arc::JpegCompressor);
+            compressor = strip.compressor.get();
+            uint32_t room = width * (end - begin) * 3 / 2 + kStripHeaderRoom;
+            if (strip.out.size() < room)
+                strip.out.resize(room);
+            dst = strip.out.data();
+            dstSize = strip.out.size();
+        }
+        strip.size = 0;
+        strip.ok = compressor->CompressStrip(image, begin, end - begin,
+                                             quality, mcusPerRow,
+                                             k == 0 ? app1 : nullptr,
+                                             k == 0 ? app1Size : 0,
+                                             dstSize, dst, &strip.size);
+    };
+
+    StripeExecutor::run(strips, [&encodeStrip](int begin, int end) {
+        for (int k = begin; k < end; k++)
+            encodeStrip(k);
+    }, 1, 1);
+
+    uint8_t *out = static_cast<uint8_t*>(outBuffer);
+    uint32_t sofOffset, scanOffset;
+    bool ok = true;
+    for (int k = 0; k < strips && ok; k++)
+        ok = mStrips[k].ok;
+    ok = ok && findScan(out, mStrips[0].size, &sofOffset, &scanOffset);
+
+    // the first strip keeps its headers, with the height of the whole image
+    uint32_t pos = mStrips[0].size - 2;
+    if (ok) {
+        out[sofOffset + 5] = height >> 8;
+        out[sofOffset + 6] = height & 0xFF;
+    }
+
+    for (int k = 1; k < strips && ok; k++) {
+        const Strip &strip = mStrips[k];
+        ok = findScan(strip.out.data(), strip.size, &sofOffset, &scanOffset);
+        uint32_t length = strip.size - 2 - scanOffset;
+        if (!ok || pos + 2 + length + 2 > outBufferSize) {
+            ok = false;
+            break;
+        }
+        // the restart marker ending the MCU row before the strip
+        int mcuRow = firstRow(k) / kMcuSize;
+        out[pos++] = 0xFF;
+        out[pos++] = 0xD0 + ((mcuRow - 1) & 7);
+        memcpy(out + pos, strip.out.data() + scanOffset, length);
+        pos += length;
+    }
+
+    if (!ok) {
+        LOGW("@%s: striped encoding failed, encoding %dx%d in one piece",
+             __FUNCTION__, width, height);
+        return first.CompressImage(image, quality, app1, app1Size,
+                                   outBufferSize, outBuffer, outDataSize);
+    }
+
+    out[pos++] = 0xFF;
+    out[pos++] = 0xD9;
+    *outDataSize = pos;
+    return true;
+}
+
+} NAMESPACE_DECLARATION_END
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CAMERA3_HAL_JPEG_STRIP_ENCODER_H_
+#define _CAMERA3_HAL_JPEG_STRIP_ENCODER_H_
+
+#include <memory>
+#include <vector>
+#include "jpeg_compressor.h"
+#include "UtilityMacros.h"
+
+NAMESPACE_DECLARATION {
+/**
+ * \class JpegStripEncoder
+ *
+ * Software JPEG encoder that splits a YUV 4:2:0 image into horizontal strips
+ * of whole MCU rows, compresses the strips on the StripeExecutor pool and
+ * joins them into one baseline JPEG.
+ *
+ * With more than one strip the image carries a restart marker after every
+ * MCU row (DRI), which resets the entropy coder so each strip can be coded
+ * on its own; the joined file is byte for byte what a single compressor
+ * would produce with the same restart interval. With one strip the output
+ * is exactly that of JpegCompressor::CompressImage().
+ *
+ * The compressors and strip buffers are kept for the next image. Not
+ * thread safe, callers serialize encodes.
+ */
+class JpegStripEncoder {
+public:
+    JpegStripEncoder();
+    ~JpegStripEncoder();
+
+    /**
+     * \param first     compressor for the first strip, the only one used
+     *                  when there is a single strip
+     * \param strips    number of strips, reduced to what the image height
+     *                  allows; 1 disables the restart markers
+     */
+    bool compress(arc::JpegCompressor &first, const arc::YuvImage &image,
+                  int quality, int strips,
+                  const void *app1, uint32_t app1Size,
+                  uint32_t outBufferSize, void *outBuffer,
+                  uint32_t *outDataSize);
+
+    /* strips worth using for an image of this size on this device */
+    static int defaultStrips(int width, int height);
+
+private:
+    struct Strip {
+        std::unique_ptr<arc::JpegCompressor> compressor;
+        std::vector<uint8_t> out;
+        uint32_t size;
+        bool ok;
+    };
+
+    static bool findScan(const uint8_t *data, uint32_t size,
+                         uint32_t *sofOffset, uint32_t *scanOffset);
+
+private:
+    // strips start on multiples of this many MCU rows, so the restart
+    // markers inside a strip already carry their final numbers
+    static const int kRowsPerStripAlign = 8;
+    static const int kMcuSize = 16;
+    static const int kMinStripPixels = 2 * 1000 * 1000;
+
+    std::vector<Strip> mStrips;
+};
+
+} NAMESPACE_DECLARATION_END
+#endif // _CAMERA3_HAL_JPEG_STRIP_ENCODER_H_
@@ -7,12 +7,15 @@
 #include "jpeg_compressor.h"
 /* #include "common.h" */
 #include "LogHelper.h"
+#include "ColorConvertKernels.h"
 
+#include <algorithm>
 #include <memory>
 
 #include <errno.h>
 #include <libyuv.h>
 
+USING_DECLARED_NAMESPACE;
 
 namespace arc {
 
@@ -27,9 +30,24 @@ JpegCompressor::JpegCompressor()
     : out_buffer_ptr_(nullptr),
     out_buffer_size_(0),
     out_data_size_(0),
-    is_encode_success_(false) {}
+    is_encode_success_(false),
+    quality_(-1) {
+    cinfo_.err = jpeg_std_error(&jerr_);
+    // Override output_message() to print error log with ALOGE().
+    cinfo_.err->output_message = &OutputErrorMessage;
+    jpeg_create_compress(&cinfo_);
+    SetJpegDestination(&cinfo_);
+    SetJpegCompressStruct(&cinfo_);
+}
+
+    JpegCompressor::~JpegCompressor() {
+        jpeg_destroy_compress(&cinfo_);
+    }
 
-    JpegCompressor::~JpegCompressor() {}
+YuvImage YuvImage::FromYU12(const void* image, int width, int height) {
+    const uint8_t* y_plane = static_cast<const uint8_t*>(image);
+    return YuvImage{YU12, y_plane, y_plane + width * height, width, height, width};
+}
 
     bool JpegCompressor::CompressImage(const void* image,
                                        int width,
@@ -40,27 +58,74 @@ JpegCompressor::JpegCompressor()
                                        uint32_t out_buffer_size,
                                        void* out_buffer,
                                        uint32_t* out_data_size) {
-        LOGI("%s:%d: enter", __func__, __LINE__);
-        if (width % 8 != 0 || height % 2 != 0) {
-            LOGE("%s:%d: Image size can not be handled:  %d x %d", __func__, __LINE__, width, height);
-            return false;
-        }
+        return CompressImage(YuvImage::FromYU12(image, width, height), quality,
+                             app1_buffer, app1_size, out_buffer_size, out_buffer,
+                             out_data_size);
+    }
 
-        if (out_data_size == nullptr || out_buffer == nullptr) {
-            LOGE("%s:%d: Output should not be nullptr. ", __func__, __LINE__);
-            return false;
-        }
+bool JpegCompressor::CompressImage(const YuvImage& image,
+                                   int quality,
+                                   const void* app1_buffer,
+                                   uint32_t app1_size,
+                                   uint32_t out_buffer_size,
+                                   void* out_buffer,
+                                   uint32_t* out_data_size) {
+    LOGI("%s:%d: enter", __func__, __LINE__);
+    if (!CheckImage(image, out_buffer, out_data_size))
+        return false;
 
-        LOGI("%s:%d: image(%p), width(%d), height(%d), quality(%d), app1_size(%d), out_buffer_size(%d)", __func__, __LINE__, image, width, height, quality, app1_size, out_buffer_size);
-        if (!Encode(image, width, height, quality, app1_buffer, app1_size,
-                    out_buffer_size, out_buffer, out_data_size)) {
-            LOGE("%s:%d: Encode failed", __func__, __LINE__);
-            return false;
-        }
-        LOGI("%s:%d: Compressed JPEG: %d, [%d x %d] -> %d bytes", __func__, __LINE__, (width * height * 12) / 8, width, height, *out_data_size);
-        return true;
+    LOGI("%s:%d: image(%p), layout(%d), width(%d), height(%d), quality(%d), app1_size(%d), out_buffer_size(%d)", __func__, __LINE__, image.y, image.layout, image.width, image.height, quality, app1_size, out_buffer_size);
+    if (!Encode(image, 0, image.height, quality, 0, app1_buffer, app1_size,
+                out_buffer_size, out_buffer, out_data_size)) {
+        LOGE("%s:%d: Encode failed", __func__, __LINE__);
+        return false;
+    }
+    LOGI("%s:%d: Compressed JPEG: %d, [%d x %d] -> %d bytes", __func__, __LINE__, (image.width * image.height * 12) / 8, image.width, image.height, *out_data_size);
+    return true;
+}
+
+bool JpegCompressor::CompressStrip(const YuvImage& image,
+                                   int first_row,
+                                   int rows,
+                                   int quality,
+                                   int restart_interval,
+                                   const void* app1_buffer,
+                                   uint32_t app1_size,
+                                   uint32_t out_buffer_size,
+                                   void* out_buffer,
+                                   uint32_t* out_data_size) {
+    if (!CheckImage(image, out_buffer, out_data_size))
+        return false;
+
+    if (first_row % 16 != 0 || rows % 2 != 0 || rows <= 0 ||
+        first_row + rows > image.height) {
+        LOGE("%s:%d: Strip can not be handled: rows %d + %d of %d x %d", __func__,
+             __LINE__, first_row, rows, image.width, image.height);
+        return false;
+    }
+
+    return Encode(image, first_row, rows, quality, restart_interval,
+                  app1_buffer, app1_size, out_buffer_size, out_buffer,
+                  out_data_size);
+}
+
+bool JpegCompressor::CheckImage(const YuvImage& image,
+                                const void* out_buffer,
+                                const uint32_t* out_data_size) {
+    if (image.width % 8 != 0 || image.height % 2 != 0 ||
+        image.stride < image.width) {
+        LOGE("%s:%d: Image size can not be handled:  %d x %d, stride %d", __func__,
+             __LINE__, image.width, image.height, image.stride);
+        return false;
     }
 
+    if (out_data_size == nullptr || out_buffer == nullptr) {
+        LOGE("%s:%d: Output should not be nullptr. ", __func__, __LINE__);
+        return false;
+    }
+    return true;
+}
+
 bool JpegCompressor::GenerateThumbnail(const void* image,
                                        int image_width,
                                        int image_height,
@@ -90,7 +155,7 @@ bool JpegCompressor::GenerateThumbnail(const void* image,
     }
 
     // Resize |image| to |thumbnail_width| x |thumbnail_height|.
-    std::vector<uint8_t> scaled_buffer;
+    std::vector<uint8_t>& scaled_buffer = scaled_buffer_;
     size_t y_plane_size = image_width * image_height;
     const uint8_t* y_plane = reinterpret_cast<const uint8_t*>(image);
     const uint8_t* u_plane = y_plane + y_plane_size;
@@ -154,10 +219,11 @@ void JpegCompressor::OutputErrorMessage(j_common_ptr cinfo) {
     //LOGF(ERROR) << buffer;
 }
 
-bool JpegCompressor::Encode(const void* inYuv,
-                            int width,
-                            int height,
+bool JpegCompressor::Encode(const YuvImage& image,
+                            int first_row,
+                            int rows,
                             int jpeg_quality,
+                            int restart_interval,
                             const void* app1_buffer,
                             unsigned int app1_size,
                             uint32_t out_buffer_size,
@@ -166,28 +232,21 @@ bool JpegCompressor::Encode(const void* inYuv,
     out_buffer_ptr_ = static_cast<JOCTET*>(out_buffer);
     out_buffer_size_ = out_buffer_size;
 
-    jpeg_compress_struct cinfo;
-    jpeg_error_mgr jerr;
-
-    cinfo.err = jpeg_std_error(&jerr);
-    // Override output_message() to print error log with ALOGE().
-    cinfo.err->output_message = &OutputErrorMessage;
-    jpeg_create_compress(&cinfo);
-    SetJpegDestination(&cinfo);
-
-    SetJpegCompressStruct(width, height, jpeg_quality, &cinfo);
-    jpeg_start_compress(&cinfo, TRUE);
+    SetJpegImageParams(image.width, rows, jpeg_quality, restart_interval, &cinfo_);
+    jpeg_start_compress(&cinfo_, TRUE);
 
     if (app1_buffer != nullptr && app1_size > 0) {
-        jpeg_write_marker(&cinfo, JPEG_APP0 + 1,
+        jpeg_write_marker(&cinfo_, JPEG_APP0 + 1,
                           static_cast<const JOCTET*>(app1_buffer), app1_size);
     }
 
-    if (!Compress(&cinfo, static_cast<const uint8_t*>(inYuv))) {
+    if (!Compress(&cinfo_, image, first_row)) {
         LOGE("%s:%d: Compress failed", __func__, __LINE__);
+        // Return the compressor to the idle state for the next image.
+        jpeg_abort_compress(&cinfo_);
         return false;
     }
-    jpeg_finish_compress(&cinfo);
+    jpeg_finish_compress(&cinfo_);
 
     LOGI("%s:%d: is_encode_success_ %d, out_data_size_ %d", __func__, __LINE__, is_encode_success_,  out_data_size_);
     *out_data_size = is_encode_success_ ? out_data_size_ : 0;
@@ -205,17 +264,11 @@ void JpegCompressor::SetJpegDestination(jpeg_compress_struct* cinfo) {
     cinfo->dest = reinterpret_cast<struct jpeg_destination_mgr*>(dest);
 }
 
-void JpegCompressor::SetJpegCompressStruct(int width,
-                                           int height,
-                                           int quality,
-                                           jpeg_compress_struct* cinfo) {
-    cinfo->image_width = width;
-    cinfo->image_height = height;
+void JpegCompressor::SetJpegCompressStruct(jpeg_compress_struct* cinfo) {
     cinfo->input_components = 3;
     cinfo->in_color_space = JCS_YCbCr;
     jpeg_set_defaults(cinfo);
 
-    jpeg_set_quality(cinfo, quality, TRUE);
     jpeg_set_colorspace(cinfo, JCS_YCbCr);
     cinfo->raw_data_in = TRUE;
     cinfo->dct_method = JDCT_IFAST;
@@ -230,38 +283,77 @@ void JpegCompressor::SetJpegCompressStruct(int width,
     cinfo->comp_info[2].v_samp_factor = 1;
 }
 
-bool JpegCompressor::Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv) {
+void JpegCompressor::SetJpegImageParams(int width,
+                                        int height,
+                                        int quality,
+                                        int restart_interval,
+                                        jpeg_compress_struct* cinfo) {
+    cinfo->image_width = width;
+    cinfo->image_height = height;
+    cinfo->restart_interval = restart_interval;
+    cinfo->restart_in_rows = 0;
+
+    if (quality != quality_) {
+        jpeg_set_quality(cinfo, quality, TRUE);
+        quality_ = quality;
+    }
+}
+
+bool JpegCompressor::Compress(jpeg_compress_struct* cinfo,
+                              const YuvImage& image,
+                              int first_row) {
     JSAMPROW y[kCompressBatchSize];
     JSAMPROW cb[kCompressBatchSize / 2];
     JSAMPROW cr[kCompressBatchSize / 2];
     JSAMPARRAY planes[3]{y, cb, cr};
 
-    size_t y_plane_size = cinfo->image_width * cinfo->image_height;
-    size_t uv_plane_size = y_plane_size / 4;
-    uint8_t* y_plane = const_cast<uint8_t*>(yuv);
-    uint8_t* u_plane = const_cast<uint8_t*>(yuv + y_plane_size);
-    uint8_t* v_plane = const_cast<uint8_t*>(yuv + y_plane_size + uv_plane_size);
-    std::unique_ptr<uint8_t[]> empty(new uint8_t[cinfo->image_width]);
-    memset(empty.get(), 0, cinfo->image_width);
+    const int chroma_width = image.width / 2;
+    const bool planar = image.layout == YuvImage::YU12;
+    uint8_t* y_plane = const_cast<uint8_t*>(image.y);
+    uint8_t* u_plane = const_cast<uint8_t*>(image.chroma);
+    uint8_t* v_plane = u_plane + chroma_width * (image.height / 2);
+    if (empty_row_.size() < cinfo->image_width)
+        empty_row_.resize(cinfo->image_width, 0);
+    uint8_t* empty = empty_row_.data();
+
+    // libjpeg reads whole blocks, so the de-interleaved rows are padded to
+    // a multiple of DCTSIZE by repeating their last sample.
+    const int padded_width = (chroma_width + DCTSIZE - 1) / DCTSIZE * DCTSIZE;
+    const ColorConvertKernels& kernels = getColorConvertKernels();
+    if (!planar && chroma_rows_.size() < (size_t)padded_width * kCompressBatchSize)
+        chroma_rows_.resize(padded_width * kCompressBatchSize);
 
     while (cinfo->next_scanline < cinfo->image_height) {
         for (int i = 0; i < kCompressBatchSize; ++i) {
             size_t scanline = cinfo->next_scanline + i;
             if (scanline < cinfo->image_height) {
-                y[i] = y_plane + scanline * cinfo->image_width;
+                y[i] = y_plane + (first_row + scanline) * image.stride;
             } else {
-                y[i] = empty.get();
+                y[i] = empty;
             }
         }
         // cb, cr only have half scanlines
         for (int i = 0; i < kCompressBatchSize / 2; ++i) {
             size_t scanline = cinfo->next_scanline / 2 + i;
-            if (scanline < cinfo->image_height / 2) {
-                int offset = scanline * (cinfo->image_width / 2);
+            size_t row = first_row / 2 + scanline;
+            if (scanline >= cinfo->image_height / 2) {
+                cb[i] = cr[i] = empty;
+            } else if (planar) {
+                int offset = row * chroma_width;
                 cb[i] = u_plane + offset;
                 cr[i] = v_plane + offset;
             } else {
-                cb[i] = cr[i] = empty.get();
+                cb[i] = chroma_rows_.data() + i * padded_width;
+                cr[i] = cb[i] + kCompressBatchSize / 2 * padded_width;
+                const uint8_t* src = u_plane + row * image.stride;
+                if (image.layout == YuvImage::NV21)
+                    kernels.deinterleave(cr[i], cb[i], src, chroma_width);
+                else
+                    kernels.deinterleave(cb[i], cr[i], src, chroma_width);
+                std::fill(cb[i] + chroma_width, cb[i] + padded_width,
+                          cb[i][chroma_width - 1]);
+                std::fill(cr[i] + chroma_width, cr[i] + padded_width,
+                          cr[i][chroma_width - 1]);
             }
         }
 
@@ -19,8 +19,29 @@ extern "C" {
 
 namespace arc {
 
-// Encapsulates a converter from YU12 to JPEG format. This class is not
-// thread-safe.
+// A YUV 4:2:0 image in one of the layouts the compressor reads directly.
+// The YU12 planes are packed: |stride| is |width| and V follows U. NV12 and
+// NV21 have one interleaved chroma plane, |stride| applies to both planes.
+struct YuvImage {
+    enum Layout { YU12, NV12, NV21 };
+
+    Layout layout;
+    const uint8_t* y;
+    const uint8_t* chroma;
+    int width;
+    int height;
+    int stride;
+
+    // |image| is a packed YU12 image of |width| x |height|.
+    static YuvImage FromYU12(const void* image, int width, int height);
+};
+
+// Encapsulates a converter from YU12, NV12 or NV21 to JPEG format. This
+// class is not thread-safe.
+//
+// The libjpeg compressor is created once and reused for every image, so
+// encoding a burst of frames keeps its Huffman tables, quantization tables
+// and scratch memory instead of setting them up again for each frame.
 class JpegCompressor {
 public:
     JpegCompressor();
@@ -43,6 +64,33 @@ public:
                        void* out_buffer,
                        uint32_t* out_data_size);
 
+    // As above for an image in any YuvImage layout. The semi-planar chroma
+    // is de-interleaved 16 image rows at a time into a small buffer, so no
+    // YU12 copy of the whole image is made.
+    bool CompressImage(const YuvImage& image,
+                       int quality,
+                       const void* app1_buffer,
+                       uint32_t app1_size,
+                       uint32_t out_buffer_size,
+                       void* out_buffer,
+                       uint32_t* out_data_size);
+
+    // Compresses the rows [|first_row|, |first_row| + |rows|) of |image| as a
+    // JPEG of its own, with a restart marker after every |restart_interval|
+    // MCUs. |first_row| must be a multiple of 16 and |rows| even. Strips
+    // compressed this way can be joined into one image, see
+    // JpegStripEncoder. Returns false if errors occur during compression.
+    bool CompressStrip(const YuvImage& image,
+                       int first_row,
+                       int rows,
+                       int quality,
+                       int restart_interval,
+                       const void* app1_buffer,
+                       uint32_t app1_size,
+                       uint32_t out_buffer_size,
+                       void* out_buffer,
+                       uint32_t* out_data_size);
+
     // Compresses YU12 image to JPEG format. |quality| is the resulted jpeg
     // image quality. It ranges from 1 (poorest quality) to 100 (highest quality).
     // Caller should pass the size of output buffer to |out_buffer_size|. Encoded
@@ -67,23 +115,36 @@ private:
     static void TerminateDestination(j_compress_ptr cinfo);
     static void OutputErrorMessage(j_common_ptr cinfo);
 
+    // Compresses |rows| rows of |image| from |first_row| on.
     // Returns false if errors occur.
-    bool Encode(const void* inYuv,
-                int width,
-                int height,
+    bool Encode(const YuvImage& image,
+                int first_row,
+                int rows,
                 int jpegQuality,
+                int restart_interval,
                 const void* app1_buffer,
                 unsigned int app1_size,
                 uint32_t out_buffer_size,
                 void* out_buffer,
                 uint32_t* out_data_size);
     void SetJpegDestination(jpeg_compress_struct* cinfo);
-    void SetJpegCompressStruct(int width,
-                               int height,
-                               int quality,
-                               jpeg_compress_struct* cinfo);
+    // Sets the parameters which do not change between images. Called once.
+    void SetJpegCompressStruct(jpeg_compress_struct* cinfo);
+    // Sets the per image parameters. The quantization tables are only
+    // rebuilt when |quality| differs from the previous image.
+    void SetJpegImageParams(int width,
+                            int height,
+                            int quality,
+                            int restart_interval,
+                            jpeg_compress_struct* cinfo);
     // Returns false if errors occur.
-    bool Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv);
+    bool Compress(jpeg_compress_struct* cinfo,
+                  const YuvImage& image,
+                  int first_row);
+    // Checks the size of |image| and the output pointers.
+    static bool CheckImage(const YuvImage& image,
+                           const void* out_buffer,
+                           const uint32_t* out_data_size);
 
     // Process 16 lines of Y and 16 lines of U/V each time.
     // We must pass at least 16 scanlines according to libjpeg documentation.
@@ -101,6 +162,22 @@ private:
     // Since output buffer is passed from caller, use a variable to indicate
     // buffer is enough to encode or not.
     bool is_encode_success_;
+
+    // libjpeg state, reused across images.
+    jpeg_compress_struct cinfo_;
+    jpeg_error_mgr jerr_;
+
+    // Quality the current quantization tables were built for, -1 if none.
+    int quality_;
+
+    // Zero filled scanline padding the last rows of an image.
+    std::vector<uint8_t> empty_row_;
+
+    // Cb rows then Cr rows of one batch of a semi-planar image.
+    std::vector<uint8_t> chroma_rows_;
+
+    // Scaled YU12 image of GenerateThumbnail(), kept for the next call.
+    std::vector<uint8_t> scaled_buffer_;
 };
 
 }  // namespace arc
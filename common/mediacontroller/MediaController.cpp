@@ -82,7 +82,7 @@ status_t MediaController::open()
         return NO_ERROR;
     }
 
-    if (stat (mPath.c_str(), &st) == -1) {
+    if (SysCall::stat(mPath.c_str(), &st) == -1) {
         LOGE("Error stat media device %s: %s",
              mPath.c_str(), strerror(errno));
         return UNKNOWN_ERROR;
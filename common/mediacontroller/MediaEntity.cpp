@@ -20,6 +20,7 @@
 #include <sstream>
 #include "MediaEntity.h"
 #include "LogHelper.h"
+#include "SysCall.h"
 
 NAMESPACE_DECLARATION {
 MediaEntity::MediaEntity(struct media_entity_desc &entity, struct media_link_desc *links,
@@ -96,7 +97,7 @@ status_t MediaEntity::openDevice(std::shared_ptr<V4L2DeviceBase> &device)
     std::ostringstream stringStream;
     stringStream << "/sys/dev/char/" << major << ":" << minor;
     std::string devNameStr = stringStream.str();
-    ret = readlink(devNameStr.c_str(), sysname, sizeof(sysname));
+    ret = SysCall::readlink(devNameStr.c_str(), sysname, sizeof(sysname) - 1);
     if (ret < 0) {
         LOGE("Unable to find device node");
     } else {
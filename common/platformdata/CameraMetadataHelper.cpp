@@ -18,6 +18,7 @@
 #define LOG_TAG "MetadataHelper"
 #include "CameraMetadataHelper.h"
 #include "LogHelper.h"
+#include <string.h>
 #include <string>
 #include <sstream>
 
@@ -185,6 +186,87 @@ status_t updateMetadata(camera_metadata_t * metadata, uint32_t tag, const void*
     return res;
 }
 
+static status_t updateEntry(CameraMetadata &dst, const camera_metadata_ro_entry_t &entry)
+{
+    switch (entry.type) {
+    case TYPE_BYTE:
+        return dst.update(entry.tag, entry.data.u8, entry.count);
+    case TYPE_INT32:
+        return dst.update(entry.tag, entry.data.i32, entry.count);
+    case TYPE_FLOAT:
+        return dst.update(entry.tag, entry.data.f, entry.count);
+    case TYPE_INT64:
+        return dst.update(entry.tag, entry.data.i64, entry.count);
+    case TYPE_DOUBLE:
+        return dst.update(entry.tag, entry.data.d, entry.count);
+    case TYPE_RATIONAL:
+        return dst.update(entry.tag, entry.data.r, entry.count);
+    default:
+        LOGE("@%s: unknown type %d of tag 0x%x", __FUNCTION__, entry.type, entry.tag);
+        return BAD_VALUE;
+    }
+}
+
+status_t mergeMetadata(CameraMetadata &dst, const camera_metadata_t *src)
+{
+    if (src == nullptr)
+        return BAD_VALUE;
+
+    size_t count = get_camera_metadata_entry_count(src);
+    camera_metadata_ro_entry_t entry;
+    bool overlap = false;
+    for (size_t i = 0; i < count && !overlap; i++) {
+        if (get_camera_metadata_ro_entry(src, i, &entry) == OK)
+            overlap = dst.exists(entry.tag);
+    }
+
+    // the common case, one copy of the whole buffer
+    if (!overlap)
+        return dst.append(src);
+
+    status_t status = OK;
+    for (size_t i = 0; i < count; i++) {
+        if (get_camera_metadata_ro_entry(src, i, &entry) != OK)
+            continue;
+
+        camera_metadata_ro_entry_t old = dst.find(entry.tag);
+        if (old.count == entry.count && old.type == entry.type &&
+            (entry.count == 0 ||
+             memcmp(old.data.u8, entry.data.u8,
+                    entry.count * camera_metadata_type_size[entry.type]) == 0))
+            continue;
+
+        status_t ret = updateEntry(dst, entry);
+        if (ret != OK)
+            status = ret;
+    }
+    return status;
+}
+
+bool sameMetadata(const CameraMetadata &a, const camera_metadata_t *b)
+{
+    if (b == nullptr)
+        return false;
+
+    size_t count = get_camera_metadata_entry_count(b);
+    if (a.entryCount() != count)
+        return false;
+
+    camera_metadata_ro_entry_t entry;
+    for (size_t i = 0; i < count; i++) {
+        if (get_camera_metadata_ro_entry(b, i, &entry) != OK)
+            return false;
+
+        camera_metadata_ro_entry_t old = a.find(entry.tag);
+        if (old.count != entry.count || old.type != entry.type ||
+            (entry.count != 0 &&
+             memcmp(old.data.u8, entry.data.u8,
+                    entry.count * camera_metadata_type_size[entry.type]) != 0))
+            return false;
+    }
+    return true;
+}
+
 void dumpMetadata(const camera_metadata_t * meta)
 {
     if (!meta)
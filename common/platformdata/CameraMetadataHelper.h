@@ -96,6 +96,19 @@ bool getSetting(const camera_metadata_ro_entry_t& supported,
 
 status_t updateMetadata(camera_metadata_t * metadata, uint32_t tag, const void* data, size_t data_count);
 
+/**
+ * Merges the entries of src into dst. When none of the tags are in dst yet
+ * this is a plain append, otherwise only tags that are missing or hold a
+ * different value are written, so dst never ends up with duplicate tags.
+ */
+status_t mergeMetadata(CameraMetadata &dst, const camera_metadata_t *src);
+
+/**
+ * True if a and b hold the same tags with the same values. Only reads a, so
+ * a may be shared with other threads.
+ */
+bool sameMetadata(const CameraMetadata &a, const camera_metadata_t *b);
+
 };
 
 } NAMESPACE_DECLARATION_END
@@ -40,6 +40,9 @@
 
 #include "MediaController.h"
 #include "MediaEntity.h"
+#ifdef CAMERA_VIRTUAL_KERNEL
+#include "VirtualKernel.h"
+#endif
 USING_METADATA_NAMESPACE;
 NAMESPACE_DECLARATION {
 using std::string;
@@ -133,6 +136,11 @@ void PlatformData::init()
 {
     LOGI("@%s", __FUNCTION__);
 
+#ifdef CAMERA_VIRTUAL_KERNEL
+    // must come before anything looks at the devices
+    VirtualKernel::setup();
+#endif
+
     if (mGcssKeyMap) {
         delete mGcssKeyMap;
         mGcssKeyMap = nullptr;
@@ -598,7 +606,7 @@ status_t CameraHWInfo::initDriverList()
     }
 
     for (auto mcPathName : mMediaControllerPathName) {
-        int mcExist = stat(mcPathName.c_str(), &sb);
+        int mcExist = SysCall::stat(mcPathName.c_str(), &sb);
 
         LOGI("mMediaControllerPathName %s\n", mcPathName.c_str());
 
@@ -745,7 +753,7 @@ status_t CameraHWInfo::findAttachedSubdevs(const std::string &mcPath,
 
     LOGI("@%s", __FUNCTION__);
 
-    int fd = open(mcPath.c_str(), O_RDONLY);
+    int fd = SysCall::open(mcPath.c_str(), O_RDONLY);
     if (fd == -1) {
         LOGW("Could not openg media controller device: %s!", strerror(errno));
         return ENXIO;
@@ -756,7 +764,7 @@ status_t CameraHWInfo::findAttachedSubdevs(const std::string &mcPath,
     do {
         // Go through the list of media controller entities
         entity.id |= MEDIA_ENT_ID_FLAG_NEXT;
-        if (ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) < 0) {
+        if (SysCall::ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) < 0) {
             if (errno == EINVAL) {
                 // Ending up here when no more entities left.
                 // Will simply 'break' if everything was ok
@@ -830,7 +838,7 @@ status_t CameraHWInfo::findAttachedSubdevs(const std::string &mcPath,
         }
     } while (!ret);
 
-    if (close(fd)) {
+    if (SysCall::close(fd)) {
         LOGE("ERROR in closing media controller: %s!", strerror(errno));
         if (!ret) ret = EPERM;
     }
@@ -847,7 +855,7 @@ status_t CameraHWInfo::findAttachedSubdevs(const std::string &mcPath,
         CLEAR(fileInfo);
         if (!find_lens && !find_flashlight)
             break;
-        if (stat(subdevPathNameN.c_str(), &fileInfo) < 0) {
+        if (SysCall::stat(subdevPathNameN.c_str(), &fileInfo) < 0) {
             if (errno == ENOENT) {
                 // We end up here when there is no Nth subdevice
                 // but there might be more subdevices, so continue.
@@ -888,7 +896,7 @@ const bool compareFuncForSensorInfo(struct SensorDriverDescriptor  s1, struct Se
 status_t CameraHWInfo::findMediaControllerSensors(const std::string &mcPath)
 {
     status_t ret = OK;
-    int fd = open(mcPath.c_str(), O_RDONLY);
+    int fd = SysCall::open(mcPath.c_str(), O_RDONLY);
     if (fd == -1) {
         LOGW("Could not openg media controller device: %s!", strerror(errno));
         return ENXIO;
@@ -899,7 +907,7 @@ status_t CameraHWInfo::findMediaControllerSensors(const std::string &mcPath)
     do {
         // Go through the list of media controller entities
         entity.id |= MEDIA_ENT_ID_FLAG_NEXT;
-        if (ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) < 0) {
+        if (SysCall::ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) < 0) {
             if (errno == EINVAL) {
                 // Ending up here when no more entities left.
                 // Will simply 'break' if everything was ok
@@ -937,7 +945,7 @@ status_t CameraHWInfo::findMediaControllerSensors(const std::string &mcPath)
 
     std:sort(mSensorInfo.begin(), mSensorInfo.end(), compareFuncForSensorInfo);
 
-    if (close(fd)) {
+    if (SysCall::close(fd)) {
         LOGE("ERROR in closing media controller: %s!", strerror(errno));
         if (!ret) ret = EPERM;
     }
@@ -948,21 +956,21 @@ status_t CameraHWInfo::findMediaControllerSensors(const std::string &mcPath)
 status_t CameraHWInfo::findMediaDeviceInfo(const std::string& mcPath)
 {
     status_t ret = OK;
-    int fd = open(mcPath.c_str(), O_RDONLY);
+    int fd = SysCall::open(mcPath.c_str(), O_RDONLY);
     if (fd == -1) {
         LOGW("Could not openg media controller device: %s!", strerror(errno));
         return UNKNOWN_ERROR;
     }
 
     CLEAR(mDeviceInfo);
-    if (ioctl(fd, MEDIA_IOC_DEVICE_INFO, &mDeviceInfo) < 0) {
+    if (SysCall::ioctl(fd, MEDIA_IOC_DEVICE_INFO, &mDeviceInfo) < 0) {
         LOGE("ERROR in browsing media device information: %s!", strerror(errno));
         ret = FAILED_TRANSACTION;
     } else {
         LOGI("Media device: %s", mDeviceInfo.driver);
     }
 
-    if (close(fd)) {
+    if (SysCall::close(fd)) {
         LOGE("ERROR in closing media controller: %s!", strerror(errno));
 
         if (!ret) {
@@ -1295,7 +1303,7 @@ void CameraHWInfo::getMediaCtlElementNames(std::vector<std::string> &elementName
     // TODO: return all media devices's elements now, maybe just return
     // specific media device's elements
     for (auto mcPath : mMediaControllerPathName) {
-        int fd = open(mcPath.c_str(), O_RDONLY);
+        int fd = SysCall::open(mcPath.c_str(), O_RDONLY);
         CheckError(fd == -1, VOID_VALUE, "@%s, Could not open media controller device: %s",
                    __FUNCTION__, strerror(errno));
 
@@ -1303,13 +1311,13 @@ void CameraHWInfo::getMediaCtlElementNames(std::vector<std::string> &elementName
         CLEAR(entity);
         entity.id |= MEDIA_ENT_ID_FLAG_NEXT;
 
-        while (ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) >= 0) {
+        while (SysCall::ioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &entity) >= 0) {
             elementNames.push_back(std::string(entity.name));
             LOGI("@%s, entity name:%s, id:%d", __FUNCTION__, entity.name, entity.id);
             entity.id |= MEDIA_ENT_ID_FLAG_NEXT;
         }
 
-        CheckError(close(fd) > 0, VOID_VALUE, "@%s, Error in closing media controller: %s",
+        CheckError(SysCall::close(fd) > 0, VOID_VALUE, "@%s, Error in closing media controller: %s",
                    __FUNCTION__, strerror(errno));
     }
 }
@@ -1355,7 +1363,7 @@ CameraHWInfo::initDriverListHelper(unsigned major, unsigned minor,
         subdevPathNameN = subdevPathName + std::to_string(n);
         struct stat fileInfo;
         CLEAR(fileInfo);
-        if (stat(subdevPathNameN.c_str(), &fileInfo) < 0) {
+        if (SysCall::stat(subdevPathNameN.c_str(), &fileInfo) < 0) {
             if (errno == ENOENT) {
                 // We end up here when there is no Nth subdevice
                 // but there might be more subdevices, so continue.
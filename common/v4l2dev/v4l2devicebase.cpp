@@ -56,7 +56,7 @@ status_t V4L2DeviceBase::open()
         return NO_ERROR; //INVALID_OPERATION;
     }
 
-    if (stat (mName.c_str(), &st) == -1) {
+    if (SysCall::stat(mName.c_str(), &st) == -1) {
         LOGE("Error stat video device %s: %s",
              mName.c_str(), strerror(errno));
         return UNKNOWN_ERROR;
@@ -0,0 +1,1446 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VirtualKernel"
+
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/media-bus-format.h>
+#include <algorithm>
+#include <chrono>
+#include "LogHelper.h"
+#include "VirtualKernel.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+NAMESPACE_DECLARATION {
+
+namespace {
+
+const uint32_t kVideoMajor = 81;
+const uint32_t kMediaMajor = 240;
+const uint32_t kMaxBuffers = 32;
+const uint32_t kMmapCookieShift = 20;
+const uint32_t kMetaBufferSize = 16384;
+const uint32_t kMinWidth = 32;
+const uint32_t kMinHeight = 16;
+const uint32_t kSelfPathMaxWidth = 1920;
+const uint32_t kSelfPathMaxHeight = 1080;
+const int64_t kMinFramePeriodNs = 1000000;
+
+const char *kDevDir = "/dev/";
+const char *kSysDevChar = "/sys/dev/char/";
+const char *kSysDevicePath = "../../devices/platform/ff910000.rkisp1/video4linux/";
+const char *kOwnedDevPrefixes[] = { "video", "v4l-subdev", "media" };
+
+const uint32_t kFmtParams = v4l2_fourcc('R', 'K', '1', 'P');
+const uint32_t kFmtStats = v4l2_fourcc('R', 'K', '1', 'S');
+
+/* BT.601 limited range color bars: white, yellow, cyan, green, magenta, red, blue, black */
+const uint8_t kBars[8][3] = {
+    { 235, 128, 128 }, { 210, 16, 146 }, { 170, 166, 16 }, { 145, 54, 34 },
+    { 106, 202, 222 }, { 81, 90, 240 }, { 41, 240, 110 }, { 16, 128, 128 },
+};
+
+int setErrno(int err)
+{
+    errno = err;
+    return -1;
+}
+
+int memfdCreate(const char *name)
+{
+    return syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+}
+
+uint32_t pageAlign(uint32_t size)
+{
+    return (size + PAGESIZE - 1) & ~(PAGESIZE - 1);
+}
+
+bool startsWith(const char *str, const char *prefix)
+{
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+} // namespace
+
+void VirtualKernel::setup()
+{
+    static VirtualKernel *sKernel = nullptr;
+    if (sKernel)
+        return;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.camera.virtual", value, "0");
+    if (atoi(value) == 0)
+        return;
+
+    // a test hook, never honoured on user builds
+    property_get("ro.debuggable", value, "0");
+    if (atoi(value) == 0) {
+        LOGW("@%s: vendor.camera.virtual ignored on a non debuggable build", __FUNCTION__);
+        return;
+    }
+
+    char sensor[PROPERTY_VALUE_MAX];
+    char source[PROPERTY_VALUE_MAX];
+    int width = 0, height = 0;
+    property_get("vendor.camera.virtual.sensor", sensor, "ov5695");
+    property_get("vendor.camera.virtual.source", source, "");
+    property_get("vendor.camera.virtual.size", value, "2592x1944");
+    if (sscanf(value, "%dx%d", &width, &height) != 2 ||
+        width < (int)kMinWidth || height < (int)kMinHeight) {
+        LOGW("@%s: bad size %s, using 2592x1944", __FUNCTION__, value);
+        width = 2592;
+        height = 1944;
+    }
+    property_get("vendor.camera.virtual.fps", value, "30");
+    int fps = atoi(value);
+    if (fps <= 0)
+        fps = 30;
+
+    LOGI("@%s: virtual %s %dx%d@%d, frames from %s", __FUNCTION__, sensor,
+         width, height, fps, source[0] ? source : "pattern");
+
+    // never deleted, SysCall users may run until the process exits
+    sKernel = new VirtualKernel(sensor, width, height, fps, source);
+    SysCall::setBackend(sKernel);
+}
+
+VirtualKernel::VirtualKernel(const std::string &sensorName, int width, int height,
+                             int fps, const std::string &sourceDir) :
+    mSensorName(sensorName),
+    mWidth(width & ~1),
+    mHeight(height & ~1),
+    mSourceDir(sourceDir),
+    mSensor(nullptr),
+    mSequence(0),
+    mClockRunning(false)
+{
+    addNode(NODE_MEDIA, "rkisp1", "media0", 0, 0);
+
+    Node *isp = addNode(NODE_SUBDEV, "rkisp1-isp-subdev", "v4l-subdev0",
+                        MEDIA_ENT_T_V4L2_SUBDEV, 4);
+    Node *dphy = addNode(NODE_SUBDEV, "rockchip-mipi-dphy-rx", "v4l-subdev1",
+                         MEDIA_ENT_T_V4L2_SUBDEV, 2);
+    mSensor = addNode(NODE_SUBDEV, "m00_b_" + mSensorName + " 1-0010", "v4l-subdev2",
+                      MEDIA_ENT_T_V4L2_SUBDEV_SENSOR, 1);
+    Node *mainPath = addNode(NODE_VIDEO, "rkisp1_mainpath", "video0",
+                             MEDIA_ENT_T_DEVNODE_V4L, 1);
+    Node *selfPath = addNode(NODE_VIDEO, "rkisp1_selfpath", "video1",
+                             MEDIA_ENT_T_DEVNODE_V4L, 1);
+    Node *rawPath = addNode(NODE_VIDEO, "rkisp1_rawpath", "video2",
+                            MEDIA_ENT_T_DEVNODE_V4L, 1);
+    Node *stats = addNode(NODE_VIDEO, "rkisp1-statistics", "video3",
+                          MEDIA_ENT_T_DEVNODE_V4L, 1);
+    Node *params = addNode(NODE_VIDEO, "rkisp1-input-params", "video4",
+                           MEDIA_ENT_T_DEVNODE_V4L, 1);
+
+    isp->padFlags = { MEDIA_PAD_FL_SINK, MEDIA_PAD_FL_SINK,
+                      MEDIA_PAD_FL_SOURCE, MEDIA_PAD_FL_SOURCE };
+    dphy->padFlags = { MEDIA_PAD_FL_SINK, MEDIA_PAD_FL_SOURCE };
+    mSensor->padFlags = { MEDIA_PAD_FL_SOURCE };
+    mainPath->padFlags = selfPath->padFlags = rawPath->padFlags =
+        stats->padFlags = { MEDIA_PAD_FL_SINK };
+    params->padFlags = { MEDIA_PAD_FL_SOURCE };
+
+    addLink(mSensor, 0, dphy, 0, MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE);
+    addLink(dphy, 1, isp, 0, MEDIA_LNK_FL_ENABLED);
+    addLink(dphy, 1, rawPath, 0, 0);
+    addLink(params, 0, isp, 1, MEDIA_LNK_FL_ENABLED);
+    addLink(isp, 2, mainPath, 0, MEDIA_LNK_FL_ENABLED);
+    addLink(isp, 2, selfPath, 0, MEDIA_LNK_FL_ENABLED);
+    addLink(isp, 3, stats, 0, MEDIA_LNK_FL_ENABLED);
+
+    addSensorControls(mSensor);
+    int64_t lineLength = 0, frameLength = 0;
+    for (auto &ctrl : mSensor->controls) {
+        if (ctrl.id == V4L2_CID_HBLANK)
+            lineLength = mWidth + ctrl.value;
+        if (ctrl.id == V4L2_CID_VBLANK)
+            frameLength = mHeight + ctrl.value;
+    }
+    for (auto &ctrl : mSensor->controls) {
+        if (ctrl.id == V4L2_CID_PIXEL_RATE)
+            ctrl.min = ctrl.max = ctrl.def = ctrl.value = lineLength * frameLength * fps;
+    }
+
+    mainPath->bufType = selfPath->bufType = rawPath->bufType =
+        V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    stats->bufType = V4L2_BUF_TYPE_META_CAPTURE;
+    params->bufType = V4L2_BUF_TYPE_META_OUTPUT;
+
+    mainPath->pixelFormats = selfPath->pixelFormats = {
+        V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, V4L2_PIX_FMT_NV16, V4L2_PIX_FMT_YUYV };
+    rawPath->pixelFormats = { V4L2_PIX_FMT_SBGGR10, V4L2_PIX_FMT_SBGGR8 };
+    stats->pixelFormats = { kFmtStats };
+    params->pixelFormats = { kFmtParams };
+
+    for (auto &node : mNodes) {
+        if (node->kind == NODE_VIDEO)
+            applyFormat(node.get(), node->pixelFormats[0], mWidth, mHeight);
+    }
+}
+
+VirtualKernel::~VirtualKernel()
+{
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        for (auto &node : mNodes)
+            stopStreaming(node.get());
+    }
+    if (mClock.joinable())
+        mClock.join();
+
+    for (auto &it : mFds)
+        ::close(it.first);
+    for (auto &node : mNodes) {
+        freeBuffers(node.get());
+        if (node->source)
+            ::munmap(node->source, node->sourceSize);
+    }
+}
+
+VirtualKernel::Node *VirtualKernel::addNode(NodeKind kind, const std::string &name,
+                                            const std::string &devName,
+                                            uint32_t type, int pads)
+{
+    std::unique_ptr<Node> node(new Node());
+    node->kind = kind;
+    node->name = name;
+    node->devName = devName;
+    node->entityId = kind == NODE_MEDIA ? 0 : mNodes.size();
+    node->entityType = type;
+    node->minor = mNodes.size();
+    node->padFlags.resize(pads);
+    node->bufType = 0;
+    node->pixelFormat = 0;
+    node->width = node->height = 0;
+    node->bytesperline = node->sizeimage = 0;
+    node->memory = V4L2_MEMORY_MMAP;
+    node->streaming = false;
+    node->signaled = false;
+    node->source = nullptr;
+    node->sourceSize = 0;
+
+    mNodes.push_back(std::move(node));
+    return mNodes.back().get();
+}
+
+void VirtualKernel::addLink(Node *source, uint16_t sourcePad, Node *sink,
+                            uint16_t sinkPad, uint32_t flags)
+{
+    Link link = { source, sourcePad, sink, sinkPad, flags };
+    mLinks.push_back(link);
+}
+
+void VirtualKernel::addSensorControls(Node *sensor)
+{
+    int64_t hblank = mWidth / 8;
+    int64_t vblank = mHeight / 32;
+    // pixel rate is fixed once the default frame rate is known
+    sensor->controls = {
+        { V4L2_CID_EXPOSURE, V4L2_CTRL_TYPE_INTEGER, "Exposure",
+          4, 65535, mHeight, mHeight, 0 },
+        { V4L2_CID_ANALOGUE_GAIN, V4L2_CTRL_TYPE_INTEGER, "Analogue Gain",
+          16, 1024, 16, 16, 0 },
+        { V4L2_CID_VBLANK, V4L2_CTRL_TYPE_INTEGER, "Vertical Blanking",
+          4, 65535 - mHeight, vblank, vblank, 0 },
+        { V4L2_CID_HBLANK, V4L2_CTRL_TYPE_INTEGER, "Horizontal Blanking",
+          hblank, hblank, hblank, hblank, V4L2_CTRL_FLAG_READ_ONLY },
+        { V4L2_CID_PIXEL_RATE, V4L2_CTRL_TYPE_INTEGER64, "Pixel Rate",
+          0, 0, 0, 0, V4L2_CTRL_FLAG_READ_ONLY },
+        { V4L2_CID_LINK_FREQ, V4L2_CTRL_TYPE_INTEGER_MENU, "Link Frequency",
+          0, 0, 0, 0, V4L2_CTRL_FLAG_READ_ONLY },
+        { V4L2_CID_HFLIP, V4L2_CTRL_TYPE_BOOLEAN, "Horizontal Flip", 0, 1, 0, 0, 0 },
+        { V4L2_CID_VFLIP, V4L2_CTRL_TYPE_BOOLEAN, "Vertical Flip", 0, 1, 0, 0, 0 },
+        { V4L2_CID_TEST_PATTERN, V4L2_CTRL_TYPE_MENU, "Test Pattern", 0, 1, 0, 0, 0 },
+    };
+}
+
+bool VirtualKernel::ownsPath(const char *pathname)
+{
+    if (startsWith(pathname, kSysDevChar))
+        return true;
+    if (!startsWith(pathname, kDevDir))
+        return false;
+    for (auto prefix : kOwnedDevPrefixes) {
+        if (startsWith(pathname + strlen(kDevDir), prefix))
+            return true;
+    }
+    return false;
+}
+
+VirtualKernel::Node *VirtualKernel::findPath(const char *pathname)
+{
+    if (!startsWith(pathname, kDevDir))
+        return nullptr;
+    for (auto &node : mNodes) {
+        if (node->devName == pathname + strlen(kDevDir))
+            return node.get();
+    }
+    return nullptr;
+}
+
+VirtualKernel::Node *VirtualKernel::findFd(int fd)
+{
+    auto it = mFds.find(fd);
+    return it == mFds.end() ? nullptr : it->second;
+}
+
+VirtualKernel::Node *VirtualKernel::findEntity(uint32_t id)
+{
+    for (auto &node : mNodes) {
+        if (node->kind != NODE_MEDIA && node->entityId == id)
+            return node.get();
+    }
+    return nullptr;
+}
+
+int VirtualKernel::open(const char *pathname, int flags)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Node *node = findPath(pathname);
+    if (node == nullptr) {
+        if (ownsPath(pathname))
+            return setErrno(ENOENT);
+        return ::open(pathname, flags);
+    }
+
+    int efdFlags = EFD_CLOEXEC | ((flags & O_NONBLOCK) ? EFD_NONBLOCK : 0);
+    int fd = eventfd(node->signaled ? 1 : 0, efdFlags);
+    if (fd < 0)
+        return -1;
+
+    node->fds.push_back(fd);
+    mFds[fd] = node;
+    LOGI("@%s: %s as fd %d", __FUNCTION__, pathname, fd);
+    return fd;
+}
+
+int VirtualKernel::close(int fd)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Node *node = findFd(fd);
+    if (node == nullptr)
+        return ::close(fd);
+
+    mFds.erase(fd);
+    node->fds.erase(std::find(node->fds.begin(), node->fds.end(), fd));
+    // the last close releases the queue, like vb2 does
+    if (node->fds.empty() && node->kind == NODE_VIDEO) {
+        stopStreaming(node);
+        freeBuffers(node);
+    }
+    return ::close(fd);
+}
+
+int VirtualKernel::ioctl(int fd, int request, void *arg)
+{
+    std::unique_lock<std::mutex> l(mLock);
+    Node *node = findFd(fd);
+    if (node == nullptr) {
+        l.unlock();
+        return ::ioctl(fd, request, arg);
+    }
+
+    unsigned long req = (unsigned int)request;
+    switch (node->kind) {
+    case NODE_MEDIA:
+        return mediaIoctl(node, req, arg);
+    case NODE_SUBDEV:
+        return subdevIoctl(node, req, arg);
+    case NODE_VIDEO:
+        return videoIoctl(node, fd, req, arg, l);
+    }
+    return setErrno(ENOTTY);
+}
+
+void *VirtualKernel::mmap(void *addr, size_t length, int prot, int flags,
+                          int fd, off_t offset)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Node *node = findFd(fd);
+    if (node == nullptr)
+        return ::mmap(addr, length, prot, flags, fd, offset);
+
+    for (auto &buffer : node->buffers) {
+        if (buffer.memfd < 0 || buffer.offset != offset)
+            continue;
+        if (length > pageAlign(buffer.length)) {
+            errno = EINVAL;
+            return MAP_FAILED;
+        }
+        return ::mmap(addr, length, prot, flags, buffer.memfd, 0);
+    }
+    errno = EINVAL;
+    return MAP_FAILED;
+}
+
+int VirtualKernel::stat(const char *pathname, struct stat *st)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Node *node = findPath(pathname);
+    if (node == nullptr) {
+        if (ownsPath(pathname))
+            return setErrno(ENOENT);
+        return ::stat(pathname, st);
+    }
+
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFCHR | 0660;
+    st->st_rdev = makedev(node->kind == NODE_MEDIA ? kMediaMajor : kVideoMajor,
+                          node->minor);
+    return 0;
+}
+
+ssize_t VirtualKernel::readlink(const char *pathname, char *buf, size_t bufsiz)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    unsigned int major = 0, minor = 0;
+    if (!startsWith(pathname, kSysDevChar))
+        return ::readlink(pathname, buf, bufsiz);
+    if (sscanf(pathname + strlen(kSysDevChar), "%u:%u", &major, &minor) != 2 ||
+        major != kVideoMajor)
+        return setErrno(ENOENT);
+
+    for (auto &node : mNodes) {
+        if (node->kind == NODE_MEDIA || node->minor != minor)
+            continue;
+        std::string link = std::string(kSysDevicePath) + node->devName;
+        size_t len = std::min(link.size(), bufsiz);
+        memcpy(buf, link.c_str(), len);
+        return len;
+    }
+    return setErrno(ENOENT);
+}
+
+int VirtualKernel::listDir(const char *dirname, std::vector<std::string> &names)
+{
+    bool devDir = strcmp(dirname, kDevDir) == 0 || strcmp(dirname, "/dev") == 0;
+
+    DIR *dir = opendir(dirname);
+    if (dir == nullptr && !devDir)
+        return -1;
+
+    if (dir) {
+        struct dirent *dirEnt;
+        while ((dirEnt = readdir(dir)) != nullptr) {
+            std::string path = std::string(kDevDir) + dirEnt->d_name;
+            if (strcmp(dirEnt->d_name, ".") == 0 || strcmp(dirEnt->d_name, "..") == 0 ||
+                (devDir && ownsPath(path.c_str())))
+                continue;
+            names.push_back(dirEnt->d_name);
+        }
+        closedir(dir);
+    }
+
+    if (devDir) {
+        std::lock_guard<std::mutex> l(mLock);
+        for (auto &node : mNodes)
+            names.push_back(node->devName);
+    }
+    return 0;
+}
+
+int VirtualKernel::mediaIoctl(Node *node, unsigned long request, void *arg)
+{
+    UNUSED(node);
+
+    switch (request) {
+    case MEDIA_IOC_DEVICE_INFO: {
+        struct media_device_info *info = (struct media_device_info *)arg;
+        memset(info, 0, sizeof(*info));
+        strncpy(info->driver, "rkisp1", sizeof(info->driver) - 1);
+        strncpy(info->model, "rkisp1", sizeof(info->model) - 1);
+        strncpy(info->bus_info, "platform:ff910000.rkisp1", sizeof(info->bus_info) - 1);
+        return 0;
+    }
+    case MEDIA_IOC_ENUM_ENTITIES: {
+        struct media_entity_desc *desc = (struct media_entity_desc *)arg;
+        Node *entity = nullptr;
+        if (desc->id & MEDIA_ENT_ID_FLAG_NEXT) {
+            uint32_t id = desc->id & ~MEDIA_ENT_ID_FLAG_NEXT;
+            for (auto &it : mNodes) {
+                if (it->kind != NODE_MEDIA && it->entityId > id &&
+                    (entity == nullptr || it->entityId < entity->entityId))
+                    entity = it.get();
+            }
+        } else {
+            entity = findEntity(desc->id);
+        }
+        if (entity == nullptr)
+            return setErrno(EINVAL);
+
+        memset(desc, 0, sizeof(*desc));
+        desc->id = entity->entityId;
+        strncpy(desc->name, entity->name.c_str(), sizeof(desc->name) - 1);
+        desc->type = entity->entityType;
+        desc->pads = entity->padFlags.size();
+        for (auto &link : mLinks) {
+            if (link.source == entity)
+                desc->links++;
+        }
+        desc->v4l.major = kVideoMajor;
+        desc->v4l.minor = entity->minor;
+        return 0;
+    }
+    case MEDIA_IOC_ENUM_LINKS: {
+        struct media_links_enum *links = (struct media_links_enum *)arg;
+        Node *entity = findEntity(links->entity);
+        if (entity == nullptr)
+            return setErrno(EINVAL);
+
+        if (links->pads) {
+            for (size_t i = 0; i < entity->padFlags.size(); i++) {
+                links->pads[i].entity = entity->entityId;
+                links->pads[i].index = i;
+                links->pads[i].flags = entity->padFlags[i];
+            }
+        }
+        if (links->links) {
+            int n = 0;
+            for (auto &link : mLinks) {
+                if (link.source != entity)
+                    continue;
+                struct media_link_desc &desc = links->links[n++];
+                desc.source.entity = link.source->entityId;
+                desc.source.index = link.sourcePad;
+                desc.source.flags = link.source->padFlags[link.sourcePad];
+                desc.sink.entity = link.sink->entityId;
+                desc.sink.index = link.sinkPad;
+                desc.sink.flags = link.sink->padFlags[link.sinkPad];
+                desc.flags = link.flags;
+            }
+        }
+        return 0;
+    }
+    case MEDIA_IOC_SETUP_LINK: {
+        struct media_link_desc *desc = (struct media_link_desc *)arg;
+        for (auto &link : mLinks) {
+            if (link.source->entityId != desc->source.entity ||
+                link.sourcePad != desc->source.index ||
+                link.sink->entityId != desc->sink.entity ||
+                link.sinkPad != desc->sink.index)
+                continue;
+            if ((link.flags & MEDIA_LNK_FL_IMMUTABLE) &&
+                !(desc->flags & MEDIA_LNK_FL_ENABLED))
+                return setErrno(EINVAL);
+            link.flags = (link.flags & ~MEDIA_LNK_FL_ENABLED) |
+                         (desc->flags & MEDIA_LNK_FL_ENABLED);
+            return 0;
+        }
+        return setErrno(EINVAL);
+    }
+    default:
+        return setErrno(ENOTTY);
+    }
+}
+
+int VirtualKernel::controlIoctl(Node *node, unsigned long request, void *arg)
+{
+    auto findControl = [node](uint32_t id) -> Control* {
+        for (auto &ctrl : node->controls) {
+            if (ctrl.id == id)
+                return &ctrl;
+        }
+        return nullptr;
+    };
+    auto setControl = [](Control *ctrl, int64_t value) -> int {
+        if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY)
+            return EACCES;
+        ctrl->value = std::max(ctrl->min, std::min(ctrl->max, value));
+        return 0;
+    };
+
+    switch (request) {
+    case VIDIOC_QUERYCTRL: {
+        struct v4l2_queryctrl *query = (struct v4l2_queryctrl *)arg;
+        Control *ctrl = nullptr;
+        if (query->id & V4L2_CTRL_FLAG_NEXT_CTRL) {
+            uint32_t id = query->id & V4L2_CTRL_ID_MASK;
+            for (auto &it : node->controls) {
+                if (it.id > id && (ctrl == nullptr || it.id < ctrl->id))
+                    ctrl = &it;
+            }
+        } else {
+            ctrl = findControl(query->id);
+        }
+        if (ctrl == nullptr)
+            return setErrno(EINVAL);
+
+        memset(query, 0, sizeof(*query));
+        query->id = ctrl->id;
+        query->type = ctrl->type;
+        strncpy((char *)query->name, ctrl->name, sizeof(query->name) - 1);
+        if (ctrl->type != V4L2_CTRL_TYPE_INTEGER64) {
+            query->minimum = ctrl->min;
+            query->maximum = ctrl->max;
+            query->default_value = ctrl->def;
+        }
+        query->step = 1;
+        query->flags = ctrl->flags;
+        return 0;
+    }
+    case VIDIOC_QUERYMENU: {
+        struct v4l2_querymenu *menu = (struct v4l2_querymenu *)arg;
+        Control *ctrl = findControl(menu->id);
+        if (ctrl == nullptr || menu->index < ctrl->min || menu->index > ctrl->max)
+            return setErrno(EINVAL);
+        if (ctrl->type == V4L2_CTRL_TYPE_INTEGER_MENU) {
+            // link frequency of a 2 lane, 10 bit, DDR bus
+            Control *rate = findControl(V4L2_CID_PIXEL_RATE);
+            menu->value = rate ? rate->value * 10 / 2 / 2 : 0;
+        } else {
+            snprintf((char *)menu->name, sizeof(menu->name), "%s",
+                     menu->index ? "Color Bars" : "Disabled");
+        }
+        return 0;
+    }
+    case VIDIOC_G_CTRL:
+    case VIDIOC_S_CTRL: {
+        struct v4l2_control *control = (struct v4l2_control *)arg;
+        Control *ctrl = findControl(control->id);
+        if (ctrl == nullptr)
+            return setErrno(EINVAL);
+        if (request == VIDIOC_S_CTRL) {
+            int err = setControl(ctrl, control->value);
+            if (err)
+                return setErrno(err);
+        }
+        control->value = ctrl->value;
+        return 0;
+    }
+    case VIDIOC_G_EXT_CTRLS:
+    case VIDIOC_S_EXT_CTRLS:
+    case VIDIOC_TRY_EXT_CTRLS: {
+        struct v4l2_ext_controls *controls = (struct v4l2_ext_controls *)arg;
+        for (uint32_t i = 0; i < controls->count; i++) {
+            struct v4l2_ext_control &control = controls->controls[i];
+            Control *ctrl = findControl(control.id);
+            if (ctrl == nullptr) {
+                controls->error_idx = i;
+                return setErrno(EINVAL);
+            }
+            bool is64 = ctrl->type == V4L2_CTRL_TYPE_INTEGER64;
+            if (request == VIDIOC_S_EXT_CTRLS) {
+                int err = setControl(ctrl, is64 ? control.value64 : control.value);
+                if (err) {
+                    controls->error_idx = i;
+                    return setErrno(err);
+                }
+            }
+            if (request != VIDIOC_TRY_EXT_CTRLS) {
+                if (is64)
+                    control.value64 = ctrl->value;
+                else
+                    control.value = ctrl->value;
+            }
+        }
+        return 0;
+    }
+    default:
+        return setErrno(ENOTTY);
+    }
+}
+
+int VirtualKernel::subdevIoctl(Node *node, unsigned long request, void *arg)
+{
+    bool isSensor = node == mSensor;
+    v4l2_mbus_framefmt sensorFmt;
+    memset(&sensorFmt, 0, sizeof(sensorFmt));
+    sensorFmt.width = mWidth;
+    sensorFmt.height = mHeight;
+    sensorFmt.code = MEDIA_BUS_FMT_SBGGR10_1X10;
+    sensorFmt.field = V4L2_FIELD_NONE;
+
+    switch (request) {
+    case VIDIOC_SUBDEV_G_FMT:
+    case VIDIOC_SUBDEV_S_FMT: {
+        struct v4l2_subdev_format *format = (struct v4l2_subdev_format *)arg;
+        if (format->pad >= node->padFlags.size())
+            return setErrno(EINVAL);
+        if (request == VIDIOC_SUBDEV_G_FMT) {
+            auto it = node->padFormats.find(format->pad);
+            format->format = it == node->padFormats.end() ? sensorFmt : it->second;
+            return 0;
+        }
+        // the sensor has a single mode
+        if (isSensor)
+            format->format = sensorFmt;
+        if (format->which == V4L2_SUBDEV_FORMAT_ACTIVE)
+            node->padFormats[format->pad] = format->format;
+        return 0;
+    }
+    case VIDIOC_SUBDEV_G_SELECTION:
+    case VIDIOC_SUBDEV_S_SELECTION: {
+        struct v4l2_subdev_selection *sel = (struct v4l2_subdev_selection *)arg;
+        if (sel->pad >= node->padFlags.size())
+            return setErrno(EINVAL);
+        uint64_t key = ((uint64_t)sel->pad << 32) | sel->target;
+        if (request == VIDIOC_SUBDEV_S_SELECTION) {
+            if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE)
+                node->selections[key] = sel->r;
+            return 0;
+        }
+        auto it = node->selections.find(key);
+        if (it != node->selections.end()) {
+            sel->r = it->second;
+        } else {
+            sel->r.left = sel->r.top = 0;
+            sel->r.width = mWidth;
+            sel->r.height = mHeight;
+        }
+        return 0;
+    }
+    case VIDIOC_SUBDEV_ENUM_MBUS_CODE: {
+        struct v4l2_subdev_mbus_code_enum *code = (struct v4l2_subdev_mbus_code_enum *)arg;
+        if (code->index > 0 || code->pad >= node->padFlags.size())
+            return setErrno(EINVAL);
+        // the isp outputs yuv on its video source pad
+        code->code = (node->entityType == MEDIA_ENT_T_V4L2_SUBDEV && node->padFlags.size() == 4 &&
+                      code->pad == 2) ? MEDIA_BUS_FMT_YUYV8_2X8 : sensorFmt.code;
+        return 0;
+    }
+    case VIDIOC_SUBDEV_ENUM_FRAME_SIZE: {
+        struct v4l2_subdev_frame_size_enum *size = (struct v4l2_subdev_frame_size_enum *)arg;
+        if (size->index > 0 || size->pad >= node->padFlags.size())
+            return setErrno(EINVAL);
+        size->min_width = isSensor ? mWidth : kMinWidth;
+        size->min_height = isSensor ? mHeight : kMinHeight;
+        size->max_width = mWidth;
+        size->max_height = mHeight;
+        return 0;
+    }
+    case VIDIOC_SUBDEV_G_FRAME_INTERVAL:
+    case VIDIOC_SUBDEV_S_FRAME_INTERVAL: {
+        struct v4l2_subdev_frame_interval *ival = (struct v4l2_subdev_frame_interval *)arg;
+        if (!isSensor)
+            return setErrno(ENOTTY);
+        if (request == VIDIOC_SUBDEV_S_FRAME_INTERVAL &&
+            ival->interval.numerator && ival->interval.denominator) {
+            // a sensor stretches its frame with vertical blanking
+            int64_t lineLength = 0, pixelRate = 0;
+            for (auto &ctrl : node->controls) {
+                if (ctrl.id == V4L2_CID_HBLANK)
+                    lineLength = mWidth + ctrl.value;
+                if (ctrl.id == V4L2_CID_PIXEL_RATE)
+                    pixelRate = ctrl.value;
+            }
+            int64_t frameLength = pixelRate * ival->interval.numerator /
+                                  ival->interval.denominator / lineLength;
+            for (auto &ctrl : node->controls) {
+                if (ctrl.id == V4L2_CID_VBLANK)
+                    ctrl.value = std::max(ctrl.min, std::min(ctrl.max, frameLength - mHeight));
+            }
+        }
+        ival->interval.numerator = framePeriodNs() / 1000;
+        ival->interval.denominator = 1000000;
+        return 0;
+    }
+    case VIDIOC_SUBSCRIBE_EVENT:
+    case VIDIOC_UNSUBSCRIBE_EVENT:
+        return 0;
+    case VIDIOC_DQEVENT:
+        return setErrno(ENOENT);
+    default:
+        return controlIoctl(node, request, arg);
+    }
+}
+
+bool VirtualKernel::isMplane(const Node *node) const
+{
+    return node->bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ||
+           node->bufType == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+}
+
+bool VirtualKernel::isCapture(const Node *node) const
+{
+    return node->bufType != V4L2_BUF_TYPE_META_OUTPUT &&
+           node->bufType != V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+}
+
+void VirtualKernel::applyFormat(Node *node, uint32_t pixelFormat, uint32_t width,
+                                uint32_t height)
+{
+    if (std::find(node->pixelFormats.begin(), node->pixelFormats.end(), pixelFormat) ==
+        node->pixelFormats.end())
+        pixelFormat = node->pixelFormats[0];
+
+    uint32_t maxWidth = mWidth, maxHeight = mHeight;
+    if (node->name == "rkisp1_selfpath") {
+        maxWidth = std::min(maxWidth, kSelfPathMaxWidth);
+        maxHeight = std::min(maxHeight, kSelfPathMaxHeight);
+    }
+    // the raw path dumps whole sensor frames
+    if (node->name == "rkisp1_rawpath") {
+        width = mWidth;
+        height = mHeight;
+    }
+    node->pixelFormat = pixelFormat;
+    node->width = std::max(kMinWidth, std::min(maxWidth, width)) & ~1;
+    node->height = std::max(kMinHeight, std::min(maxHeight, height)) & ~1;
+
+    switch (pixelFormat) {
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+        node->bytesperline = node->width;
+        node->sizeimage = node->bytesperline * node->height * 3 / 2;
+        break;
+    case V4L2_PIX_FMT_NV16:
+        node->bytesperline = node->width;
+        node->sizeimage = node->bytesperline * node->height * 2;
+        break;
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_SBGGR10:
+        node->bytesperline = node->width * 2;
+        node->sizeimage = node->bytesperline * node->height;
+        break;
+    case V4L2_PIX_FMT_SBGGR8:
+        node->bytesperline = node->width;
+        node->sizeimage = node->bytesperline * node->height;
+        break;
+    default:
+        node->width = node->height = 0;
+        node->bytesperline = node->sizeimage = kMetaBufferSize;
+        break;
+    }
+}
+
+void VirtualKernel::getFormat(const Node *node, struct v4l2_format *fmt) const
+{
+    memset(&fmt->fmt, 0, sizeof(fmt->fmt));
+    fmt->type = node->bufType;
+    if (node->bufType == V4L2_BUF_TYPE_META_CAPTURE ||
+        node->bufType == V4L2_BUF_TYPE_META_OUTPUT) {
+        fmt->fmt.meta.dataformat = node->pixelFormat;
+        fmt->fmt.meta.buffersize = node->sizeimage;
+        return;
+    }
+
+    struct v4l2_pix_format_mplane &pix = fmt->fmt.pix_mp;
+    pix.width = node->width;
+    pix.height = node->height;
+    pix.pixelformat = node->pixelFormat;
+    pix.field = V4L2_FIELD_NONE;
+    pix.colorspace = V4L2_COLORSPACE_JPEG;
+    pix.num_planes = 1;
+    pix.plane_fmt[0].bytesperline = node->bytesperline;
+    pix.plane_fmt[0].sizeimage = node->sizeimage;
+}
+
+int VirtualKernel::requestBuffers(Node *node, struct v4l2_requestbuffers *req)
+{
+    if (req->type != node->bufType)
+        return setErrno(EINVAL);
+    if (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR &&
+        req->memory != V4L2_MEMORY_DMABUF)
+        return setErrno(EINVAL);
+    if (node->streaming)
+        return setErrno(EBUSY);
+
+    freeBuffers(node);
+    node->memory = req->memory;
+    req->count = std::min(req->count, kMaxBuffers);
+
+    for (uint32_t i = 0; i < req->count; i++) {
+        Buffer buffer;
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.memfd = -1;
+        buffer.dmafd = -1;
+        buffer.offset = i << kMmapCookieShift;
+        buffer.length = node->sizeimage;
+
+        if (req->memory == V4L2_MEMORY_MMAP) {
+            std::string name = node->devName + "-" + std::to_string(i);
+            buffer.memfd = memfdCreate(name.c_str());
+            if (buffer.memfd < 0 || ftruncate(buffer.memfd, pageAlign(buffer.length)) < 0) {
+                LOGE("@%s: %s, cannot allocate buffer %u: %s", __FUNCTION__,
+                     node->name.c_str(), i, strerror(errno));
+                if (buffer.memfd >= 0)
+                    ::close(buffer.memfd);
+                req->count = i;
+                break;
+            }
+            buffer.map = ::mmap(nullptr, pageAlign(buffer.length), PROT_READ | PROT_WRITE,
+                                MAP_SHARED, buffer.memfd, 0);
+            if (buffer.map == MAP_FAILED)
+                buffer.map = nullptr;
+            buffer.mapLength = buffer.length;
+        }
+        node->buffers.push_back(buffer);
+    }
+    return 0;
+}
+
+void VirtualKernel::freeBuffers(Node *node)
+{
+    for (auto &buffer : node->buffers) {
+        if (buffer.memfd >= 0) {
+            if (buffer.map)
+                ::munmap(buffer.map, pageAlign(buffer.length));
+            ::close(buffer.memfd);
+        } else if (buffer.dmafd >= 0 && buffer.map) {
+            ::munmap(buffer.map, buffer.mapLength);
+        }
+    }
+    node->buffers.clear();
+}
+
+void VirtualKernel::fillBuffer(const Node *node, uint32_t index, struct v4l2_buffer *buf) const
+{
+    const Buffer &buffer = node->buffers[index];
+    struct v4l2_plane *plane = isMplane(node) ? buf->m.planes : nullptr;
+
+    buf->index = index;
+    buf->memory = node->memory;
+    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+    if (buffer.queued)
+        buf->flags |= buffer.done ? V4L2_BUF_FLAG_DONE : V4L2_BUF_FLAG_QUEUED;
+    if (node->memory == V4L2_MEMORY_MMAP)
+        buf->flags |= V4L2_BUF_FLAG_MAPPED;
+    buf->field = V4L2_FIELD_NONE;
+    buf->sequence = buffer.sequence;
+    buf->timestamp = buffer.timestamp;
+
+    if (plane) {
+        buf->length = 1;
+        plane->length = buffer.length;
+        plane->bytesused = buffer.bytesused;
+        if (node->memory == V4L2_MEMORY_MMAP)
+            plane->m.mem_offset = buffer.offset;
+        else if (node->memory == V4L2_MEMORY_USERPTR)
+            plane->m.userptr = buffer.userptr;
+        else
+            plane->m.fd = buffer.dmafd;
+    } else {
+        buf->length = buffer.length;
+        buf->bytesused = buffer.bytesused;
+        if (node->memory == V4L2_MEMORY_MMAP)
+            buf->m.offset = buffer.offset;
+        else if (node->memory == V4L2_MEMORY_USERPTR)
+            buf->m.userptr = buffer.userptr;
+        else
+            buf->m.fd = buffer.dmafd;
+    }
+}
+
+int VirtualKernel::queueBuffer(Node *node, struct v4l2_buffer *buf)
+{
+    if (buf->type != node->bufType || buf->memory != node->memory ||
+        buf->index >= node->buffers.size())
+        return setErrno(EINVAL);
+
+    Buffer &buffer = node->buffers[buf->index];
+    if (buffer.queued)
+        return setErrno(EINVAL);
+
+    struct v4l2_plane *plane = isMplane(node) ? buf->m.planes : nullptr;
+    if (isMplane(node) && (plane == nullptr || buf->length < 1))
+        return setErrno(EINVAL);
+
+    uint32_t length = plane ? plane->length : buf->length;
+    uint32_t bytesused = plane ? plane->bytesused : buf->bytesused;
+    if (node->memory == V4L2_MEMORY_USERPTR) {
+        if (length < node->sizeimage)
+            return setErrno(EINVAL);
+        buffer.userptr = plane ? plane->m.userptr : buf->m.userptr;
+        buffer.map = (void *)buffer.userptr;
+        buffer.mapLength = node->sizeimage;
+    } else if (node->memory == V4L2_MEMORY_DMABUF) {
+        buffer.dmafd = plane ? plane->m.fd : buf->m.fd;
+        buffer.mapLength = node->sizeimage;
+        buffer.map = ::mmap(nullptr, buffer.mapLength, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, buffer.dmafd, 0);
+        if (buffer.map == MAP_FAILED) {
+            LOGW("@%s: %s, cannot map dmabuf %d, frames are not written: %s",
+                 __FUNCTION__, node->name.c_str(), buffer.dmafd, strerror(errno));
+            buffer.map = nullptr;
+        }
+    }
+
+    buffer.queued = true;
+    buffer.done = false;
+    if (!isCapture(node) && node->streaming) {
+        completeBuffer(node, buf->index, bytesused);
+    } else {
+        buffer.bytesused = bytesused;
+        node->queue.push_back(buf->index);
+    }
+    fillBuffer(node, buf->index, buf);
+    return 0;
+}
+
+void VirtualKernel::completeBuffer(Node *node, uint32_t index, uint32_t bytesused)
+{
+    Buffer &buffer = node->buffers[index];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    buffer.done = true;
+    buffer.bytesused = bytesused;
+    buffer.sequence = mSequence;
+    buffer.timestamp.tv_sec = now.tv_sec;
+    buffer.timestamp.tv_usec = now.tv_nsec / 1000;
+    node->doneQueue.push_back(index);
+    updateSignal(node);
+    mDoneCond.notify_all();
+}
+
+void VirtualKernel::stopStreaming(Node *node)
+{
+    if (node->kind != NODE_VIDEO)
+        return;
+
+    node->streaming = false;
+    for (auto &buffer : node->buffers) {
+        if (buffer.queued && buffer.memfd < 0 && buffer.dmafd >= 0 && buffer.map) {
+            ::munmap(buffer.map, buffer.mapLength);
+            buffer.map = nullptr;
+        }
+        buffer.queued = false;
+        buffer.done = false;
+    }
+    node->queue.clear();
+    node->doneQueue.clear();
+    updateSignal(node);
+    mDoneCond.notify_all();
+    mClockCond.notify_all();
+}
+
+/**
+ * Keeps the eventfds of the node readable exactly while it has buffers to
+ * dequeue, that is what poll reports for a real video node.
+ */
+void VirtualKernel::updateSignal(Node *node)
+{
+    bool ready = !node->doneQueue.empty();
+    if (ready == node->signaled)
+        return;
+
+    uint64_t value = 1;
+    for (int fd : node->fds) {
+        ssize_t ret = ready ? write(fd, &value, sizeof(value)) : read(fd, &value, sizeof(value));
+        if (ret != sizeof(value))
+            LOGW("@%s: %s, fd %d: %s", __FUNCTION__, node->name.c_str(), fd, strerror(errno));
+    }
+    node->signaled = ready;
+}
+
+int VirtualKernel::videoIoctl(Node *node, int fd, unsigned long request, void *arg,
+                              std::unique_lock<std::mutex> &lock)
+{
+    switch (request) {
+    case VIDIOC_QUERYCAP: {
+        struct v4l2_capability *cap = (struct v4l2_capability *)arg;
+        memset(cap, 0, sizeof(*cap));
+        strncpy((char *)cap->driver, "rkisp1", sizeof(cap->driver) - 1);
+        strncpy((char *)cap->card, node->name.c_str(), sizeof(cap->card) - 1);
+        strncpy((char *)cap->bus_info, "platform:ff910000.rkisp1", sizeof(cap->bus_info) - 1);
+        if (node->bufType == V4L2_BUF_TYPE_META_CAPTURE)
+            cap->device_caps = V4L2_CAP_META_CAPTURE;
+        else if (node->bufType == V4L2_BUF_TYPE_META_OUTPUT)
+            cap->device_caps = V4L2_CAP_META_OUTPUT;
+        else
+            cap->device_caps = V4L2_CAP_VIDEO_CAPTURE_MPLANE;
+        cap->device_caps |= V4L2_CAP_STREAMING;
+        cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+        return 0;
+    }
+    case VIDIOC_ENUM_FMT: {
+        struct v4l2_fmtdesc *desc = (struct v4l2_fmtdesc *)arg;
+        if (desc->type != node->bufType || desc->index >= node->pixelFormats.size())
+            return setErrno(EINVAL);
+        desc->pixelformat = node->pixelFormats[desc->index];
+        desc->flags = 0;
+        return 0;
+    }
+    case VIDIOC_G_FMT:
+    case VIDIOC_S_FMT:
+    case VIDIOC_TRY_FMT: {
+        struct v4l2_format *fmt = (struct v4l2_format *)arg;
+        if (fmt->type != node->bufType)
+            return setErrno(EINVAL);
+        if (request == VIDIOC_G_FMT) {
+            getFormat(node, fmt);
+            return 0;
+        }
+        if (request == VIDIOC_S_FMT && !node->buffers.empty())
+            return setErrno(EBUSY);
+
+        Node tryNode = Node();
+        Node *target = request == VIDIOC_S_FMT ? node : &tryNode;
+        if (target != node) {
+            tryNode.name = node->name;
+            tryNode.bufType = node->bufType;
+            tryNode.pixelFormats = node->pixelFormats;
+        }
+        if (isMplane(node))
+            applyFormat(target, fmt->fmt.pix_mp.pixelformat, fmt->fmt.pix_mp.width,
+                        fmt->fmt.pix_mp.height);
+        else
+            applyFormat(target, fmt->fmt.meta.dataformat, 0, 0);
+        getFormat(target, fmt);
+        return 0;
+    }
+    case VIDIOC_ENUMINPUT: {
+        struct v4l2_input *input = (struct v4l2_input *)arg;
+        if (input->index > 0)
+            return setErrno(EINVAL);
+        strncpy((char *)input->name, node->name.c_str(), sizeof(input->name) - 1);
+        input->type = V4L2_INPUT_TYPE_CAMERA;
+        return 0;
+    }
+    case VIDIOC_G_INPUT:
+        *(int *)arg = 0;
+        return 0;
+    case VIDIOC_S_INPUT:
+        return *(int *)arg == 0 ? 0 : setErrno(EINVAL);
+    case VIDIOC_REQBUFS:
+        return requestBuffers(node, (struct v4l2_requestbuffers *)arg);
+    case VIDIOC_QUERYBUF: {
+        struct v4l2_buffer *buf = (struct v4l2_buffer *)arg;
+        if (buf->type != node->bufType || buf->index >= node->buffers.size() ||
+            (isMplane(node) && buf->m.planes == nullptr))
+            return setErrno(EINVAL);
+        fillBuffer(node, buf->index, buf);
+        return 0;
+    }
+    case VIDIOC_QBUF:
+        return queueBuffer(node, (struct v4l2_buffer *)arg);
+    case VIDIOC_DQBUF: {
+        struct v4l2_buffer *buf = (struct v4l2_buffer *)arg;
+        if (buf->type != node->bufType || buf->memory != node->memory ||
+            (isMplane(node) && buf->m.planes == nullptr))
+            return setErrno(EINVAL);
+
+        bool block = !(fcntl(fd, F_GETFL) & O_NONBLOCK);
+        while (node->doneQueue.empty()) {
+            if (!node->streaming)
+                return setErrno(EINVAL);
+            if (!block)
+                return setErrno(EAGAIN);
+            mDoneCond.wait(lock);
+            // the node may have been closed meanwhile
+            if (findFd(fd) != node)
+                return setErrno(EBADF);
+        }
+
+        uint32_t index = node->doneQueue.front();
+        node->doneQueue.erase(node->doneQueue.begin());
+        Buffer &buffer = node->buffers[index];
+        if (buffer.memfd < 0 && buffer.dmafd >= 0 && buffer.map) {
+            ::munmap(buffer.map, buffer.mapLength);
+            buffer.map = nullptr;
+        }
+        buffer.queued = false;
+        buffer.done = false;
+        fillBuffer(node, index, buf);
+        updateSignal(node);
+        return 0;
+    }
+    case VIDIOC_EXPBUF: {
+        struct v4l2_exportbuffer *exp = (struct v4l2_exportbuffer *)arg;
+        if (exp->type != node->bufType || exp->index >= node->buffers.size() ||
+            exp->plane > 0 || node->buffers[exp->index].memfd < 0)
+            return setErrno(EINVAL);
+        exp->fd = fcntl(node->buffers[exp->index].memfd,
+                        (exp->flags & O_CLOEXEC) ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+        return exp->fd < 0 ? -1 : 0;
+    }
+    case VIDIOC_STREAMON: {
+        if (*(int *)arg != (int)node->bufType || node->buffers.empty())
+            return setErrno(EINVAL);
+        if (node->streaming)
+            return 0;
+
+        node->streaming = true;
+        if (!isCapture(node)) {
+            std::vector<uint32_t> queued;
+            queued.swap(node->queue);
+            for (uint32_t index : queued)
+                completeBuffer(node, index, node->buffers[index].bytesused);
+            return 0;
+        }
+
+        loadSource(node);
+        buildPattern(node);
+        if (!mClockRunning) {
+            if (mClock.joinable())
+                mClock.join();
+            mClockRunning = true;
+            mClock = std::thread(&VirtualKernel::frameClockLoop, this);
+        }
+        return 0;
+    }
+    case VIDIOC_STREAMOFF:
+        if (*(int *)arg != (int)node->bufType)
+            return setErrno(EINVAL);
+        stopStreaming(node);
+        return 0;
+    case VIDIOC_G_PARM:
+    case VIDIOC_S_PARM: {
+        struct v4l2_streamparm *parm = (struct v4l2_streamparm *)arg;
+        if (parm->type != node->bufType)
+            return setErrno(EINVAL);
+        memset(&parm->parm, 0, sizeof(parm->parm));
+        parm->parm.capture.timeperframe.numerator = framePeriodNs() / 1000;
+        parm->parm.capture.timeperframe.denominator = 1000000;
+        return 0;
+    }
+    case VIDIOC_CROPCAP: {
+        struct v4l2_cropcap *cropcap = (struct v4l2_cropcap *)arg;
+        cropcap->bounds.left = cropcap->bounds.top = 0;
+        cropcap->bounds.width = node->width;
+        cropcap->bounds.height = node->height;
+        cropcap->defrect = cropcap->bounds;
+        cropcap->pixelaspect.numerator = cropcap->pixelaspect.denominator = 1;
+        return 0;
+    }
+    case VIDIOC_G_CROP:
+    case VIDIOC_S_CROP: {
+        struct v4l2_crop *crop = (struct v4l2_crop *)arg;
+        uint64_t key = V4L2_SEL_TGT_CROP;
+        if (request == VIDIOC_S_CROP) {
+            node->selections[key] = crop->c;
+        } else if (node->selections.count(key)) {
+            crop->c = node->selections[key];
+        } else {
+            crop->c.left = crop->c.top = 0;
+            crop->c.width = node->width;
+            crop->c.height = node->height;
+        }
+        return 0;
+    }
+    case VIDIOC_G_SELECTION:
+    case VIDIOC_S_SELECTION: {
+        struct v4l2_selection *sel = (struct v4l2_selection *)arg;
+        uint64_t key = sel->target;
+        if (request == VIDIOC_S_SELECTION) {
+            node->selections[key] = sel->r;
+        } else if (node->selections.count(key)) {
+            sel->r = node->selections[key];
+        } else {
+            sel->r.left = sel->r.top = 0;
+            sel->r.width = mWidth;
+            sel->r.height = mHeight;
+        }
+        return 0;
+    }
+    case VIDIOC_ENUM_FRAMESIZES: {
+        struct v4l2_frmsizeenum *size = (struct v4l2_frmsizeenum *)arg;
+        if (size->index > 0 || std::find(node->pixelFormats.begin(), node->pixelFormats.end(),
+                                         size->pixel_format) == node->pixelFormats.end())
+            return setErrno(EINVAL);
+        size->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+        size->stepwise.min_width = kMinWidth;
+        size->stepwise.min_height = kMinHeight;
+        size->stepwise.max_width = mWidth;
+        size->stepwise.max_height = mHeight;
+        size->stepwise.step_width = size->stepwise.step_height = 2;
+        return 0;
+    }
+    case VIDIOC_ENUM_FRAMEINTERVALS: {
+        struct v4l2_frmivalenum *ival = (struct v4l2_frmivalenum *)arg;
+        if (ival->index > 0)
+            return setErrno(EINVAL);
+        ival->type = V4L2_FRMIVAL_TYPE_DISCRETE;
+        ival->discrete.numerator = framePeriodNs() / 1000;
+        ival->discrete.denominator = 1000000;
+        return 0;
+    }
+    case VIDIOC_SUBSCRIBE_EVENT:
+    case VIDIOC_UNSUBSCRIBE_EVENT:
+        return 0;
+    case VIDIOC_DQEVENT:
+        return setErrno(ENOENT);
+    default:
+        return controlIoctl(node, request, arg);
+    }
+}
+
+/**
+ * Maps "<source dir>/<entity name>.yuv" when it holds at least one frame of
+ * the current format, frames are played back in a loop.
+ */
+void VirtualKernel::loadSource(Node *node)
+{
+    if (node->source) {
+        ::munmap(node->source, node->sourceSize);
+        node->source = nullptr;
+        node->sourceSize = 0;
+    }
+    if (mSourceDir.empty())
+        return;
+
+    std::string path = mSourceDir + "/" + node->name + ".yuv";
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && (size_t)st.st_size >= node->sizeimage) {
+        void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            node->source = (uint8_t *)data;
+            node->sourceSize = st.st_size;
+            LOGI("@%s: %s plays %zu frames from %s", __FUNCTION__, node->name.c_str(),
+                 node->sourceSize / node->sizeimage, path.c_str());
+        }
+    } else {
+        LOGW("@%s: %s is smaller than one %ux%u frame, using the pattern",
+             __FUNCTION__, path.c_str(), node->width, node->height);
+    }
+    ::close(fd);
+}
+
+void VirtualKernel::buildPattern(Node *node)
+{
+    if (node->pattern.size() == node->sizeimage && !node->pattern.empty())
+        return;
+
+    node->pattern.assign(node->sizeimage, 0);
+    uint8_t *data = node->pattern.data();
+    uint32_t w = node->width, h = node->height, bpl = node->bytesperline;
+    if (w == 0 || h == 0)
+        return;
+
+    bool vu = node->pixelFormat == V4L2_PIX_FMT_NV21;
+    for (uint32_t y = 0; y < h; y++) {
+        uint8_t *row = data + y * bpl;
+        for (uint32_t x = 0; x < w; x++) {
+            const uint8_t *bar = kBars[x * 8 / w];
+            switch (node->pixelFormat) {
+            case V4L2_PIX_FMT_NV12:
+            case V4L2_PIX_FMT_NV21:
+            case V4L2_PIX_FMT_NV16: {
+                row[x] = bar[0];
+                bool chromaRow = node->pixelFormat == V4L2_PIX_FMT_NV16 || !(y & 1);
+                if (chromaRow && !(x & 1)) {
+                    uint32_t cy = node->pixelFormat == V4L2_PIX_FMT_NV16 ? y : y / 2;
+                    uint8_t *uv = data + bpl * h + cy * bpl + x;
+                    uv[0] = bar[vu ? 2 : 1];
+                    uv[1] = bar[vu ? 1 : 2];
+                }
+                break;
+            }
+            case V4L2_PIX_FMT_YUYV:
+                row[2 * x] = bar[0];
+                row[2 * x + 1] = bar[(x & 1) ? 2 : 1];
+                break;
+            case V4L2_PIX_FMT_SBGGR10:
+                ((uint16_t *)row)[x] = bar[0] << 2;
+                break;
+            default:
+                row[x] = bar[0];
+                break;
+            }
+        }
+    }
+}
+
+/* called with mLock held, the buffer cannot go away meanwhile */
+void VirtualKernel::renderFrame(Node *node, Buffer &buffer)
+{
+    if (buffer.map == nullptr)
+        return;
+
+    size_t size = std::min(buffer.mapLength, node->sizeimage);
+    if (node->source) {
+        size_t frames = node->sourceSize / node->sizeimage;
+        memcpy(buffer.map, node->source + (mSequence % frames) * node->sizeimage, size);
+        return;
+    }
+
+    memcpy(buffer.map, node->pattern.data(), std::min(size, node->pattern.size()));
+    if (node->width == 0 || node->height < 32 || node->pixelFormat == V4L2_PIX_FMT_SBGGR10 ||
+        node->pixelFormat == V4L2_PIX_FMT_SBGGR8)
+        return;
+
+    // a block moving across the top rows tells frames apart
+    uint32_t step = node->pixelFormat == V4L2_PIX_FMT_YUYV ? 2 : 1;
+    uint32_t x0 = (mSequence * 16) % (node->width - 32);
+    for (uint32_t y = 0; y < 32; y++) {
+        uint8_t *row = (uint8_t *)buffer.map + y * node->bytesperline;
+        for (uint32_t x = x0; x < x0 + 32; x++)
+            row[x * step] = 255 - row[x * step];
+    }
+}
+
+int64_t VirtualKernel::framePeriodNs()
+{
+    int64_t lineLength = mWidth, frameLength = mHeight, pixelRate = 0;
+    for (auto &ctrl : mSensor->controls) {
+        if (ctrl.id == V4L2_CID_HBLANK)
+            lineLength += ctrl.value;
+        else if (ctrl.id == V4L2_CID_VBLANK)
+            frameLength += ctrl.value;
+        else if (ctrl.id == V4L2_CID_PIXEL_RATE)
+            pixelRate = ctrl.value;
+    }
+    if (pixelRate <= 0)
+        return kMinFramePeriodNs;
+    return std::max(kMinFramePeriodNs, lineLength * frameLength * (int64_t)1000000000 / pixelRate);
+}
+
+void VirtualKernel::frameClockLoop()
+{
+    prctl(PR_SET_NAME, (unsigned long)"VirtualFrameClock", 0, 0, 0);
+
+    std::unique_lock<std::mutex> l(mLock);
+    auto next = std::chrono::steady_clock::now() + std::chrono::nanoseconds(framePeriodNs());
+    while (true) {
+        bool streaming = false;
+        for (auto &node : mNodes) {
+            if (node->kind == NODE_VIDEO && isCapture(node.get()) && node->streaming)
+                streaming = true;
+        }
+        if (!streaming)
+            break;
+
+        if (mClockCond.wait_until(l, next) != std::cv_status::timeout)
+            continue;
+
+        // every streaming path sees the same sensor frame, like the isp outputs do
+        mSequence++;
+        for (auto &node : mNodes) {
+            if (node->kind != NODE_VIDEO || !isCapture(node.get()) ||
+                !node->streaming || node->queue.empty())
+                continue;
+            uint32_t index = node->queue.front();
+            node->queue.erase(node->queue.begin());
+            renderFrame(node.get(), node->buffers[index]);
+            completeBuffer(node.get(), index, node->sizeimage);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        next += std::chrono::nanoseconds(framePeriodNs());
+        if (next < now)
+            next = now + std::chrono::nanoseconds(framePeriodNs());
+    }
+    mClockRunning = false;
+}
+
+} NAMESPACE_DECLARATION_END
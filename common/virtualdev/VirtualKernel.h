@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CAMERA3_HAL_VIRTUAL_KERNEL_H_
+#define _CAMERA3_HAL_VIRTUAL_KERNEL_H_
+
+#include <linux/media.h>
+#include <linux/videodev2.h>
+#include <linux/v4l2-subdev.h>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "UtilityMacros.h"
+#include "SysCall.h"
+
+NAMESPACE_DECLARATION {
+/**
+ * \class VirtualKernel
+ *
+ * In-process stand-in for the rkisp1 kernel drivers, installed as the
+ * SysCall backend so the whole HAL can run without camera hardware.
+ *
+ * It publishes one media device with a sensor, the mipi dphy, the isp
+ * subdev and the mainpath, selfpath, rawpath, statistics and params video
+ * nodes, under the usual /dev and /sys/dev/char names. Every open returns
+ * a real eventfd, so the HAL polls virtual and real descriptors alike.
+ *
+ * While a capture node streams, a frame clock completes one queued buffer
+ * per node at the sensor frame rate (derived from VBLANK and the frame
+ * interval like a real sensor). Frames come from "<source>/<node>.yuv"
+ * when such a file holds whole frames of the negotiated format, and from
+ * a synthetic pattern otherwise. Queued params buffers complete at once.
+ *
+ * Only built into eng and userdebug builds (CAMERA_VIRTUAL_KERNEL). There
+ * it is enabled with vendor.camera.virtual=1 (the properties don't
+ * persist across reboots), then configured by
+ *  vendor.camera.virtual.sensor  sensor name, default ov5695
+ *  vendor.camera.virtual.size    sensor output, default 2592x1944
+ *  vendor.camera.virtual.fps     default frame rate, default 30
+ *  vendor.camera.virtual.source  directory of frame files
+ *
+ * Vendor code that opens the devices itself (the 3A control loop) still
+ * needs real nodes or a stub of its own. Like the rest of the HAL this
+ * runs on an Android device, there is no host build.
+ */
+class VirtualKernel : public SysCallBackend {
+public:
+    /* installs the backend when enabled by the properties, once */
+    static void setup();
+
+    VirtualKernel(const std::string &sensorName, int width, int height,
+                  int fps, const std::string &sourceDir);
+    virtual ~VirtualKernel();
+
+    virtual int open(const char *pathname, int flags);
+    virtual int close(int fd);
+    virtual int ioctl(int fd, int request, void *arg);
+    virtual void *mmap(void *addr, size_t length, int prot, int flags,
+                       int fd, off_t offset);
+    virtual int stat(const char *pathname, struct stat *st);
+    virtual ssize_t readlink(const char *pathname, char *buf, size_t bufsiz);
+    virtual int listDir(const char *dirname, std::vector<std::string> &names);
+
+private:
+    enum NodeKind {
+        NODE_MEDIA,
+        NODE_SUBDEV,
+        NODE_VIDEO,
+    };
+
+    struct Control {
+        uint32_t id;
+        uint32_t type;
+        const char *name;
+        int64_t min;
+        int64_t max;
+        int64_t def;
+        int64_t value;
+        uint32_t flags;
+    };
+
+    struct Buffer {
+        int memfd;              /*!< backing memory of MMAP buffers */
+        uint32_t offset;        /*!< MMAP cookie */
+        uint32_t length;
+        bool queued;
+        bool done;
+        unsigned long userptr;
+        int dmafd;
+        void *map;              /*!< CPU view while queued */
+        uint32_t mapLength;
+        uint32_t bytesused;
+        uint32_t sequence;
+        struct timeval timestamp;
+    };
+
+    struct Node {
+        NodeKind kind;
+        std::string name;       /*!< media entity name */
+        std::string devName;    /*!< name under /dev */
+        uint32_t entityId;
+        uint32_t entityType;
+        uint32_t minor;
+        std::vector<uint32_t> padFlags;
+        std::vector<int> fds;
+
+        /* subdevs */
+        std::map<uint32_t, v4l2_mbus_framefmt> padFormats;
+        std::map<uint64_t, v4l2_rect> selections;
+        std::vector<Control> controls;
+
+        /* video nodes */
+        uint32_t bufType;
+        std::vector<uint32_t> pixelFormats;
+        uint32_t pixelFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytesperline;
+        uint32_t sizeimage;
+        uint32_t memory;
+        std::vector<Buffer> buffers;
+        std::vector<uint32_t> queue;    /*!< indices in the device */
+        std::vector<uint32_t> doneQueue;
+        bool streaming;
+        bool signaled;
+        std::vector<uint8_t> pattern;   /*!< synthetic frame of the format */
+        uint8_t *source;                /*!< mapped frame file */
+        size_t sourceSize;
+    };
+
+    struct Link {
+        Node *source;
+        uint16_t sourcePad;
+        Node *sink;
+        uint16_t sinkPad;
+        uint32_t flags;
+    };
+
+private:
+    Node *addNode(NodeKind kind, const std::string &name,
+                  const std::string &devName, uint32_t type, int pads);
+    void addLink(Node *source, uint16_t sourcePad, Node *sink,
+                 uint16_t sinkPad, uint32_t flags);
+    void addSensorControls(Node *sensor);
+    Node *findPath(const char *pathname);
+    Node *findFd(int fd);
+    Node *findEntity(uint32_t id);
+    bool ownsPath(const char *pathname);
+
+    int mediaIoctl(Node *node, unsigned long request, void *arg);
+    int subdevIoctl(Node *node, unsigned long request, void *arg);
+    int videoIoctl(Node *node, int fd, unsigned long request, void *arg,
+                   std::unique_lock<std::mutex> &lock);
+    int controlIoctl(Node *node, unsigned long request, void *arg);
+
+    bool isMplane(const Node *node) const;
+    bool isCapture(const Node *node) const;
+    void applyFormat(Node *node, uint32_t pixelFormat, uint32_t width,
+                     uint32_t height);
+    void getFormat(const Node *node, struct v4l2_format *fmt) const;
+    int requestBuffers(Node *node, struct v4l2_requestbuffers *req);
+    void freeBuffers(Node *node);
+    void fillBuffer(const Node *node, uint32_t index, struct v4l2_buffer *buf) const;
+    int queueBuffer(Node *node, struct v4l2_buffer *buf);
+    void completeBuffer(Node *node, uint32_t index, uint32_t bytesused);
+    void stopStreaming(Node *node);
+    void updateSignal(Node *node);
+
+    void loadSource(Node *node);
+    void buildPattern(Node *node);
+    void renderFrame(Node *node, Buffer &buffer);
+    int64_t framePeriodNs();
+    void frameClockLoop();
+
+private:
+    std::string mSensorName;
+    int mWidth;
+    int mHeight;
+    std::string mSourceDir;
+
+    std::mutex mLock;               /*!< protects everything below */
+    std::condition_variable mDoneCond;
+    std::vector<std::unique_ptr<Node>> mNodes;
+    std::vector<Link> mLinks;
+    std::map<int, Node*> mFds;
+    Node *mSensor;
+    uint32_t mSequence;
+
+    std::thread mClock;
+    bool mClockRunning;
+    std::condition_variable mClockCond;
+};
+
+} NAMESPACE_DECLARATION_END
+#endif // _CAMERA3_HAL_VIRTUAL_KERNEL_H_
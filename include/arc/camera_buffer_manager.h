@@ -215,6 +215,17 @@ class EXPORTED CameraBufferManager {
   //    0 on success; -EINVAL on invalid buffer handle.
   virtual int FlushCache(buffer_handle_t buffer) = 0;
 
+  // This method is used to invalidate cache.
+  // The counterpart of |FlushCache|: it should be called before the cpu
+  // accesses a buffer that stayed mapped while a device wrote to it.
+  //
+  // Args:
+  //    |buffer|: The buffer handle to invalidate.
+  //
+  // Returns:
+  //    0 on success; -EINVAL on invalid buffer handle.
+  virtual int InvalidateCache(buffer_handle_t buffer) = 0;
+
   // This method is used to get handle fd.
   //
   // Args:
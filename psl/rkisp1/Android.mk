@@ -21,6 +21,8 @@ PSLSRC = \
     psl/rkisp1/RKISP1CameraHw.cpp \
     psl/rkisp1/HwStreamBase.cpp \
     psl/rkisp1/CameraBuffer.cpp \
+    psl/rkisp1/InternalBufferPool.cpp \
+    psl/rkisp1/BufferMappingCache.cpp \
     psl/rkisp1/ControlUnit.cpp \
     psl/rkisp1/ImguUnit.cpp \
     psl/rkisp1/SettingsProcessor.cpp \
@@ -35,6 +37,7 @@ PSLSRC = \
     psl/rkisp1/workers/OutputFrameWorker.cpp \
     psl/rkisp1/workers/InputFrameWorker.cpp \
     psl/rkisp1/workers/PostProcessPipeline.cpp \
+    psl/rkisp1/workers/ZslFrameRing.cpp \
     psl/rkisp1/MediaCtlHelper.cpp \
     common/platformdata/gc/FormatUtils.cpp \
     psl/rkisp1/NodeTypes.cpp \
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferMappingCache"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include "LogHelper.h"
+#include "BufferMappingCache.h"
+#include "arc/camera_buffer_manager.h"
+
+namespace android {
+namespace camera2 {
+
+const size_t BufferMappingCache::kMaxEntries;
+
+/* dup of the fds and copy of the ints, like a handle received over binder */
+static native_handle_t* cloneHandle(buffer_handle_t handle)
+{
+    native_handle_t *clone = native_handle_create(handle->numFds, handle->numInts);
+    if (clone == nullptr)
+        return nullptr;
+
+    for (int i = 0; i < handle->numFds; i++) {
+        clone->data[i] = dup(handle->data[i]);
+        if (clone->data[i] < 0) {
+            LOGE("@%s: dup failed: %s", __FUNCTION__, strerror(errno));
+            clone->numFds = i;
+            native_handle_close(clone);
+            native_handle_delete(clone);
+            return nullptr;
+        }
+    }
+    memcpy(&clone->data[handle->numFds], &handle->data[handle->numFds],
+           sizeof(int) * handle->numInts);
+    return clone;
+}
+
+/* dma-bufs got an inode each in Linux 5.3, they share one before */
+static bool kernelHasBufferInodes()
+{
+    struct utsname name;
+    int major = 0, minor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2) {
+        LOGW("@%s: unknown kernel version, buffer mapping cache off", __FUNCTION__);
+        return false;
+    }
+
+    bool supported = major > 5 || (major == 5 && minor >= 3);
+    if (!supported)
+        LOGI("@%s: kernel %s, buffer mapping cache off", __FUNCTION__, name.release);
+    return supported;
+}
+
+bool BufferMappingCache::isSupported()
+{
+    static const bool supported = kernelHasBufferInodes();
+    return supported;
+}
+
+BufferMappingCache::BufferMappingCache() :
+    mUseCount(0)
+{
+}
+
+BufferMappingCache::~BufferMappingCache()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    for (auto &it : mEntries) {
+        if (it.second.users)
+            LOGW("@%s: buffer %p still in use", __FUNCTION__, it.first);
+        freeEntry(it.second);
+    }
+    mEntries.clear();
+}
+
+bool BufferMappingCache::handleIdentity(buffer_handle_t handle, Identity *identity)
+{
+    if (handle->numFds < 1 || handle->numInts < 0)
+        return false;
+
+    identity->files.resize(handle->numFds);
+    for (int i = 0; i < handle->numFds; i++) {
+        struct stat st;
+        if (fstat(handle->data[i], &st) != 0)
+            return false;
+        identity->files[i] = std::make_pair(st.st_dev, st.st_ino);
+    }
+    identity->ints.assign(&handle->data[handle->numFds],
+                          &handle->data[handle->numFds + handle->numInts]);
+    return true;
+}
+
+buffer_handle_t BufferMappingCache::acquire(buffer_handle_t handle)
+{
+    Identity identity;
+    if (handle == nullptr || !isSupported() || !handleIdentity(handle, &identity))
+        return nullptr;
+
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = mEntries.find(handle);
+    if (it != mEntries.end()) {
+        Entry &entry = it->second;
+        if (entry.identity == identity && !entry.stale) {
+            entry.users++;
+            entry.lastUse = ++mUseCount;
+            return entry.clone;
+        }
+        // the framework handle now stands for another buffer
+        LOGI("@%s: buffer %p was replaced", __FUNCTION__, handle);
+        if (entry.users) {
+            entry.stale = true;
+            // keep it reachable for release() under another key
+            Entry old = entry;
+            mEntries.erase(it);
+            mEntries[old.clone] = old;
+        } else {
+            freeEntry(entry);
+            mEntries.erase(it);
+        }
+    }
+
+    if (mEntries.size() >= kMaxEntries)
+        evictLocked();
+
+    native_handle_t *clone = cloneHandle(handle);
+    if (clone == nullptr)
+        return nullptr;
+
+    arc::CameraBufferManager *bufManager = arc::CameraBufferManager::GetInstance();
+    int ret = bufManager->Register(clone);
+    if (ret) {
+        LOGE("@%s: call Register fail, handle:%p, ret:%d", __FUNCTION__, handle, ret);
+        native_handle_close(clone);
+        native_handle_delete(clone);
+        return nullptr;
+    }
+
+    Entry &entry = mEntries[handle];
+    entry.clone = clone;
+    entry.identity = identity;
+    entry.data = nullptr;
+    entry.size = 0;
+    entry.users = 1;
+    entry.stale = false;
+    entry.lastUse = ++mUseCount;
+    LOGI("@%s: imported buffer %p as %p, %zu cached", __FUNCTION__, handle, clone,
+         mEntries.size());
+    return clone;
+}
+
+void BufferMappingCache::release(buffer_handle_t clone)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = findClone(clone);
+    if (it == mEntries.end()) {
+        LOGW("@%s: unknown buffer %p", __FUNCTION__, clone);
+        return;
+    }
+
+    Entry &entry = it->second;
+    if (entry.users)
+        entry.users--;
+    if (entry.stale && entry.users == 0) {
+        freeEntry(entry);
+        mEntries.erase(it);
+    }
+}
+
+bool BufferMappingCache::getMapping(buffer_handle_t clone, void **data,
+                                    unsigned int *size)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = findClone(clone);
+    if (it == mEntries.end() || it->second.data == nullptr)
+        return false;
+
+    *data = it->second.data;
+    *size = it->second.size;
+    return true;
+}
+
+void BufferMappingCache::setMapping(buffer_handle_t clone, void *data,
+                                    unsigned int size)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = findClone(clone);
+    if (it == mEntries.end())
+        return;
+
+    it->second.data = data;
+    it->second.size = size;
+}
+
+void BufferMappingCache::clear()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = mEntries.begin();
+    while (it != mEntries.end()) {
+        if (it->second.users) {
+            it->second.stale = true;
+            ++it;
+        } else {
+            freeEntry(it->second);
+            it = mEntries.erase(it);
+        }
+    }
+}
+
+BufferMappingCache::EntryMap::iterator
+BufferMappingCache::findClone(buffer_handle_t clone)
+{
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->second.clone == clone)
+            return it;
+    }
+    return mEntries.end();
+}
+
+/* drops the least recently used entry that is not in use */
+void BufferMappingCache::evictLocked()
+{
+    auto victim = mEntries.end();
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->second.users == 0 &&
+            (victim == mEntries.end() || it->second.lastUse < victim->second.lastUse))
+            victim = it;
+    }
+    if (victim == mEntries.end())
+        return;
+
+    freeEntry(victim->second);
+    mEntries.erase(victim);
+}
+
+void BufferMappingCache::freeEntry(Entry &entry)
+{
+    arc::CameraBufferManager *bufManager = arc::CameraBufferManager::GetInstance();
+    if (entry.data != nullptr && bufManager->Unlock(entry.clone))
+        LOGW("@%s: call Unlock fail, buffer:%p", __FUNCTION__, entry.clone);
+    if (bufManager->Deregister(entry.clone))
+        LOGW("@%s: call Deregister fail, buffer:%p", __FUNCTION__, entry.clone);
+
+    native_handle_close(entry.clone);
+    native_handle_delete(entry.clone);
+    entry.clone = nullptr;
+    entry.data = nullptr;
+}
+
+} /* namespace camera2 */
+} /* namespace android */
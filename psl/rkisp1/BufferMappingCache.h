@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PSL_RKISP1_BUFFERMAPPINGCACHE_H_
+#define PSL_RKISP1_BUFFERMAPPINGCACHE_H_
+
+#include <sys/types.h>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <cutils/native_handle.h>
+
+namespace android {
+namespace camera2 {
+
+/**
+ * \class BufferMappingCache
+ *
+ * Per-stream cache of the gralloc registrations and CPU mappings of the
+ * framework buffers.
+ *
+ * The framework cycles the same few buffers of a stream for the whole
+ * session, so instead of registering, locking, unlocking and deregistering
+ * a buffer for every request, the first request imports it and the mapping
+ * is kept until the stream is reconfigured or deleted. Unlocking a cached
+ * buffer only flushes the CPU caches.
+ *
+ * What is registered and mapped is a clone of the framework handle owned
+ * by the cache, so entries can be released whenever convenient, even after
+ * the framework has freed its own handle. Entries are keyed by the
+ * framework handle and checked against the dma-buf behind it: a handle
+ * freed and reallocated at the same address is imported again.
+ *
+ * Thread safe.
+ */
+class BufferMappingCache {
+public:
+    BufferMappingCache();
+    ~BufferMappingCache();
+
+    /**
+     * Returns the registered clone of |handle|, importing it the first time
+     * it is seen. nullptr if the buffer cannot be cached, the caller then
+     * registers |handle| itself.
+     */
+    buffer_handle_t acquire(buffer_handle_t handle);
+    /* the caller is done with a clone returned by acquire() */
+    void release(buffer_handle_t clone);
+
+    /* CPU mapping of |clone| made by an earlier lock, false if none */
+    bool getMapping(buffer_handle_t clone, void **data, unsigned int *size);
+    void setMapping(buffer_handle_t clone, void *data, unsigned int size);
+
+    /* releases every entry, those in use once they are released */
+    void clear();
+
+    /* false on kernels where dma-bufs do not have inodes of their own */
+    static bool isSupported();
+
+private:
+    /* what the framework handle refers to, compared on every acquire */
+    struct Identity {
+        std::vector<std::pair<dev_t, ino_t>> files;
+        std::vector<int> ints;
+
+        bool operator==(const Identity &other) const {
+            return files == other.files && ints == other.ints;
+        }
+    };
+
+    struct Entry {
+        native_handle_t *clone;
+        Identity identity;
+        void *data;             /*!< CPU mapping, nullptr until locked */
+        unsigned int size;
+        unsigned int users;     /*!< acquires not released yet */
+        bool stale;             /*!< drop on the last release */
+        unsigned long lastUse;
+    };
+    typedef std::map<buffer_handle_t, Entry> EntryMap;
+
+    static bool handleIdentity(buffer_handle_t handle, Identity *identity);
+    EntryMap::iterator findClone(buffer_handle_t clone);
+    void evictLocked();
+    void freeEntry(Entry &entry);
+
+private:
+    /* more than a stream ever has, the framework may replace buffers */
+    static const size_t kMaxEntries = 16;
+
+    std::mutex mLock;   /*!< protects mEntries and mUseCount */
+    EntryMap mEntries;  /*!< keyed by the framework handle */
+    unsigned long mUseCount;
+};
+
+} /* namespace camera2 */
+} /* namespace android */
+
+#endif  // PSL_RKISP1_BUFFERMAPPINGCACHE_H_
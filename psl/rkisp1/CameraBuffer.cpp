@@ -20,14 +20,18 @@
 #include <sys/mman.h>
 #include "PlatformData.h"
 #include "CameraBuffer.h"
+#include "SysCall.h"
 #include "CameraStream.h"
 #include "Camera3GFXFormat.h"
+#include "InternalBufferPool.h"
 #include <unistd.h>
 #include <sync/sync.h>
 
 #include <sys/types.h>
 #include <dirent.h>
 #include <algorithm>
+#include <map>
+#include <mutex>
 
 namespace android {
 namespace camera2 {
@@ -186,7 +190,7 @@ CameraBuffer::CameraBuffer(int w, int h, int s, int fd, int dmaBufFd, int length
     mUserBuffer.release_fence = -1;
     mUserBuffer.acquire_fence = -1;
 
-    mDataPtr = mmap(nullptr, length, prot, flags, fd, offset);
+    mDataPtr = SysCall::mmap(nullptr, length, prot, flags, fd, offset);
     if (CC_UNLIKELY(mDataPtr == MAP_FAILED)) {
         LOGE("Failed to MMAP the buffer %s", strerror(errno));
         mDataPtr = nullptr;
@@ -204,6 +208,10 @@ CameraBuffer::CameraBuffer(int w, int h, int s, int fd, int dmaBufFd, int length
  */
 status_t CameraBuffer::init(const camera3_stream_buffer *aBuffer, int cameraId)
 {
+    // give back a cached buffer whose request never completed
+    if (mMappingCache.get() != nullptr)
+        deregisterBuffer();
+
     mType = BUF_TYPE_HANDLE;
     mGbmBufferManager = arc::CameraBufferManager::GetInstance();
     mHandle = *aBuffer->buffer;
@@ -218,6 +226,7 @@ status_t CameraBuffer::init(const camera3_stream_buffer *aBuffer, int cameraId)
     mLocked = false;
     mOwner = static_cast<CameraStream*>(aBuffer->stream->priv);
     mUsage = mOwner->usage();
+    mMappingCache = mOwner->mappingCache();
     mInit = true;
     mDataPtr = nullptr;
     mUserBuffer = *aBuffer;
@@ -372,6 +381,17 @@ status_t CameraBuffer::getFence(camera3_stream_buffer* buf)
 
 status_t CameraBuffer::registerBuffer()
 {
+    if (mMappingCache.get() != nullptr) {
+        buffer_handle_t clone = mMappingCache->acquire(mHandle);
+        if (clone != nullptr) {
+            mHandle = clone;
+            mRegistered = true;
+            return NO_ERROR;
+        }
+        LOGW("@%s: buffer %p not cacheable, registering it", __FUNCTION__, mHandle);
+        mMappingCache.reset();
+    }
+
     int ret = mGbmBufferManager->Register(mHandle);
     if (ret) {
         LOGE("@%s: call Register fail, mHandle:%p, ret:%d", __FUNCTION__, mHandle, ret);
@@ -384,6 +404,14 @@ status_t CameraBuffer::registerBuffer()
 
 status_t CameraBuffer::deregisterBuffer()
 {
+    if (mRegistered && mMappingCache.get() != nullptr) {
+        // the cache keeps the registration for the next request
+        mMappingCache->release(mHandle);
+        mMappingCache.reset();
+        mRegistered = false;
+        return NO_ERROR;
+    }
+
     if (mRegistered) {
         int ret = mGbmBufferManager->Deregister(mHandle);
         if (ret) {
@@ -409,6 +437,17 @@ status_t CameraBuffer::lock(int flags)
     mDataPtr = nullptr;
     mSize = 0;
     int ret = 0;
+
+    if (mMappingCache.get() != nullptr &&
+        mMappingCache->getMapping(mHandle, &mDataPtr, &mSize)) {
+        // the device may have written it since, paired with the
+        // FlushCache() in unlock()
+        if (mGbmBufferManager->InvalidateCache(mHandle))
+            LOGW("@%s: call InvalidateCache fail, mHandle:%p", __FUNCTION__, mHandle);
+        mLocked = true;
+        return NO_ERROR;
+    }
+
     uint32_t planeNum = mGbmBufferManager->GetNumPlanes(mHandle);
     LOGI("@%s, planeNum:%d, mHandle:%p, mFormat:%d", __FUNCTION__, planeNum, mHandle, mFormat);
 
@@ -448,6 +487,10 @@ status_t CameraBuffer::lock(int flags)
         return UNKNOWN_ERROR;
     }
 
+    // stays mapped until the cache drops the buffer
+    if (mMappingCache.get() != nullptr)
+        mMappingCache->setMapping(mHandle, mDataPtr, mSize);
+
     mLocked = true;
 
     return NO_ERROR;
@@ -498,6 +541,14 @@ status_t CameraBuffer::unlock()
          return NO_ERROR;
     }
 
+    if (mLocked && mMappingCache.get() != nullptr) {
+        // keep the mapping, only write the CPU caches back
+        if (mGbmBufferManager->FlushCache(mHandle))
+            LOGW("@%s: call FlushCache fail, mHandle:%p", __FUNCTION__, mHandle);
+        mLocked = false;
+        return NO_ERROR;
+    }
+
     if (mLocked) {
         LOGI("@%s, mHandle:%p, mFormat:%d", __FUNCTION__, mHandle, mFormat);
         int ret = mGbmBufferManager->Unlock(mHandle);
@@ -719,90 +770,84 @@ allocateHandleBuffer(int w,
     return buffer;
 }
 
-#define MAX_CAMERA_INSTANCES 2
-// preAllocate buffer pool
-SharedItemPool<CameraBuffer> *PreAllocateBufferPool[MAX_CAMERA_INSTANCES];
-
-status_t
-creatHandlerBufferPool(int cameraId,
-                       int w,
-                       int h,
-                       int gfxFmt,
-                       int usage,
-                       int nums)
+/*
+ * Internal buffer pools, one per camera, created on first use.
+ */
+static std::mutex sBufferPoolsLock;
+static std::map<int, std::shared_ptr<InternalBufferPool>> sBufferPools;
+
+static const int kInternalBufferUsage =
+        GRALLOC_USAGE_SW_READ_OFTEN |
+        GRALLOC_USAGE_HW_CAMERA_WRITE|
+        /* TODO: same as the temp solution in RKISP1CameraHw.cpp configStreams func
+         * add GRALLOC_USAGE_HW_VIDEO_ENCODER is a temp patch for gpu bug:
+         * gpu cant alloc a nv12 buffer when format is
+         * HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED. Need gpu provide a patch */
+        GRALLOC_USAGE_HW_VIDEO_ENCODER;
+
+static std::shared_ptr<InternalBufferPool> getBufferPool(int cameraId, bool create)
 {
-    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
-    PERFORMANCE_ATRACE_NAME_SNPRINTF("PreBufPool %dx%d %d", w, h, nums);
-    arc::CameraBufferManager* bufManager = arc::CameraBufferManager::GetInstance();
-    buffer_handle_t handle;
-    status_t ret;
-    uint32_t stride = 0;
+    std::lock_guard<std::mutex> l(sBufferPoolsLock);
+    auto it = sBufferPools.find(cameraId);
+    if (it != sBufferPools.end())
+        return it->second;
+    if (!create)
+        return nullptr;
 
-    CheckError(cameraId >= MAX_CAMERA_INSTANCES, UNKNOWN_ERROR,
-               "@%s,  invaild cameraId: %d", __FUNCTION__, cameraId);
-
-    char BufPoolName[64];
-    snprintf(BufPoolName, 64, "%s-%d", "PreAllocateBufferPool", cameraId);
-    PreAllocateBufferPool[cameraId] = new SharedItemPool<CameraBuffer>(BufPoolName);
-    PreAllocateBufferPool[cameraId]->init(nums);
-
-    LOGI("%s, [wxh] = [%dx%d], format 0x%x, usage 0x%x, nums %d",
-          __FUNCTION__, w, h, gfxFmt, usage, nums);
-    for (int i = 0; i < nums; ++i) {
-        ret = bufManager->Allocate(w, h, gfxFmt, usage, arc::GRALLOC, &handle, &stride);
-        if (ret != 0) {
-            LOGE("Allocate handle failed! %d", ret);
-            return ret;
-        }
-        std::shared_ptr<CameraBuffer> buffer = nullptr;
-        PreAllocateBufferPool[cameraId]->acquireItem(buffer);
+    std::shared_ptr<InternalBufferPool> pool = InternalBufferPool::create(cameraId);
+    if (pool.get() != nullptr)
+        sBufferPools[cameraId] = pool;
+    return pool;
+}
 
-        camera3_stream_t stream;
-        CLEAR(stream);
-        stream.width = w;
-        stream.height = h;
-        stream.format = gfxFmt;
-        stream.usage = usage;
-        ret = buffer->init(&stream, handle);
+void destroyHandleBufferPool(int cameraId) {
+    LOGD("@%s : cameraId:%d", __FUNCTION__, cameraId);
+    std::shared_ptr<InternalBufferPool> pool;
+    {
+        std::lock_guard<std::mutex> l(sBufferPoolsLock);
+        auto it = sBufferPools.find(cameraId);
+        if (it == sBufferPools.end())
+            return;
+        pool = it->second;
+        sBufferPools.erase(it);
     }
+    // the pool and its refill thread go away with the last reference
+    pool.reset();
+}
+
+status_t reserveInternalBuffers(int cameraId, int w, int h, int nums)
+{
+    std::shared_ptr<InternalBufferPool> pool = getBufferPool(cameraId, true);
+    CheckError(pool.get() == nullptr, UNKNOWN_ERROR,
+               "@%s, failed to create buffer pool for camera %d", __FUNCTION__, cameraId);
 
-    return ret;
+    return pool->addBucket(w, h, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                           kInternalBufferUsage, nums);
 }
 
-void destroyHandleBufferPool(int cameraId) {
-    LOGD("@%s : cameraId:%d", __FUNCTION__, cameraId);
-    CheckError(cameraId >= MAX_CAMERA_INSTANCES, ,
-               "@%s,  invaild cameraId: %d", __FUNCTION__, cameraId);
-    if (PreAllocateBufferPool[cameraId])
-        delete PreAllocateBufferPool[cameraId];
-    PreAllocateBufferPool[cameraId] = NULL;
+void clearInternalBufferReservations(int cameraId)
+{
+    std::shared_ptr<InternalBufferPool> pool = getBufferPool(cameraId, false);
+    if (pool.get() != nullptr)
+        pool->clearReservations();
 }
 
 std::shared_ptr<CameraBuffer> acquireOneBuffer(int cameraId, int w, int h, bool allocate) {
-    status_t ret;
     std::shared_ptr<CameraBuffer> buffer = nullptr;
+    std::shared_ptr<InternalBufferPool> pool = getBufferPool(cameraId, true);
 
-    PreAllocateBufferPool[cameraId]->acquireItem(buffer);
-    if(allocate && buffer.get() == nullptr) {
-        buffer = MemoryUtils::allocateHandleBuffer(w, h, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
-                                                   GRALLOC_USAGE_SW_READ_OFTEN |
-                                                   GRALLOC_USAGE_HW_CAMERA_WRITE|
-                                                   /* TODO: same as the temp solution in RKISP1CameraHw.cpp configStreams func
-                                                    * add GRALLOC_USAGE_HW_VIDEO_ENCODER is a temp patch for gpu bug:
-                                                    * gpu cant alloc a nv12 buffer when format is
-                                                    * HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED. Need gpu provide a patch */
-                                                   GRALLOC_USAGE_HW_VIDEO_ENCODER);
+    if (pool.get() != nullptr)
+        return pool->acquire(w, h, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                             kInternalBufferUsage, allocate);
 
+    if (allocate) {
+        buffer = MemoryUtils::allocateHandleBuffer(w, h, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                                                   kInternalBufferUsage);
         CheckError((buffer.get() == nullptr), nullptr, "@%s : No memeory, failed allocate buffer",
                    __FUNCTION__);
-        LOGW("@%s : shortage of internal buffer, allocate a new one ", __FUNCTION__);
-        return buffer;
+        LOGW("@%s : no internal buffer pool, allocate a new one ", __FUNCTION__);
     }
 
-    // reuse the Camerabuffer, just change the stream width and height
-    if (buffer.get() != nullptr)
-        buffer->reConfig(w, h);
-
     return buffer;
 }
 
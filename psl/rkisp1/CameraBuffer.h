@@ -23,6 +23,7 @@
 #include "UtilityMacros.h"
 #include "arc/camera_buffer_manager.h"
 #include "SyncFence.h"
+#include "BufferMappingCache.h"
 #include <memory>
 
 NAMESPACE_DECLARATION {
@@ -181,6 +182,9 @@ private:
 
     int mCameraId;
     int mDmaBufFd;                    /*!< file descriptor for dmabuf */
+    /*!< holds the registration and mapping of a framework buffer across
+         requests, mHandle is then the clone owned by the cache */
+    std::shared_ptr<BufferMappingCache> mMappingCache;
 };
 
 namespace MemoryUtils {
@@ -199,13 +203,14 @@ allocateHandleBuffer(int w,
                      int gfxFmt,
                      int usage);
 
-status_t creatHandlerBufferPool(int cameraId,
-                                int w,
-                                int h,
-                                int gfxFmt,
-                                int usage,
-                                int nums);
 void destroyHandleBufferPool(int cameraId);
+/*
+ * queues the allocation of internal buffers, returns before it is done;
+ * reservations of the same size add up until cleared
+ */
+status_t reserveInternalBuffers(int cameraId, int w, int h, int nums);
+/* the reserved buffers are released once idle unless reserved again */
+void clearInternalBufferReservations(int cameraId);
 
 std::shared_ptr<CameraBuffer> acquireOneBuffer(int cameraId, int w, int h, bool allocate = true);
 std::shared_ptr<CameraBuffer> acquireOneBufferWithNoCache(int cameraId, int w, int h, bool allocate = true);
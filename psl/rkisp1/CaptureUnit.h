@@ -15,6 +15,7 @@
  * limitations under the License.
  */
 
+#include <CameraMetadata.h>
 #include <memory>
 #include <mutex>
 #include "CaptureUnitSettings.h"
@@ -63,6 +64,8 @@ public:
         struct timeval   timestamp;
         unsigned int     sequence;
         unsigned int     reqId;
+        /* 3A result of a ZSL frame reported instead of the request's own */
+        std::shared_ptr<const CameraMetadata> result;
         CaptureMessageEvent() : type(CAPTURE_EVENT_MAX),
             sequence(0),
             reqId(0)
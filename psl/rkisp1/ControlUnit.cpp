@@ -245,6 +245,7 @@ ControlUnit::ControlUnit(ImguUnit *thePU,
         mSocCamFlashCtrUnit(nullptr),
         mStillCapSyncNeeded(0),
         mStillCapSyncState(STILL_CAP_SYNC_STATE_TO_ENGINE_IDLE),
+        mStillCapDeadline(0),
         mFlushForUseCase(FLUSH_FOR_NOCHANGE)
 {
     cl_result_callback_ops::metadata_result_callback = &sMetadatCb;
@@ -479,6 +480,7 @@ void RequestCtrlState::reset(RequestCtrlState* me)
         me->captureSettings.reset();
         me->processingSettings.reset();
         me->graphConfig.reset();
+        me->mZslResult.reset();
     } else {
         LOGE("Trying to reset a null CtrlState structure !! - BUG ");
     }
@@ -516,6 +518,7 @@ void RequestCtrlState::init(Camera3Request *req,
     mClMetaReceived = false;
     mShutterMetaReceived = false;
     mImgProcessDone = false;
+    mZslResult.reset();
 
     /**
      * Apparently we need to have this tags in the results
@@ -649,6 +652,10 @@ ControlUnit::configStreams(std::vector<camera3_stream_t*> &activeStreams, bool c
         }
     }
 
+    // depends on mEnable3A
+    if (configChanged || mResultSkeleton.isEmpty())
+        buildResultSkeleton();
+
     return NO_ERROR;
 }
 
@@ -751,6 +758,12 @@ ControlUnit::handleNewRequest(Message &msg)
     status_t status = NO_ERROR;
     std::shared_ptr<RequestCtrlState> reqState = msg.state;
 
+    // the 3A engine is still busy with the still capture before this one
+    if (mStillCapParked.get() != nullptr) {
+        mRequestsBehindStillCap.push_back(reqState);
+        return OK;
+    }
+
     /**
      * PHASE 1: Process the settings
      * In this phase we analyze the request's metadata settings and convert them
@@ -885,7 +898,7 @@ ControlUnit::processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqStat
             /* frame_metas.metas = settings->getAndLock(); */
             /* frame_metas.id = reqId; */
 
-            CameraMetadata tempCamMeta = *settings;
+            SettingsOverlay overlay;
 
             camera_metadata_ro_entry entry =
                 settings->find(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER);
@@ -896,31 +909,35 @@ ControlUnit::processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqStat
             }
 
             if(jpegBufCount == 0) {
-                uint8_t intent = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
-                tempCamMeta.update(ANDROID_CONTROL_CAPTURE_INTENT, &intent, 1);
+                overlay.push_back(std::make_pair(ANDROID_CONTROL_CAPTURE_INTENT,
+                                                 ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW));
             } else {
                 if (mStillCapSyncNeeded) {
                     if (mStillCapSyncState == STILL_CAP_SYNC_STATE_TO_ENGINE_IDLE) {
                         LOGD("forcely trigger ae precapture");
-                        uint8_t precap = ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_START;
-                        tempCamMeta.update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &precap, 1);
+                        overlay.push_back(std::make_pair(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER,
+                                                         ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_START));
                         mStillCapSyncState = STILL_CAP_SYNC_STATE_TO_ENGINE_PRECAP;
                     }
                     if (mStillCapSyncState == STILL_CAP_SYNC_STATE_TO_ENGINE_PRECAP) {
-                        uint8_t stillCapSync = RKCAMERA3_PRIVATEDATA_STILLCAP_SYNC_CMD_SYNCSTART;
-                        tempCamMeta.update(RKCAMERA3_PRIVATEDATA_STILLCAP_SYNC_CMD, &stillCapSync, 1);
+                        overlay.push_back(std::make_pair(RKCAMERA3_PRIVATEDATA_STILLCAP_SYNC_CMD,
+                                                         RKCAMERA3_PRIVATEDATA_STILLCAP_SYNC_CMD_SYNCSTART));
                         mStillCapSyncState = STILL_CAP_SYNC_STATE_WAITING_ENGINE_DONE;
                     } else
                         LOGW("already in stillcap_sync state %d",
-                             mStillCapSyncState);
+                             mStillCapSyncState.load());
                 }
             }
 
+            CameraMetadata &clSettings =
+                getClSettings(reqState->request->getSharedSettings(), overlay);
             TuningServer *pserver = TuningServer::GetInstance();
             if (pserver && pserver->isTuningMode()) {
-                pserver->set_tuning_params(tempCamMeta);
+                pserver->set_tuning_params(clSettings);
+                // no longer what the cache says
+                mClSettingsBase.reset();
             }
-            frame_metas.metas = tempCamMeta.getAndLock();
+            frame_metas.metas = clSettings.getAndLock();
             frame_metas.id = reqId;
 
             status = mCtrlLoop->setFrameParams(&frame_metas);
@@ -928,23 +945,20 @@ ControlUnit::processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqStat
                 LOGE("CtrlLoop setFrameParams error");
 
             /* status = settings->unlock(frame_metas.metas); */
-            status = tempCamMeta.unlock(frame_metas.metas);
+            status = clSettings.unlock(frame_metas.metas);
             if (status != OK) {
                 LOGE("unlock frame frame_metas failed");
                 return UNKNOWN_ERROR;
             }
 
-            int max_counts = 500;
-            while (mStillCapSyncState == STILL_CAP_SYNC_STATE_WAITING_ENGINE_DONE &&
-                   max_counts > 0) {
-                LOGD("waiting for stillcap_sync_done");
-                usleep(10*1000);
-                max_counts--;
-            }
-
-            if (max_counts == 0) {
-                mStillCapSyncState = STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE;
-                LOGW("waiting for stillcap_sync_done timeout!");
+            if (mStillCapSyncState == STILL_CAP_SYNC_STATE_WAITING_ENGINE_DONE) {
+                // completed by resumeStillCapture(), the thread keeps
+                // handling shutters and 3A results meanwhile
+                LOGD("waiting for stillcap_sync_done, req id %d", reqId);
+                mStillCapParked = reqState;
+                mStillCapDeadline = systemTime() +
+                                    (nsecs_t)STILL_CAP_SYNC_TIMEOUT_MS * 1000000;
+                return OK;
             }
 
             if (mStillCapSyncState == STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE) {
@@ -952,7 +966,7 @@ ControlUnit::processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqStat
             }
 
             LOGD("%s:%d, stillcap_sync_state %d",
-                 __FUNCTION__, __LINE__, mStillCapSyncState);
+                 __FUNCTION__, __LINE__, mStillCapSyncState.load());
         } else {
             // set SoC sensor's params
             const CameraMetadata *settings = reqState->request->getSettings();
@@ -974,49 +988,17 @@ ControlUnit::processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqStat
     return status;
 }
 
-status_t ControlUnit::fillMetadata(std::shared_ptr<RequestCtrlState> &reqState)
+/**
+ * buildResultSkeleton
+ *
+ * Collects the result tags whose values are the same for every request of
+ * the current configuration, so fillMetadata() copies them in one go
+ * instead of looking them up and writing them one by one each frame.
+ */
+status_t ControlUnit::buildResultSkeleton()
 {
-    /**
-     * Apparently we need to have this tags in the results
-     */
-    const CameraMetadata* settings = reqState->request->getSettings();
-    CameraMetadata* ctrlUnitResult = reqState->ctrlUnitResult;
-
-    if (CC_UNLIKELY(settings == nullptr)) {
-        LOGE("no settings in request - BUG");
-        return UNKNOWN_ERROR;
-    }
-
-    camera_metadata_ro_entry entry;
-    entry = settings->find(ANDROID_CONTROL_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_CONTROL_MODE, entry.data.u8, entry.count);
-    }
-    //# ANDROID_METADATA_Dynamic android.control.videoStabilizationMode copied
-    entry = settings->find(ANDROID_CONTROL_VIDEO_STABILIZATION_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_CONTROL_VIDEO_STABILIZATION_MODE, entry.data.u8, entry.count);
-    }
-    //# ANDROID_METADATA_Dynamic android.lens.opticalStabilizationMode copied
-    entry = settings->find(ANDROID_LENS_OPTICAL_STABILIZATION_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_LENS_OPTICAL_STABILIZATION_MODE, entry.data.u8, entry.count);
-    }
-    //# ANDROID_METADATA_Dynamic android.control.effectMode done
-    entry = settings->find(ANDROID_CONTROL_EFFECT_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_CONTROL_EFFECT_MODE, entry.data.u8, entry.count);
-    }
-    //# ANDROID_METADATA_Dynamic android.noiseReduction.mode done
-    entry = settings->find(ANDROID_NOISE_REDUCTION_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_NOISE_REDUCTION_MODE, entry.data.u8, entry.count);
-    }
-    //# ANDROID_METADATA_Dynamic android.edge.mode done
-    entry = settings->find(ANDROID_EDGE_MODE);
-    if (entry.count == 1) {
-        ctrlUnitResult->update(ANDROID_EDGE_MODE, entry.data.u8, entry.count);
-    }
+    // room for every tag below, the buffer is never resized
+    CameraMetadata skeleton(RESULT_SKELETON_ENTRY_CAP, RESULT_SKELETON_DATA_CAP);
 
     /**
      * We don't have AF, so just update metadata now
@@ -1024,52 +1006,96 @@ status_t ControlUnit::fillMetadata(std::shared_ptr<RequestCtrlState> &reqState)
     // return 0.0f for the fixed-focus
     if (!mLensSupported) {
         float focusDistance = 0.0f;
-        reqState->ctrlUnitResult->update(ANDROID_LENS_FOCUS_DISTANCE,
-                                         &focusDistance, 1);
+        skeleton.update(ANDROID_LENS_FOCUS_DISTANCE, &focusDistance, 1);
         // framework says it can't be off mode for zsl,
         // so we report EDOF for fixed focus
         // TODO: need to judge if the request is ZSL ?
         /* uint8_t afMode = ANDROID_CONTROL_AF_MODE_EDOF; */
         uint8_t afMode = ANDROID_CONTROL_AF_MODE_OFF;
-        ctrlUnitResult->update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
+        skeleton.update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
         uint8_t afTrigger = ANDROID_CONTROL_AF_TRIGGER_IDLE;
-        ctrlUnitResult->update(ANDROID_CONTROL_AF_TRIGGER, &afTrigger, 1);
+        skeleton.update(ANDROID_CONTROL_AF_TRIGGER, &afTrigger, 1);
 
         uint8_t afState = ANDROID_CONTROL_AF_STATE_INACTIVE;
-        ctrlUnitResult->update(ANDROID_CONTROL_AF_STATE, &afState, 1);
+        skeleton.update(ANDROID_CONTROL_AF_STATE, &afState, 1);
     }
 
     bool flash_available = false;
     uint8_t flash_mode = ANDROID_FLASH_MODE_OFF;
     mSettingsProcessor->getStaticMetadataCache().getFlashInfoAvailable(flash_available);
     if (!flash_available) {
-        reqState->ctrlUnitResult->update(ANDROID_FLASH_MODE,
-                                         &flash_mode, 1);
+        skeleton.update(ANDROID_FLASH_MODE, &flash_mode, 1);
         uint8_t flashState = ANDROID_FLASH_STATE_UNAVAILABLE;
         //# ANDROID_METADATA_Dynamic android.flash.state done
-        reqState->ctrlUnitResult->update(ANDROID_FLASH_STATE, &flashState, 1);
+        skeleton.update(ANDROID_FLASH_STATE, &flashState, 1);
     }
 
-    mMetadata->writeJpegMetadata(*reqState);
     uint8_t pipelineDepth;
     mSettingsProcessor->getStaticMetadataCache().getPipelineDepth(pipelineDepth);
     //# ANDROID_METADATA_Dynamic android.request.pipelineDepth done
-    reqState->ctrlUnitResult->update(ANDROID_REQUEST_PIPELINE_DEPTH,
-                                     &pipelineDepth, 1);
-    // for soc camera
+    skeleton.update(ANDROID_REQUEST_PIPELINE_DEPTH, &pipelineDepth, 1);
+
+    // for soc camera, the flash unit reports its own ae state per frame
     if (!mCtrlLoop || !mEnable3A) {
         uint8_t awbMode = ANDROID_CONTROL_AWB_MODE_AUTO;
-        ctrlUnitResult->update(ANDROID_CONTROL_AWB_MODE, &awbMode, 1);
+        skeleton.update(ANDROID_CONTROL_AWB_MODE, &awbMode, 1);
         uint8_t awbState = ANDROID_CONTROL_AWB_STATE_CONVERGED;
-        ctrlUnitResult->update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
-        if (mSocCamFlashCtrUnit.get()) {
-            mSocCamFlashCtrUnit->updateFlashResult(ctrlUnitResult);
-        } else {
+        skeleton.update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
+        if (!mSocCamFlashCtrUnit.get()) {
             uint8_t aeMode = ANDROID_CONTROL_AE_MODE_ON;
-            ctrlUnitResult->update(ANDROID_CONTROL_AE_MODE, &aeMode, 1);
+            skeleton.update(ANDROID_CONTROL_AE_MODE, &aeMode, 1);
             uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
-            ctrlUnitResult->update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+            skeleton.update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
         }
+    }
+
+    mResultSkeleton.acquire(skeleton);
+    return OK;
+}
+
+status_t ControlUnit::fillMetadata(std::shared_ptr<RequestCtrlState> &reqState)
+{
+    /**
+     * Apparently we need to have this tags in the results
+     */
+    const CameraMetadata* settings = reqState->request->getSettings();
+    CameraMetadata* ctrlUnitResult = reqState->ctrlUnitResult;
+
+    if (CC_UNLIKELY(settings == nullptr)) {
+        LOGE("no settings in request - BUG");
+        return UNKNOWN_ERROR;
+    }
+
+    // constant tags in one go, see buildResultSkeleton()
+    const camera_metadata_t *skeleton = mResultSkeleton.getAndLock();
+    MetadataHelper::mergeMetadata(*ctrlUnitResult, skeleton);
+    mResultSkeleton.unlock(skeleton);
+
+    //# ANDROID_METADATA_Dynamic android.control.mode,
+    //# android.control.videoStabilizationMode,
+    //# android.lens.opticalStabilizationMode, android.control.effectMode,
+    //# android.noiseReduction.mode and android.edge.mode copied
+    static const uint32_t kSettingsTags[] = {
+        ANDROID_CONTROL_MODE,
+        ANDROID_CONTROL_VIDEO_STABILIZATION_MODE,
+        ANDROID_LENS_OPTICAL_STABILIZATION_MODE,
+        ANDROID_CONTROL_EFFECT_MODE,
+        ANDROID_NOISE_REDUCTION_MODE,
+        ANDROID_EDGE_MODE,
+    };
+    camera_metadata_ro_entry entry;
+    for (uint32_t tag : kSettingsTags) {
+        entry = settings->find(tag);
+        if (entry.count == 1)
+            ctrlUnitResult->update(tag, entry.data.u8, entry.count);
+    }
+
+    mMetadata->writeJpegMetadata(*reqState);
+
+    // for soc camera
+    if (!mCtrlLoop || !mEnable3A) {
+        if (mSocCamFlashCtrUnit.get())
+            mSocCamFlashCtrUnit->updateFlashResult(ctrlUnitResult);
         reqState->mClMetaReceived = true;
     }
     return OK;
@@ -1206,12 +1232,19 @@ ControlUnit::handleNewShutter(Message &msg)
             return UNKNOWN_ERROR;
         }
         LOGD("%s:%d, stillcap_sync_state %d",
-             __FUNCTION__, __LINE__, mStillCapSyncState);
+             __FUNCTION__, __LINE__, mStillCapSyncState.load());
     }
 
     int64_t ts = msg.data.shutter.tv_sec * 1000000000; // seconds to nanoseconds
     ts += msg.data.shutter.tv_usec * 1000; // microseconds to nanoseconds
 
+    // a ZSL still reports the exposure of the frame it encodes, whether the
+    // request's own 3A result came already or comes later
+    if (msg.metas.get() != nullptr) {
+        reqState->mZslResult = msg.metas;
+        mergeZslResult(*reqState);
+    }
+
     //# ANDROID_METADATA_Dynamic android.sensor.timestamp done
     reqState->ctrlUnitResult->update(ANDROID_SENSOR_TIMESTAMP, &ts, 1);
     reqState->mShutterMetaReceived = true;
@@ -1249,32 +1282,47 @@ ControlUnit::handleMessageFlush(Message &msg)
     if (CC_UNLIKELY(status != OK)) {
         LOGE("Failed to stop 3a control loop!");
     }
+    if (mStillCapParked.get() != nullptr) {
+        LOGW("@%s: dropping still capture req %d waiting for 3A", __FUNCTION__,
+             mStillCapParked->request->getId());
+        mStillCapParked.reset();
+        mStillCapParkedMetas.clear();
+        mRequestsBehindStillCap.clear();
+        mStillCapSyncState = STILL_CAP_SYNC_STATE_TO_ENGINE_IDLE;
+    }
+
     mFlushForUseCase = msg.configChanged;
     if(msg.configChanged && mCtrlLoop && mEnable3A) {
         if (mStillCapSyncNeeded &&
             mStillCapSyncState != STILL_CAP_SYNC_STATE_TO_ENGINE_PRECAP &&
             mFlushForUseCase == FLUSH_FOR_STILLCAP) {
             rkisp_cl_frame_metadata_s frame_metas;
-            // force precap
+            // force precap, the latest result itself is shared and read only
+            CameraMetadata precapMeta;
+            if (mLatestCamMeta.get() != nullptr)
+                precapMeta = *mLatestCamMeta;
             uint8_t precap = ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_START;
-            mLatestCamMeta.update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &precap, 1);
-            frame_metas.metas = mLatestCamMeta.getAndLock();
+            precapMeta.update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &precap, 1);
+            frame_metas.metas = precapMeta.getAndLock();
             frame_metas.id = -1;
             status = mCtrlLoop->setFrameParams(&frame_metas);
             if (status != OK)
                 LOGE("CtrlLoop setFrameParams error");
 
-            status = mLatestCamMeta.unlock(frame_metas.metas);
+            status = precapMeta.unlock(frame_metas.metas);
             if (status != OK) {
                 LOGE("unlock frame frame_metas failed");
                 return UNKNOWN_ERROR;
             }
-            mStillCapSyncState = STILL_CAP_SYNC_STATE_FORCE_TO_ENGINE_PRECAP;
             // wait precap 3A done
-            while (mStillCapSyncState != STILL_CAP_SYNC_STATE_FORCE_PRECAP_DONE) {
-                LOGD("%d:wait forceprecap done...", __LINE__);
-                usleep(10*1000);
-            }
+            std::unique_lock<std::mutex> l(mStillCapSyncLock);
+            mStillCapSyncState = STILL_CAP_SYNC_STATE_FORCE_TO_ENGINE_PRECAP;
+            LOGD("%d:wait forceprecap done...", __LINE__);
+            if (!mStillCapSyncCond.wait_for(l,
+                    std::chrono::milliseconds(STILL_CAP_SYNC_TIMEOUT_MS),
+                    [this] { return mStillCapSyncState ==
+                                    STILL_CAP_SYNC_STATE_FORCE_PRECAP_DONE; }))
+                LOGW("waiting for forceprecap done timeout!");
             mStillCapSyncState = STILL_CAP_SYNC_STATE_TO_ENGINE_PRECAP;
         }
 
@@ -1285,10 +1333,87 @@ ControlUnit::handleMessageFlush(Message &msg)
 
     mWaitingForCapture.clear();
     mSettingsHistory.clear();
+    mClSettingsBase.reset();
 
     return NO_ERROR;
 }
 
+/**
+ * getClSettings
+ *
+ * Request settings with the tags in overlay replaced, to be handed to the
+ * control loop. The result is kept and returned as is while the request
+ * settings object and the overlay stay the same, so a repeating request
+ * is not copied every frame.
+ */
+CameraMetadata &
+ControlUnit::getClSettings(const std::shared_ptr<const CameraMetadata> &settings,
+                           const SettingsOverlay &overlay)
+{
+    if (settings == mClSettingsBase && overlay == mClSettingsOverlay)
+        return mClSettings;
+
+    mClSettings = *settings;
+    for (const auto &tag : overlay)
+        mClSettings.update(tag.first, &tag.second, 1);
+    mClSettingsBase = settings;
+    mClSettingsOverlay = overlay;
+    return mClSettings;
+}
+
+status_t
+ControlUnit::handleStillCapDone(Message &msg)
+{
+    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
+    UNUSED(msg);
+
+    // stale after a timeout or a flush, or a sync not waited for
+    if (mStillCapParked.get() == nullptr ||
+        mStillCapSyncState != STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE)
+        return OK;
+
+    return resumeStillCapture();
+}
+
+/**
+ * resumeStillCapture
+ *
+ * Completes the still capture parked by processRequestForCapture() once
+ * the 3A engine is done with it, or gave up, then the requests that came
+ * in behind it. One of those may park again.
+ */
+status_t
+ControlUnit::resumeStillCapture()
+{
+    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
+    std::shared_ptr<RequestCtrlState> reqState = mStillCapParked;
+    mStillCapParked.reset();
+
+    if (mStillCapSyncState == STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE)
+        mStillCapSyncState = STILL_CAP_SYNC_STATE_WATING_JPEG_FRAME;
+    LOGD("%s:%d, req id %d, stillcap_sync_state %d", __FUNCTION__, __LINE__,
+         reqState->request->getId(), mStillCapSyncState.load());
+
+    status_t status = completeProcessing(reqState);
+    if (status != OK)
+        LOGE("Cannot complete the buffer processing - fix the bug!");
+
+    std::vector<Message> metas;
+    metas.swap(mStillCapParkedMetas);
+    for (auto &msg : metas)
+        handleMetadataReceived(msg);
+
+    while (mStillCapParked.get() == nullptr && !mRequestsBehindStillCap.empty()) {
+        Message msg;
+        msg.id = MESSAGE_ID_NEW_REQUEST;
+        msg.state = mRequestsBehindStillCap.front();
+        mRequestsBehindStillCap.pop_front();
+        handleNewRequest(msg);
+    }
+
+    return status;
+}
+
 void
 ControlUnit::messageThreadLoop()
 {
@@ -1300,7 +1425,22 @@ ControlUnit::messageThreadLoop()
 
         PERFORMANCE_ATRACE_BEGIN("CtlU-PollMsg");
         Message msg;
-        mMessageQueue.receive(&msg);
+        if (mStillCapParked.get() != nullptr) {
+            // a parked still capture only waits for the 3A engine so long
+            nsecs_t left = mStillCapDeadline - systemTime();
+            if (left <= 0 ||
+                mMessageQueue.receive(&msg, left / 1000000 + 1) == TIMED_OUT) {
+                PERFORMANCE_ATRACE_END();
+                LOGW("waiting for stillcap_sync_done timeout!");
+                mStillCapSyncState = STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE;
+                status = resumeStillCapture();
+                if (status != NO_ERROR)
+                    LOGE("error %d in resuming still capture", status);
+                continue;
+            }
+        } else {
+            mMessageQueue.receive(&msg);
+        }
         PERFORMANCE_ATRACE_END();
 
         PERFORMANCE_ATRACE_NAME_SNPRINTF("CtlU-%s", ENUM2STR(CtlUMsg_stringEnum, msg.id));
@@ -1322,6 +1462,9 @@ ControlUnit::messageThreadLoop()
         case MESSAGE_ID_METADATA_RECEIVED:
             status = handleMetadataReceived(msg);
             break;
+        case MESSAGE_ID_STILL_CAP_DONE:
+            status = handleStillCapDone(msg);
+            break;
         case MESSAGE_ID_FLUSH:
             status = handleMessageFlush(msg);
             break;
@@ -1362,6 +1505,7 @@ ControlUnit::notifyCaptureEvent(CaptureMessage *captureMsg)
             msg.data.shutter.requestId = captureMsg->data.event.reqId;
             msg.data.shutter.tv_sec = captureMsg->data.event.timestamp.tv_sec;
             msg.data.shutter.tv_usec = captureMsg->data.event.timestamp.tv_usec;
+            msg.metas = captureMsg->data.event.result;
             mMessageQueue.send(&msg, MESSAGE_ID_NEW_SHUTTER);
             break;
         case CAPTURE_EVENT_NEW_SOF:
@@ -1398,10 +1542,15 @@ ControlUnit::metadataReceived(int id, const camera_metadata_t *metas) {
     if (entry.count == 1) {
         if (entry.data.u8[0] == RKCAMERA3_PRIVATEDATA_STILLCAP_SYNC_CMD_SYNCDONE &&
             (mStillCapSyncState == STILL_CAP_SYNC_STATE_WAITING_ENGINE_DONE ||
-             mFlushForUseCase == FLUSH_FOR_STILLCAP))
+             mFlushForUseCase == FLUSH_FOR_STILLCAP)) {
             mStillCapSyncState = STILL_CAP_SYNC_STATE_FROM_ENGINE_DONE;
+            // wake up the still capture parked in the ControlUnit thread
+            Message doneMsg;
+            doneMsg.id = MESSAGE_ID_STILL_CAP_DONE;
+            mMessageQueue.send(&doneMsg);
+        }
             LOGD("%s:%d, stillcap_sync_state %d",
-                 __FUNCTION__, __LINE__, mStillCapSyncState);
+                 __FUNCTION__, __LINE__, mStillCapSyncState.load());
     }
 
     entry = result.find(ANDROID_CONTROL_AE_STATE);
@@ -1409,10 +1558,14 @@ ControlUnit::metadataReceived(int id, const camera_metadata_t *metas) {
         if (id == -1 && entry.data.u8[0] == ANDROID_CONTROL_AE_STATE_CONVERGED &&
             mStillCapSyncState == STILL_CAP_SYNC_STATE_FORCE_TO_ENGINE_PRECAP &&
             sLastAeStateMap[mCameraId] == ANDROID_CONTROL_AE_STATE_PRECAPTURE) {
-            mStillCapSyncState = STILL_CAP_SYNC_STATE_FORCE_PRECAP_DONE;
+            {
+                std::lock_guard<std::mutex> l(mStillCapSyncLock);
+                mStillCapSyncState = STILL_CAP_SYNC_STATE_FORCE_PRECAP_DONE;
+            }
+            mStillCapSyncCond.notify_all();
             sLastAeStateMap[mCameraId] = 0;
             LOGD("%s:%d, stillcap_sync_state %d",
-                 __FUNCTION__, __LINE__, mStillCapSyncState);
+                 __FUNCTION__, __LINE__, mStillCapSyncState.load());
         }
         sLastAeStateMap[mCameraId] = entry.data.u8[0];
     }
@@ -1422,7 +1575,8 @@ ControlUnit::metadataReceived(int id, const camera_metadata_t *metas) {
     if (id != -1) {
         msg.id = MESSAGE_ID_METADATA_RECEIVED;
         msg.requestId = id;
-        msg.metas = metas;
+        // the only copy, the control loop owns metas
+        msg.metas = std::make_shared<CameraMetadata>(clone_camera_metadata(metas));
         status = mMessageQueue.send(&msg);
     }
 
@@ -1451,12 +1605,31 @@ ControlUnit::handleMetadataReceived(Message &msg) {
         return UNKNOWN_ERROR;
     }
 
+    // merged once the parked capture is completed, on top of its settings
+    if (reqState == mStillCapParked) {
+        mStillCapParkedMetas.push_back(msg);
+        return OK;
+    }
+
     mLatestCamMeta = msg.metas;
+    // kept with the frame of the request for a later ZSL still
+    if (msg.metas.get() != nullptr)
+        mImguUnit->notifyFrameResult(reqId, msg.metas);
+
     //Metadata reuslt are mainly divided into three parts
     //1. some settings from app
     //2. 3A metas from Control loop
     //3. some items like sensor timestamp from shutter
-    reqState->ctrlUnitResult->append(msg.metas);
+    if (msg.metas.get() != nullptr) {
+        const camera_metadata_t *metas = msg.metas->getAndLock();
+        status = MetadataHelper::mergeMetadata(*reqState->ctrlUnitResult, metas);
+        msg.metas->unlock(metas);
+        if (status != OK)
+            LOGW("@%s: merging 3A result of request %d failed", __FUNCTION__, reqId);
+        status = OK;
+    }
+    if (reqState->mZslResult.get() != nullptr)
+        mergeZslResult(*reqState);
     reqState->mClMetaReceived = true;
     if(reqState->mShutterMetaReceived) {
         mMetadata->writeRestMetadata(*reqState);
@@ -1473,6 +1646,17 @@ ControlUnit::handleMetadataReceived(Message &msg) {
     return status;
 }
 
+void
+ControlUnit::mergeZslResult(RequestCtrlState &reqState)
+{
+    const camera_metadata_t *metas = reqState.mZslResult->getAndLock();
+    status_t status = MetadataHelper::mergeMetadata(*reqState.ctrlUnitResult, metas);
+    reqState.mZslResult->unlock(metas);
+    if (status != OK)
+        LOGW("@%s: merging ZSL frame result of request %d failed", __FUNCTION__,
+             reqState.request->getId());
+}
+
 /**
  * Static callback forwarding methods from CL to instance
  */
@@ -17,7 +17,11 @@
 
 #ifndef CAMERA3_HAL_CONTROLUNIT_H_
 #define CAMERA3_HAL_CONTROLUNIT_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 //#include <linux/rkisp1-config_v12.h>
 #include "MessageQueue.h"
@@ -140,7 +144,8 @@ public:  /* private types */
         MessageData data;
         Camera3Request* request;
         std::shared_ptr<RequestCtrlState> state;
-        CameraMetadata metas;
+        /* 3A result, shared by every copy of the message, never modified */
+        std::shared_ptr<const CameraMetadata> metas;
         CaptureEventType type;
         Message(): id(MESSAGE_ID_EXIT),
             requestId(0),
@@ -172,7 +177,10 @@ private:  /* Methods */
     status_t handleNewRequestDone(Message &msg);
     status_t handleMetadataReceived(Message &msg);
     status_t handleNewShutter(Message &msg);
+    void mergeZslResult(RequestCtrlState &reqState);
     status_t handleMessageFlush(Message &msg);
+    status_t handleStillCapDone(Message &msg);
+    status_t resumeStillCapture();
 
     status_t processRequestForCapture(std::shared_ptr<RequestCtrlState> &reqState);
 
@@ -180,9 +188,13 @@ private:  /* Methods */
     status_t acquireRequestStateStruct(std::shared_ptr<RequestCtrlState>& state);
     status_t initStaticMetadata();
     status_t metadataReceived(int id, const camera_metadata_t *metas);
+    status_t buildResultSkeleton();
     status_t fillMetadata(std::shared_ptr<RequestCtrlState> &reqState);
     status_t getDevicesPath();
     status_t processSoCSettings(const CameraMetadata *settings);
+    typedef std::vector<std::pair<uint32_t, uint8_t>> SettingsOverlay;
+    CameraMetadata &getClSettings(const std::shared_ptr<const CameraMetadata> &settings,
+                                  const SettingsOverlay &overlay);
 
 private:  /* Members */
     SharedItemPool<RequestCtrlState> mRequestStatePool;
@@ -256,9 +268,32 @@ private:  /* Members */
         STILL_CAP_SYNC_STATE_WATING_JPEG_FRAME,
         STILL_CAP_SYNC_STATE_JPEG_FRAME_DONE,
     } StillCapSyncState_e ;
-    StillCapSyncState_e mStillCapSyncState;
+    /* also written by the 3A engine callback */
+    std::atomic<StillCapSyncState_e> mStillCapSyncState;
+    /* the forced precapture of a flush waits on it for the 3A engine */
+    std::mutex mStillCapSyncLock;
+    std::condition_variable mStillCapSyncCond;
+    /**
+     * Still capture waiting for the 3A engine to report the sync done. It
+     * is completed from MESSAGE_ID_STILL_CAP_DONE or at the deadline, the
+     * 3A results for it and the requests behind it are held meanwhile so
+     * they still reach the Processing Unit in order.
+     */
+    std::shared_ptr<RequestCtrlState> mStillCapParked;
+    nsecs_t mStillCapDeadline;
+    std::vector<Message> mStillCapParkedMetas;
+    std::deque<std::shared_ptr<RequestCtrlState>> mRequestsBehindStillCap;
+    static const int STILL_CAP_SYNC_TIMEOUT_MS = 5000;
     int mFlushForUseCase;
-    CameraMetadata mLatestCamMeta;
+    std::shared_ptr<const CameraMetadata> mLatestCamMeta;
+    /* result tags that are constant for the configuration */
+    static const size_t RESULT_SKELETON_ENTRY_CAP = 16;
+    static const size_t RESULT_SKELETON_DATA_CAP = 64;
+    CameraMetadata mResultSkeleton;
+    /* last settings handed to the control loop, see getClSettings() */
+    std::shared_ptr<const CameraMetadata> mClSettingsBase;
+    SettingsOverlay mClSettingsOverlay;
+    CameraMetadata mClSettings;
 };  // class ControlUnit
 
 const element_value_t CtlUMsg_stringEnum[] = {
@@ -17,6 +17,8 @@
 
 #define LOG_TAG "GraphConfigManager"
 
+#include <algorithm>
+
 #include "GraphConfigManager.h"
 #include "GraphConfig.h"
 #include "PlatformData.h"
@@ -230,13 +232,6 @@ status_t GraphConfigManager::configStreams(const vector<camera3_stream_t*> &stre
     CheckError(gc.get() == nullptr, UNKNOWN_ERROR, "@%s, Graph config is NULL, BUG!",
                    __FUNCTION__);
 
-    /**
-     * since we map the max res stream to video, and the little one to preview, so
-     * swapVideoPreview here is always false,  by the way, please make sure
-     * the video or still stream size >= preview stream size in graph_settings_<sensor name>.xml, zyc.
-     */
-    gc->setMediaCtlConfig(mMediaCtl, false, false);
-
     // Get media control config
     for (size_t i = 0; i < MEDIA_TYPE_MAX_COUNT; i++) {
         mMediaCtlConfigsPrev[i] = mMediaCtlConfigs[i];
@@ -250,6 +245,27 @@ status_t GraphConfigManager::configStreams(const vector<camera3_stream_t*> &stre
         mMediaCtlConfigs[i].mVideoNodes.clear();
     }
 
+    /*
+     * Switching between still and video use cases goes back and forth
+     * between a few configurations, so the media controller configs are
+     * only computed the first time a configuration is seen.
+     */
+    ConfigSignature signature = configSignature(testPatternMode);
+    auto cached = mMediaCtlConfigCache.find(signature);
+    if (cached != mMediaCtlConfigCache.end()) {
+        LOGI("@%s: reusing media controller config", __FUNCTION__);
+        mMediaCtlConfigs[CIO2] = cached->second.sensor;
+        mMediaCtlConfigs[IMGU_COMMON] = cached->second.imgu;
+        return OK;
+    }
+
+    /**
+     * since we map the max res stream to video, and the little one to preview, so
+     * swapVideoPreview here is always false,  by the way, please make sure
+     * the video or still stream size >= preview stream size in graph_settings_<sensor name>.xml, zyc.
+     */
+    gc->setMediaCtlConfig(mMediaCtl, false, false);
+
     ret = gc->getSensorMediaCtlConfig(mCameraId, testPatternMode,
                                   &mMediaCtlConfigs[CIO2]);
     if (ret != OK)
@@ -260,9 +276,46 @@ status_t GraphConfigManager::configStreams(const vector<camera3_stream_t*> &stre
     if (ret != OK)
         LOGE("Couldn't get Imgu mediaCtl config");
 
+    if (ret == OK) {
+        if (mMediaCtlConfigCache.size() >= MAX_CACHED_CONFIGS)
+            mMediaCtlConfigCache.clear();
+        CachedMediaCtlConfigs &entry = mMediaCtlConfigCache[signature];
+        entry.sensor = mMediaCtlConfigs[CIO2];
+        entry.imgu = mMediaCtlConfigs[IMGU_COMMON];
+    }
+
     return OK;
 }
 
+/**
+ * Build the key of the media controller config cache for the current
+ * stream to sink mapping.
+ * Sink ids are unique, so sorting by them makes the signature independent
+ * of the stream pointers.
+ */
+GraphConfigManager::ConfigSignature
+GraphConfigManager::configSignature(int32_t testPatternMode) const
+{
+    std::vector<std::pair<uid_t, camera3_stream_t*>> sinks;
+    for (auto &it : mStreamToSinkIdMap)
+        sinks.push_back(std::make_pair(it.second, it.first));
+    std::sort(sinks.begin(), sinks.end());
+
+    ConfigSignature signature = {
+        mCameraId,
+        mIsOnlyEnableMp,
+        testPatternMode,
+        LogHelper::isDumpTypeEnable(CAMERA_DUMP_RAW)
+    };
+    for (auto &sink : sinks) {
+        signature.push_back(sink.first);
+        signature.push_back(sink.second->width);
+        signature.push_back(sink.second->height);
+        signature.push_back(sink.second->format);
+    }
+    return signature;
+}
+
 /**
  * Prepare graph config object
  *
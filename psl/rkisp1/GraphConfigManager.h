@@ -141,7 +141,20 @@ private:
 
     status_t mapStreamToKey(const std::vector<camera3_stream_t*> &streams,
                                     int& videoStreamCnt, int& stillStreamCnt);
+
+    /*
+     * Media controller configs already computed for a stream configuration,
+     * keyed by what they are derived from: camera id, use case, test
+     * pattern, raw dump and the size and format of the stream on each sink.
+     */
+    typedef std::vector<int32_t> ConfigSignature;
+    struct CachedMediaCtlConfigs {
+        MediaCtlConfig sensor;  // CIO2, holds the sensor mode
+        MediaCtlConfig imgu;    // IMGU_COMMON
+    };
+    ConfigSignature configSignature(int32_t testPatternMode) const;
 private:
+    static const size_t MAX_CACHED_CONFIGS = 8;
 
     bool mIsOnlyEnableMp;
     SharedItemPool<GraphConfig> mGraphConfigPool;
@@ -157,6 +170,7 @@ private:
 
     MediaCtlConfig mMediaCtlConfigs[MEDIA_TYPE_MAX_COUNT];
     MediaCtlConfig mMediaCtlConfigsPrev[MEDIA_TYPE_MAX_COUNT];
+    std::map<ConfigSignature, CachedMediaCtlConfigs> mMediaCtlConfigCache;
 
     std::shared_ptr<MediaController> mMediaCtl;
 };
@@ -39,6 +39,9 @@ ImguUnit::ImguUnit(int cameraId,
         mGCM(gcm),
         mThreadRunning(false),
         mMessageQueue("ImguUnitThread", static_cast<int>(MESSAGE_ID_MAX)),
+        mPollRing("ImguPollRing", 0, POLL_RING_CAPACITY),
+        mPollDoorbell(false),
+        mPollDequeuePending(false),
         mCurPipeConfig(nullptr),
         mMediaCtlHelper(mediaCtl, nullptr, true),
         mPollerThread(new PollerThread("ImguPollerThread")),
@@ -75,35 +78,6 @@ ImguUnit::ImguUnit(int cameraId,
     mRawOutWorker =
         std::make_shared<OutputFrameWorker>(mCameraId, "RawWork",
                                             IMGU_NODE_RAW, pipelineDepth);
-    // Pre allocate hal internal buffer in order to speed up some case need
-    // allocate buffer temporary.
-    // process unit in postpipeline which is not last unit will allocate
-    // internal buffer, now just acquire from the PreAllocateBuffer pool.
-    SensorFormat availableSensorFormat;
-    int ret = PlatformData::getCameraHWInfo()->getAvailableSensorOutputFormats(cameraId, availableSensorFormat);
-    if (ret != NO_ERROR)
-        return ;
-
-    struct SensorFrameSize &frameSize = availableSensorFormat.begin()->second.back();
-    int w, h, fmt, usage, num;
-    w = frameSize.max_width;
-    h = frameSize.max_height;
-    fmt = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
-    usage = GRALLOC_USAGE_SW_READ_OFTEN |
-            GRALLOC_USAGE_HW_CAMERA_WRITE|
-            /* TODO: same as the temp solution in RKISP1CameraHw.cpp configStreams func
-             * add GRALLOC_USAGE_HW_VIDEO_ENCODER is a temp patch for gpu bug:
-             * gpu cant alloc a nv12 buffer when format is
-             * HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED. Need gpu provide a patch */
-            GRALLOC_USAGE_HW_VIDEO_ENCODER;
-
-    /* TODO buffer num should consider postpipeline depth
-     * */
-    num = pipelineDepth;
-
-    if (MemoryUtils::creatHandlerBufferPool(cameraId, w, h, fmt, usage, num) != OK) {
-        LOGE("@%s : Pre allocate buffers failed, wxh(%d,%d), num:%d", __FUNCTION__, w, h, num);
-    }
 }
 
 ImguUnit::~ImguUnit()
@@ -171,7 +145,8 @@ void ImguUnit::clearWorkers()
 }
 
 status_t
-ImguUnit::configStreams(std::vector<camera3_stream_t*> &activeStreams, bool configChanged)
+ImguUnit::configStreams(std::vector<camera3_stream_t*> &activeStreams, bool configChanged,
+                        bool zsl)
 {
     PERFORMANCE_ATRACE_NAME("ImguUnit::configStreams");
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
@@ -189,6 +164,12 @@ ImguUnit::configStreams(std::vector<camera3_stream_t*> &activeStreams, bool conf
     mCurPipeConfig = nullptr;
     mTakingPicture = false;
     mFlushing = false;
+    mMainOutWorker->enableZsl(zsl);
+    mSelfOutWorker->enableZsl(zsl);
+    mRawOutWorker->enableZsl(zsl);
+    // the post processing units reserve the internal buffers they need
+    // while being configured, sized to these streams
+    MemoryUtils::clearInternalBufferReservations(mCameraId);
 
     for (unsigned int i = 0; i < activeStreams.size(); ++i) {
         // treat CAMERA3_STREAM_BIDIRECTIONAL as combination with an input
@@ -802,7 +783,6 @@ status_t ImguUnit::processNextRequest()
             dummyMsg.pollEvent.requestId = request->getId();
             dummyMsg.pollEvent.numDevices = 0;
             dummyMsg.pollEvent.polledDevices = 0;
-            dummyMsg.pollEvent.activeDevices = nullptr;
             dummyMsg.id = MESSAGE_ID_POLL;
             dummyMsg.cbMetadataMsg = cbMetadataMsg;
             status |= (*it)->prepareRun(msg);
@@ -858,9 +838,8 @@ ImguUnit::startProcessing(DeviceMessage pollmsg)
     PERFORMANCE_ATRACE_CALL();
 
     status_t status = OK;
-    std::shared_ptr<V4L2VideoNode> *activeNodes = pollmsg.pollEvent.activeDevices;
     int processReqNum = 1;
-    bool deviceError = pollmsg.pollEvent.polledDevices && !activeNodes;
+    bool deviceError = pollmsg.pollEvent.polledDevices && !pollmsg.pollEvent.numDevices;
 
     std::shared_ptr<DeviceMessage> msg;
     Camera3Request *request;
@@ -923,7 +902,14 @@ ImguUnit::startProcessing(DeviceMessage pollmsg)
             std::shared_ptr<FrameWorker> worker = (std::shared_ptr<FrameWorker>&)(*it);
             status |= worker->asyncPollDone(*(mMessagesUnderwork.begin()), true);
         }
-
+        // the polled request is dequeued, the poller may poll again while
+        // the frames are processed
+        if (i == 0)
+            ackPollEvent();
+
+        // run() dequeues buffers the poller found ready and postRun() hands
+        // the frame to the worker's post processing thread, where crop, scale
+        // and JPEG encoding happen, so the workers are walked serially here
         it = mRequestToWorkMap[reqId].begin();
         for (;it != mRequestToWorkMap[reqId].end(); ++it) {
             status |= (*it)->run();
@@ -979,10 +965,6 @@ status_t ImguUnit::notifyPollEvent(PollEventMessage *pollMsg)
             return OK;
         }
 
-        msg.pollEvent.activeDevices = new std::shared_ptr<V4L2VideoNode>[numDevices];
-        for (int i = 0; i < numDevices; i++) {
-            msg.pollEvent.activeDevices[i] = (std::shared_ptr<V4L2VideoNode>&) pollMsg->data.activeDevices->at(i);
-        }
         msg.pollEvent.numDevices = numDevices;
         msg.pollEvent.polledDevices = numPolledDevices;
 
@@ -993,8 +975,6 @@ status_t ImguUnit::notifyPollEvent(PollEventMessage *pollMsg)
             pollMsg->data.polledDevices->clear();
             *pollMsg->data.polledDevices = *pollMsg->data.inactiveDevices; // retry with inactive devices
 
-            delete [] msg.pollEvent.activeDevices;
-
             return -EAGAIN;
         }
 
@@ -1002,20 +982,33 @@ status_t ImguUnit::notifyPollEvent(PollEventMessage *pollMsg)
             std::lock_guard<std::mutex> l(mFlushMutex);
             if (mFlushing)
                 return OK;
-            msg.id = MESSAGE_ID_POLL;
-            mMessageQueue.send(&msg, MESSAGE_ID_POLL);
+            mPollDequeuePending = true;
         }
-
     } else if (pollMsg->id == POLL_EVENT_ID_ERROR) {
         LOGE("Device poll failed");
         // For now, set number of device to zero in error case
         msg.pollEvent.numDevices = 0;
         msg.pollEvent.polledDevices = pollMsg->data.polledDevices->size();
-        msg.id = MESSAGE_ID_POLL;
-
-        mMessageQueue.send(&msg);
     } else {
         LOGW("unknown poll event id (%d)", pollMsg->id);
+        return OK;
+    }
+
+    // Hand the event over without waiting for it to be processed, so the
+    // poller can go on with the next request once the frames are dequeued.
+    msg.id = MESSAGE_ID_POLL;
+    mPollRing.send(&msg);
+    if (!mPollDoorbell.exchange(true)) {
+        DeviceMessage doorbell;
+        doorbell.id = MESSAGE_ID_POLL_RING;
+        mMessageQueue.send(&doorbell);
+    }
+
+    // An error event is not waited for: the ImguUnit thread flushes the
+    // poller when handling it.
+    if (pollMsg->id == POLL_EVENT_ID_EVENT) {
+        std::unique_lock<std::mutex> l(mFlushMutex);
+        mPollDequeueCond.wait(l, [this] { return !mPollDequeuePending || mFlushing; });
     }
 
     return OK;
@@ -1025,15 +1018,56 @@ status_t ImguUnit::handleMessagePoll(DeviceMessage msg)
 {
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
 
-    status_t status = startProcessing(msg);
+    return startProcessing(msg);
+}
+
+/**
+ * Process every poll event in the ring. The doorbell is cleared before the
+ * ring is drained, so an event pushed meanwhile either gets drained here or
+ * rings again.
+ */
+status_t ImguUnit::handleMessagePollRing(void)
+{
+    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
+    status_t status = OK;
 
-    if (msg.pollEvent.activeDevices)
-        delete [] msg.pollEvent.activeDevices;
-    msg.pollEvent.activeDevices = nullptr;
+    mPollDoorbell = false;
+    while (!mPollRing.isEmpty()) {
+        DeviceMessage msg;
+        mPollRing.receive(&msg);
+        status |= handleMessagePoll(msg);
+        // also releases the poller for events processed later, see
+        // startProcessing()
+        ackPollEvent();
+    }
 
     return status;
 }
 
+/**
+ * Let the poller go on with the next request: the nodes of the last poll
+ * event are dequeued, or the event was put aside.
+ */
+void ImguUnit::ackPollEvent(void)
+{
+    std::lock_guard<std::mutex> l(mFlushMutex);
+    if (!mPollDequeuePending)
+        return;
+    mPollDequeuePending = false;
+    mPollDequeueCond.notify_all();
+}
+
+void ImguUnit::dropPollEvents(void)
+{
+    ackPollEvent();
+    mPollDoorbell = false;
+    while (!mPollRing.isEmpty()) {
+        DeviceMessage msg;
+        mPollRing.receive(&msg);
+        LOGD("@%s: drop poll event of request %d", __FUNCTION__, msg.pollEvent.requestId);
+    }
+}
+
 void ImguUnit::getConfigedHwPathSize(const char* pathName, uint32_t &size)
 {
     mMediaCtlHelper.getConfigedHwPathSize(pathName, size);
@@ -1044,6 +1078,14 @@ void ImguUnit::getConfigedSensorOutputSize(uint32_t &size)
     mMediaCtlHelper.getConfigedSensorOutputSize(size);
 }
 
+void ImguUnit::notifyFrameResult(int reqId,
+                                 const std::shared_ptr<const CameraMetadata> &result)
+{
+    mMainOutWorker->addZslResult(reqId, result);
+    mSelfOutWorker->addZslResult(reqId, result);
+    mRawOutWorker->addZslResult(reqId, result);
+}
+
 void
 ImguUnit::messageThreadLoop(void)
 {
@@ -1072,6 +1114,9 @@ ImguUnit::messageThreadLoop(void)
         case MESSAGE_ID_POLL_META:
             status = handleMessagePoll(msg);
             break;
+        case MESSAGE_ID_POLL_RING:
+            status = handleMessagePollRing();
+            break;
         case MESSAGE_ID_FLUSH:
             status = handleMessageFlush();
             break;
@@ -1123,9 +1168,12 @@ ImguUnit::flush(void)
     {
         std::lock_guard<std::mutex> l(mFlushMutex);
         mFlushing = true;
+        // the poller must not wait for a dequeue that won't happen
+        mPollDequeueCond.notify_all();
     }
 
     mMessageQueue.remove(MESSAGE_ID_POLL);
+    mMessageQueue.remove(MESSAGE_ID_POLL_RING);
 
     return mMessageQueue.send(&msg, MESSAGE_ID_FLUSH);
 }
@@ -1136,6 +1184,8 @@ ImguUnit::handleMessageFlush(void)
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
 
     mPollerThread->flush(true);
+    // the poller is stopped, events it handed over before are stale
+    dropPollEvents();
     // flush all video nodes
     if (mCurPipeConfig) {
         status_t status;
@@ -18,6 +18,8 @@
 #ifndef PSL_RKISP1_IMGUUNIT_H_
 #define PSL_RKISP1_IMGUUNIT_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 
 #include "GraphConfigManager.h"
@@ -43,7 +45,9 @@ public:
             std::shared_ptr<MediaController> mediaCtl);
     virtual ~ImguUnit();
     status_t flush(void);
-    status_t configStreams(std::vector<camera3_stream_t*> &activeStreams, bool configChanged);
+    /* |zsl| keeps frames for the JPEG streams, see ZslFrameRing */
+    status_t configStreams(std::vector<camera3_stream_t*> &activeStreams, bool configChanged,
+                           bool zsl);
     status_t configStreamsDone();
     void cleanListener();
     status_t completeRequest(std::shared_ptr<ProcUnitSettings> &processingSettings,
@@ -56,12 +60,17 @@ public:
     virtual void registerErrorCallback(IErrorCallback* errCb) { mErrCb = errCb; }
     void getConfigedHwPathSize(const char* pathName, uint32_t &size);
     void getConfigedSensorOutputSize(uint32_t &size);
+    /* 3A result of request |reqId|, kept for ZSL stills */
+    void notifyFrameResult(int reqId, const std::shared_ptr<const CameraMetadata> &result);
 
 private:
     status_t configureVideoNodes(std::shared_ptr<GraphConfig> graphConfig);
     status_t handleMessageCompleteReq(DeviceMessage &msg);
     status_t processNextRequest();
     status_t handleMessagePoll(DeviceMessage msg);
+    status_t handleMessagePollRing(void);
+    void ackPollEvent(void);
+    void dropPollEvents(void);
     status_t handleMessageFlush(void);
     status_t updateProcUnitResults(Camera3Request &request,
                                    std::shared_ptr<ProcUnitSettings> settings);
@@ -113,6 +122,23 @@ private:
     bool mThreadRunning;
     std::unique_ptr<MessageThread> mMessageThread;
     MessageQueue<DeviceMessage, DeviceMessageId> mMessageQueue;
+
+    /*
+     * Poll events are handed over from the poller thread through a
+     * preallocated SPSC ring. A MESSAGE_ID_POLL_RING doorbell on
+     * mMessageQueue wakes the ImguUnit thread; mPollDoorbell is set while one
+     * is pending, so back-to-back events share a single doorbell.
+     * The poller waits until the frames of the event are dequeued (not until
+     * they are processed): the nodes stay readable until then, and polling
+     * them again would return at once and make the ImguUnit thread block in
+     * DQBUF without the poll timeout.
+     */
+    static const unsigned int POLL_RING_CAPACITY = 16;
+    MessageQueue<DeviceMessage, DeviceMessageId> mPollRing;
+    std::atomic<bool> mPollDoorbell;
+    std::condition_variable mPollDequeueCond;
+    bool mPollDequeuePending; /* protected by mFlushMutex */
+
     StreamConfig mActiveStreams;
     std::vector<std::shared_ptr<ITaskEventListener>> mListeningTasks;   // Tasks that listen for events from another task.
 
@@ -125,7 +151,7 @@ private:
     MediaCtlHelper mMediaCtlHelper;
     std::unique_ptr<PollerThread> mPollerThread;
 
-    std::mutex mFlushMutex; /* proctec mFlushing */
+    std::mutex mFlushMutex; /* proctec mFlushing, mPollDequeuePending */
     bool mFlushing; /* avoid dead lock between poller thread and imgu message thread for sync flush */
 
     std::vector<std::shared_ptr<DeviceMessage>> mMessagesPending; // Keep copy of message until workers start to handle it
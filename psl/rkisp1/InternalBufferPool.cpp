@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InternalBufferPool"
+
+#include <chrono>
+#include <algorithm>
+#include "LogHelper.h"
+#include "PerformanceTraces.h"
+#include "InternalBufferPool.h"
+
+namespace android {
+namespace camera2 {
+
+const unsigned int InternalBufferPool::kLowWatermark;
+const unsigned int InternalBufferPool::kRefillTarget;
+const unsigned int InternalBufferPool::kMaxBuffersPerBucket;
+const int InternalBufferPool::kTrimIntervalMs;
+
+std::shared_ptr<InternalBufferPool> InternalBufferPool::create(int cameraId)
+{
+    std::shared_ptr<InternalBufferPool> pool(new InternalBufferPool(cameraId));
+    if (pool->mMessageThread->run() != NO_ERROR) {
+        LOGE("@%s: failed to start refill thread for camera %d", __FUNCTION__, cameraId);
+        return nullptr;
+    }
+    return pool;
+}
+
+InternalBufferPool::InternalBufferPool(int cameraId) :
+    mCameraId(cameraId),
+    mExiting(false),
+    mFrameAllocs(0),
+    mDryAcquires(0),
+    mRefillAllocs(0),
+    mTrimmed(0)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "BufPool-%d", cameraId);
+    mMessageThread = std::unique_ptr<MessageThread>(new MessageThread(this, name));
+}
+
+InternalBufferPool::~InternalBufferPool()
+{
+    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        mExiting = true;
+    }
+    mWorkCond.notify_all();
+    mMessageThread->requestExitAndWait();
+    mMessageThread.reset();
+
+    dump();
+    /* buffers still in use are freed by their owners when released */
+    mBuckets.clear();
+}
+
+/**
+ * Creates (or grows) the bucket for the given geometry and reserves
+ * \a reserve more buffers in it, on top of what was reserved for the same
+ * geometry since the last clearReservations(). They are allocated on the
+ * background thread, reserved buffers are never trimmed.
+ */
+status_t InternalBufferPool::addBucket(int w, int h, int gfxFmt, int usage, int reserve)
+{
+    HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
+    LOGI("%s, [wxh] = [%dx%d], format 0x%x, usage 0x%x, nums %d",
+          __FUNCTION__, w, h, gfxFmt, usage, reserve);
+
+    std::lock_guard<std::mutex> l(mLock);
+    Bucket *bucket = nullptr;
+    for (auto &it : mBuckets) {
+        if (it->width == w && it->height == h &&
+            it->gfxFmt == gfxFmt && it->usage == usage) {
+            bucket = it.get();
+            break;
+        }
+    }
+    if (bucket == nullptr)
+        bucket = newBucketLocked(w, h, gfxFmt, usage, 0);
+
+    bucket->reserved = std::min(bucket->reserved + reserve, kMaxBuffersPerBucket);
+    if (bucket->allocated < bucket->reserved)
+        requestRefillLocked(bucket);
+
+    return OK;
+}
+
+void InternalBufferPool::clearReservations()
+{
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        for (auto &it : mBuckets)
+            it->reserved = 0;
+    }
+    mWorkCond.notify_one();
+}
+
+/**
+ * Returns the smallest bucket of matching format and usage that can hold a
+ * wxh image. With \a needFree only buckets with a free buffer are considered.
+ */
+InternalBufferPool::Bucket*
+InternalBufferPool::findBucketLocked(int w, int h, int gfxFmt, int usage, bool needFree)
+{
+    Bucket *best = nullptr;
+    for (auto &it : mBuckets) {
+        Bucket *b = it.get();
+        if (b->gfxFmt != gfxFmt || b->usage != usage ||
+            b->width < w || b->height < h)
+            continue;
+        if (needFree && b->freeList.empty())
+            continue;
+        if (best == nullptr ||
+            (int64_t)b->width * b->height < (int64_t)best->width * best->height)
+            best = b;
+    }
+    return best;
+}
+
+InternalBufferPool::Bucket*
+InternalBufferPool::newBucketLocked(int w, int h, int gfxFmt, int usage, int reserve)
+{
+    std::unique_ptr<Bucket> bucket(new Bucket);
+    bucket->width = w;
+    bucket->height = h;
+    bucket->gfxFmt = gfxFmt;
+    bucket->usage = usage;
+    bucket->reserved = reserve;
+    bucket->allocated = 0;
+    bucket->peakInUse = 0;
+    bucket->refillPending = false;
+    mBuckets.push_back(std::move(bucket));
+    LOGD("@%s: camera %d new bucket %dx%d fmt 0x%x", __FUNCTION__, mCameraId, w, h, gfxFmt);
+    return mBuckets.back().get();
+}
+
+void InternalBufferPool::requestRefillLocked(Bucket *bucket)
+{
+    if (bucket->refillPending || mExiting ||
+        bucket->allocated >= kMaxBuffersPerBucket)
+        return;
+    bucket->refillPending = true;
+    mRefillQueue.push_back(bucket);
+    mWorkCond.notify_one();
+}
+
+std::shared_ptr<CameraBuffer>
+InternalBufferPool::acquire(int w, int h, int gfxFmt, int usage, bool allowAllocate)
+{
+    std::shared_ptr<CameraBuffer> buffer = nullptr;
+    std::unique_lock<std::mutex> l(mLock);
+
+    Bucket *bucket = findBucketLocked(w, h, gfxFmt, usage, true);
+    if (bucket == nullptr) {
+        /* nothing free that fits: use the best fitting bucket */
+        bucket = findBucketLocked(w, h, gfxFmt, usage, false);
+        if (bucket == nullptr)
+            bucket = newBucketLocked(w, h, gfxFmt, usage, 0);
+        requestRefillLocked(bucket);
+        mDryAcquires++;
+    }
+
+    if (!bucket->freeList.empty()) {
+        buffer = bucket->freeList.back();
+        bucket->freeList.pop_back();
+    } else if (allowAllocate) {
+        l.unlock();
+        buffer = MemoryUtils::allocateHandleBuffer(bucket->width, bucket->height,
+                                                   gfxFmt, usage);
+        l.lock();
+        CheckError((buffer.get() == nullptr), nullptr, "@%s : No memeory, failed allocate buffer",
+                   __FUNCTION__);
+        bucket->allocated++;
+        mFrameAllocs++;
+        LOGW("@%s : shortage of internal buffer, allocate a new one ", __FUNCTION__);
+    } else {
+        return nullptr;
+    }
+
+    unsigned int inUse = bucket->allocated - bucket->freeList.size();
+    if (inUse > bucket->peakInUse)
+        bucket->peakInUse = inUse;
+    if (bucket->freeList.size() < kLowWatermark)
+        requestRefillLocked(bucket);
+    l.unlock();
+
+    // reuse the Camerabuffer, just change the stream width and height
+    buffer->reConfig(w, h);
+
+    return wrap(bucket, buffer);
+}
+
+/**
+ * Hands out \a buffer through a shared_ptr whose deleter returns it to
+ * \a bucket, or frees it if the pool has been destroyed meanwhile.
+ */
+std::shared_ptr<CameraBuffer>
+InternalBufferPool::wrap(Bucket *bucket, std::shared_ptr<CameraBuffer> &buffer)
+{
+    std::weak_ptr<InternalBufferPool> weakPool = shared_from_this();
+    std::shared_ptr<CameraBuffer> owner = buffer;
+
+    return std::shared_ptr<CameraBuffer>(buffer.get(),
+        [weakPool, bucket, owner](CameraBuffer*) mutable {
+            std::shared_ptr<InternalBufferPool> pool = weakPool.lock();
+            if (pool.get() != nullptr)
+                pool->recycle(bucket, owner);
+            owner.reset();
+        });
+}
+
+void InternalBufferPool::recycle(Bucket *bucket, std::shared_ptr<CameraBuffer> &buffer)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    if (mExiting) {
+        bucket->allocated--;
+        return;
+    }
+    bucket->freeList.push_back(buffer);
+}
+
+/**
+ * Background allocation for one bucket, done with the lock dropped so that
+ * acquire/recycle are never blocked by gralloc.
+ */
+void InternalBufferPool::refill(std::unique_lock<std::mutex> &lock, Bucket *bucket)
+{
+    PERFORMANCE_ATRACE_NAME_SNPRINTF("RefillBufPool %dx%d", bucket->width, bucket->height);
+
+    while (!mExiting && bucket->allocated < kMaxBuffersPerBucket &&
+           (bucket->freeList.size() < kRefillTarget ||
+            bucket->allocated < bucket->reserved)) {
+        lock.unlock();
+        std::shared_ptr<CameraBuffer> buffer =
+            MemoryUtils::allocateHandleBuffer(bucket->width, bucket->height,
+                                              bucket->gfxFmt, bucket->usage);
+        lock.lock();
+        if (buffer.get() == nullptr) {
+            LOGE("@%s: failed to refill %dx%d bucket", __FUNCTION__,
+                 bucket->width, bucket->height);
+            break;
+        }
+        bucket->allocated++;
+        bucket->freeList.push_back(buffer);
+        mRefillAllocs++;
+    }
+    bucket->refillPending = false;
+}
+
+bool InternalBufferPool::trimmableLocked()
+{
+    for (auto &it : mBuckets) {
+        if (it->allocated > it->reserved && !it->freeList.empty())
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Releases free buffers above what each bucket needed since the previous
+ * trim. An unused bucket goes back to its reserved count.
+ */
+void InternalBufferPool::trim(std::unique_lock<std::mutex> &lock)
+{
+    std::vector<std::shared_ptr<CameraBuffer>> released;
+
+    for (auto &it : mBuckets) {
+        Bucket *b = it.get();
+        unsigned int target = b->reserved;
+        if (b->peakInUse > 0 && b->peakInUse + kLowWatermark > target)
+            target = b->peakInUse + kLowWatermark;
+
+        while (b->allocated > target && !b->freeList.empty()) {
+            released.push_back(b->freeList.back());
+            b->freeList.pop_back();
+            b->allocated--;
+            mTrimmed++;
+        }
+        b->peakInUse = b->allocated - b->freeList.size();
+    }
+
+    if (released.empty())
+        return;
+
+    LOGD("@%s: camera %d releasing %zu idle buffers", __FUNCTION__,
+         mCameraId, released.size());
+    lock.unlock();
+    released.clear();
+    lock.lock();
+}
+
+void InternalBufferPool::messageThreadLoop(void)
+{
+    std::unique_lock<std::mutex> l(mLock);
+
+    while (!mExiting) {
+        if (!mRefillQueue.empty()) {
+            Bucket *bucket = mRefillQueue.front();
+            mRefillQueue.pop_front();
+            refill(l, bucket);
+            continue;
+        }
+
+        if (!trimmableLocked()) {
+            mWorkCond.wait(l);
+            continue;
+        }
+
+        if (mWorkCond.wait_for(l, std::chrono::milliseconds(kTrimIntervalMs)) ==
+            std::cv_status::timeout && mRefillQueue.empty() && !mExiting)
+            trim(l);
+    }
+}
+
+void InternalBufferPool::dump()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    LOGI("@%s: camera %d frame allocs %u, dry acquires %u, refilled %u, trimmed %u",
+         __FUNCTION__, mCameraId, mFrameAllocs, mDryAcquires, mRefillAllocs, mTrimmed);
+    for (auto &it : mBuckets) {
+        LOGI("    bucket %dx%d fmt 0x%x: allocated %u, free %zu, reserved %u",
+             it->width, it->height, it->gfxFmt, it->allocated,
+             it->freeList.size(), it->reserved);
+    }
+}
+
+} /* namespace camera2 */
+} /* namespace android */
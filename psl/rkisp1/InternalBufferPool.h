@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PSL_RKISP1_INTERNALBUFFERPOOL_H_
+#define PSL_RKISP1_INTERNALBUFFERPOOL_H_
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include "MessageThread.h"
+#include "CameraBuffer.h"
+
+namespace android {
+namespace camera2 {
+
+/**
+ * \class InternalBufferPool
+ *
+ * Per-camera pool of internal gralloc buffers used by the post processing
+ * pipeline.
+ *
+ * Buffers are grouped in buckets keyed by (width, height, format, usage).
+ * A request for a WxH buffer is served from the smallest bucket of the
+ * same format/usage that is at least that big; the buffer is re-configured
+ * to the requested size. Buckets are created on demand when nothing fits.
+ *
+ * The frame path does not allocate in steady state:
+ *  - when the free list of a bucket drops below the low watermark a
+ *    background thread allocates more buffers for it,
+ *  - when a bucket is dry the caller never waits: it allocates at once
+ *    (logged as a warning), or gets nullptr if it may not allocate, and the
+ *    background thread refills the bucket for the next frames.
+ *
+ * When the pool is idle, buffers above the reserved count and above the
+ * recently observed working set are released by the same background thread.
+ *
+ * Buffers handed out keep the pool alive only weakly: a buffer released
+ * after the pool is gone is simply freed.
+ */
+class InternalBufferPool : public IMessageHandler,
+                           public std::enable_shared_from_this<InternalBufferPool> {
+public:
+    static std::shared_ptr<InternalBufferPool> create(int cameraId);
+    virtual ~InternalBufferPool();
+
+    status_t addBucket(int w, int h, int gfxFmt, int usage, int reserve);
+    /* lets idle trimming release every bucket down to what is in use */
+    void clearReservations();
+    std::shared_ptr<CameraBuffer> acquire(int w, int h, int gfxFmt, int usage,
+                                          bool allowAllocate = true);
+    void dump();
+
+    /* IMessageHandler overloads */
+    virtual void messageThreadLoop(void);
+
+private:
+    struct Bucket {
+        int width;
+        int height;
+        int gfxFmt;
+        int usage;
+        unsigned int reserved;  /*!< buffers never trimmed */
+        unsigned int allocated; /*!< buffers owned by the bucket, free or in use */
+        unsigned int peakInUse; /*!< max buffers in use since the last trim */
+        bool refillPending;
+        std::vector<std::shared_ptr<CameraBuffer>> freeList;
+    };
+
+    explicit InternalBufferPool(int cameraId);
+
+    Bucket* findBucketLocked(int w, int h, int gfxFmt, int usage, bool needFree);
+    Bucket* newBucketLocked(int w, int h, int gfxFmt, int usage, int reserve);
+    void requestRefillLocked(Bucket *bucket);
+    void refill(std::unique_lock<std::mutex> &lock, Bucket *bucket);
+    bool trimmableLocked();
+    void trim(std::unique_lock<std::mutex> &lock);
+    void recycle(Bucket *bucket, std::shared_ptr<CameraBuffer> &buffer);
+    std::shared_ptr<CameraBuffer> wrap(Bucket *bucket,
+                                       std::shared_ptr<CameraBuffer> &buffer);
+
+private:
+    static const unsigned int kLowWatermark = 1;
+    static const unsigned int kRefillTarget = 2;
+    static const unsigned int kMaxBuffersPerBucket = 16;
+    static const int kTrimIntervalMs = 3000;
+
+    int mCameraId;
+    std::mutex mLock;                   /*!< protects all the bucket state */
+    std::condition_variable mWorkCond;  /*!< wakes the background thread */
+    std::vector<std::unique_ptr<Bucket>> mBuckets;
+    std::deque<Bucket*> mRefillQueue;
+    bool mExiting;
+    std::unique_ptr<MessageThread> mMessageThread;
+
+    /* statistics */
+    unsigned int mFrameAllocs;  /*!< synchronous allocations on the frame path */
+    unsigned int mDryAcquires;  /*!< acquires that found their bucket dry */
+    unsigned int mRefillAllocs; /*!< buffers allocated by the background thread */
+    unsigned int mTrimmed;      /*!< buffers released by idle trimming */
+};
+
+} /* namespace camera2 */
+} /* namespace android */
+
+#endif  // PSL_RKISP1_INTERNALBUFFERPOOL_H_
@@ -21,7 +21,6 @@
 
 #include <CameraMetadata.h>
 #include <string>
-#include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <v4l2device.h>
@@ -1223,15 +1222,13 @@ std::vector<std::string> PSLConfParser::getMediaDeviceByName(std::string driverN
     const char *DEVICE_PATH = "/dev/";
 
     std::vector<std::string> mediaDevicePath;
-    DIR *dir;
-    dirent *dirEnt;
+    std::vector<std::string> entries;
 
     std::vector<std::string> candidates;
 
     candidates.clear();
-    if ((dir = opendir(DEVICE_PATH)) != nullptr) {
-        while ((dirEnt = readdir(dir)) != nullptr) {
-            std::string candidatePath = dirEnt->d_name;
+    if (SysCall::listDir(DEVICE_PATH, entries) == 0) {
+        for (const auto &candidatePath : entries) {
             std::size_t pos = candidatePath.find(MEDIADEVICES);
             if (pos != std::string::npos) {
                 LOGD("Found media device candidate: %s", candidatePath.c_str());
@@ -1240,7 +1237,6 @@ std::vector<std::string> PSLConfParser::getMediaDeviceByName(std::string driverN
                 candidates.push_back(found_one);
             }
         }
-        closedir(dir);
     } else {
         LOGW("Failed to open directory: %s", DEVICE_PATH);
     }
@@ -27,6 +27,7 @@
 #include "ControlUnit.h"
 #include "PSLConfParser.h"
 #include "TuningServer.h"
+#include "workers/ZslFrameRing.h"
 
 namespace android {
 namespace camera2 {
@@ -616,7 +617,10 @@ status_t RKISP1CameraHw::doConfigureStreams(UseCase newUseCase,
                         newUseCase == USECASE_STILL ? ControlUnit::FLUSH_FOR_STILLCAP :
                         ControlUnit::FLUSH_FOR_PREVIEW);
 
-    status = mImguUnit->configStreams(streams, mConfigChanged);
+    // ZSL only keeps JPEG frames the video sensor mode can stream; a JPEG
+    // that needs a slower mode is left to the still capture reconfiguration
+    bool zsl = newUseCase == USECASE_VIDEO && ZslFrameRing::configuredCapacity() > 0;
+    status = mImguUnit->configStreams(streams, mConfigChanged, zsl);
     if (status != NO_ERROR) {
         LOGE("Unable to configure stream for imgunit");
         return status;
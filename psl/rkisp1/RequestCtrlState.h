@@ -55,6 +55,8 @@ struct RequestCtrlState {
     bool mShutterMetaReceived;
     //imgunit process done
     bool mImgProcessDone;
+    //3A result of the ring frame a ZSL still encodes, merged over its own
+    std::shared_ptr<const CameraMetadata> mZslResult;
 };
 
 } // namespace camera2
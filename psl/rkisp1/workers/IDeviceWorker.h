@@ -33,6 +33,7 @@ enum DeviceMessageId {
     MESSAGE_COMPLETE_REQ,
     MESSAGE_ID_POLL,
     MESSAGE_ID_POLL_META,
+    MESSAGE_ID_POLL_RING,
     MESSAGE_ID_FLUSH,
     MESSAGE_ID_MAX
 };
@@ -42,6 +43,7 @@ const element_value_t ImguMsg_stringEnum[] = {
     {"MESSAGE_COMPLETE_REQ", MESSAGE_COMPLETE_REQ },
     {"MESSAGE_ID_POLL", MESSAGE_ID_POLL },
     {"MESSAGE_ID_POLL_META", MESSAGE_ID_POLL_META },
+    {"MESSAGE_ID_POLL_RING", MESSAGE_ID_POLL_RING },
     {"MESSAGE_ID_FLUSH", MESSAGE_ID_FLUSH },
     {"MESSAGE_ID_MAX", MESSAGE_ID_MAX },
 };
@@ -50,22 +52,22 @@ class MessageCallbackMetadata {
 public:
     Camera3Request* request;
     bool updateMeta;
+    bool zslShutter; /* the worker serving a ZSL still reports the shutter */
 
     MessageCallbackMetadata():
         request(nullptr),
-        updateMeta(false) {}
+        updateMeta(false),
+        zslShutter(false) {}
 };
 
 class MessagePollEvent {
 public:
     int requestId;
-    std::shared_ptr<V4L2VideoNode> *activeDevices;
     int polledDevices;
-    int numDevices;
+    int numDevices; /* devices with data, 0 when the poll failed */
     IPollEventListener::PollEventMessageId pollMsgId;
 
     MessagePollEvent() : requestId(-1),
-            activeDevices(nullptr),
             polledDevices(0),
             numDevices(0),
             pollMsgId(IPollEventListener::POLL_EVENT_ID_ERROR) {}
@@ -24,6 +24,7 @@
 #include "NodeTypes.h"
 #include <libyuv.h>
 #include <sys/mman.h>
+#include <algorithm>
 #include "FormatUtils.h"
 
 namespace android {
@@ -38,7 +39,12 @@ OutputFrameWorker::OutputFrameWorker(int cameraId, std::string name,
                 mNodeName(nodeName),
                 mLastPipelineDepth(pipelineDepth),
                 mPostPipeline(new PostProcessPipeLine(this, cameraId)),
-                mPostProcItemsPool("PostBufPool")
+                mPostProcItemsPool("PostBufPool"),
+                mZslEnabled(false),
+                mZslRing(cameraId),
+                mZslFrame(),
+                mFrameTimestamp(0),
+                mFrameSequence(-1)
 {
     LOGI("@%s, name:%s instance:%p, cameraId:%d", __FUNCTION__, name.data(), this, cameraId);
     mPostProcItemsPool.init(mPipelineDepth, PostProcBuffer::reset);
@@ -73,6 +79,7 @@ OutputFrameWorker::flushWorker()
     mPostPipeline->flush();
     mPostPipeline->stop();
     mPostWorkingBufs.clear();
+    mZslRing.deinit();
     clearListeners();
 
     return OK;
@@ -147,6 +154,106 @@ status_t OutputFrameWorker::configPostPipeLine()
     return OK;
 }
 
+/*
+ * Keeps the last frames for the JPEG streams fed by this node when
+ * persist.vendor.camera.zsl.frames asks for ZSL and the configuration
+ * allows it. Without the ring, still captures use the frame of their own
+ * request.
+ * The ring only takes frames the device wrote into it, so it needs the
+ * zero-copy path: with post processing the frame would have to be copied
+ * out of the V4L2 buffer on every request.
+ */
+void OutputFrameWorker::configZsl()
+{
+    mZslRing.deinit();
+
+    int frames = ZslFrameRing::configuredCapacity();
+    if (!mZslEnabled || frames == 0 || mStream == nullptr)
+        return;
+
+    bool hasBlob = mStream->format == HAL_PIXEL_FORMAT_BLOB;
+    for (auto* s : mListeners)
+        hasBlob |= s->format == HAL_PIXEL_FORMAT_BLOB;
+    if (!hasBlob)
+        return;
+
+    if (mNeedPostProcess || mNode->getMemoryType() == V4L2_MEMORY_MMAP) {
+        LOGI("@%s %s: no zero-copy output, no ZSL frames", __FUNCTION__, mName.c_str());
+        return;
+    }
+
+    // the frames in flight take slots too
+    frames += mPipelineDepth;
+    if (mZslRing.init(frames, mFormat, mNode->getMemoryType()) != OK)
+        LOGW("@%s %s: no ZSL frames, still captures wait for the next frame",
+             __FUNCTION__, mName.c_str());
+}
+
+void OutputFrameWorker::addZslResult(int reqId,
+                                     const std::shared_ptr<const CameraMetadata> &result)
+{
+    mZslRing.addResult(reqId, result);
+}
+
+/*
+ * A still may take a ring frame only when the app enabled ZSL and the frames
+ * captured before the request look like the one captured for it: no flash,
+ * no AE precapture and no manual exposure.
+ */
+static bool isZslAllowed(const CameraMetadata *settings)
+{
+#if defined(ANDROID_VERSION_ABOVE_8_X)
+    if (settings == nullptr)
+        return false;
+
+    camera_metadata_ro_entry entry = settings->find(ANDROID_CONTROL_ENABLE_ZSL);
+    if (entry.count != 1 || entry.data.u8[0] != ANDROID_CONTROL_ENABLE_ZSL_TRUE)
+        return false;
+
+    entry = settings->find(ANDROID_CONTROL_MODE);
+    if (entry.count == 1 && entry.data.u8[0] == ANDROID_CONTROL_MODE_OFF)
+        return false;
+
+    // AE off is manual exposure, the flash modes may fire
+    entry = settings->find(ANDROID_CONTROL_AE_MODE);
+    if (entry.count == 1 && entry.data.u8[0] != ANDROID_CONTROL_AE_MODE_ON)
+        return false;
+
+    entry = settings->find(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER);
+    if (entry.count == 1 &&
+        entry.data.u8[0] != ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE)
+        return false;
+
+    entry = settings->find(ANDROID_FLASH_MODE);
+    if (entry.count == 1 && entry.data.u8[0] != ANDROID_FLASH_MODE_OFF)
+        return false;
+
+    return true;
+#else
+    // ANDROID_CONTROL_ENABLE_ZSL came with Android 8
+    return false;
+#endif
+}
+
+/* true if |request| has a JPEG buffer of this worker to serve from the ring */
+bool OutputFrameWorker::isZslStill(Camera3Request* request)
+{
+    // reprocess requests are left to the InputFrameWorker
+    if (!mZslRing.isEnabled() || request->getInputBuffers()->size() > 0)
+        return false;
+
+    bool hasJpeg = false;
+    for (const auto &buf : *request->getOutputBuffers()) {
+        if (buf.stream->format != HAL_PIXEL_FORMAT_BLOB)
+            continue;
+        hasJpeg |= buf.stream == mStream ||
+                   std::find(mListeners.begin(), mListeners.end(), buf.stream) !=
+                   mListeners.end();
+    }
+
+    return hasJpeg && isZslAllowed(request->getSettings());
+}
+
 status_t OutputFrameWorker::configure(bool configChanged)
 {
     HAL_TRACE_CALL(CAM_GLBL_DBG_HIGH);
@@ -185,10 +292,11 @@ status_t OutputFrameWorker::configure(bool configChanged)
 
     } else {
         ret = configPostPipeLine();
-        if (!ret)
+        if (ret != OK)
             return ret;
     }
 
+    configZsl();
     return OK;
 }
 
@@ -210,6 +318,9 @@ status_t OutputFrameWorker::prepareRun(std::shared_ptr<DeviceMessage> msg)
 
     Camera3Request* request = mMsg->cbMetadataMsg.request;
     request->setSequenceId(-1);
+    // the shutter of a ZSL still is the one of the frame it gets
+    if (isZslStill(request))
+        mMsg->cbMetadataMsg.zslShutter = true;
 
     std::shared_ptr<PostProcBuffer> postbuffer= nullptr;
     if (mPostProcItemsPool.acquireItem(postbuffer)) {
@@ -250,6 +361,11 @@ status_t OutputFrameWorker::prepareRun(std::shared_ptr<DeviceMessage> msg)
     } else if ((mName == "RawWork") && mStream) {
         LOGI("@%s : Dump raw enabled", __FUNCTION__);
         mPollMe = true;
+    } else if (mZslRing.isEnabled()) {
+        // keep the ZSL frames coming for the still captures to come
+        LOGD("%s: stream %p works for ZSL only in req %d",
+             __FUNCTION__, mStream, request->getId());
+        mPollMe = true;
     } else {
         LOGD("No work for this worker mStream: %p", mStream);
         mPollMe = false;
@@ -269,7 +385,11 @@ status_t OutputFrameWorker::prepareRun(std::shared_ptr<DeviceMessage> msg)
          * buffers.
          */
         if (buffer.get() == nullptr) {
-            buffer = getOutputBufferForListener();
+            // have the frame written straight into the ZSL ring
+            if (mZslRing.isEnabled())
+                buffer = mZslRing.reserve();
+            if (buffer.get() == nullptr)
+                buffer = getOutputBufferForListener();
             CheckError((buffer.get() == nullptr), UNKNOWN_ERROR,
                        "failed to allocate listener buffer");
         }
@@ -319,6 +439,9 @@ status_t OutputFrameWorker::run()
         int sequence = outBuf.vbuffer.sequence();
         if (request->sequenceId() < sequence)
             request->setSequenceId(sequence);
+        struct timeval timestamp = outBuf.vbuffer.timestamp();
+        mFrameTimestamp = TIMEVAL2NSECS(&timestamp);
+        mFrameSequence = sequence;
 
         index = outBuf.vbuffer.index();
         mPostWorkingBuf = mPostWorkingBufs[index];
@@ -353,7 +476,20 @@ status_t OutputFrameWorker::run()
     outMsg.data.event.type = ICaptureEventListener::CAPTURE_EVENT_SHUTTER;
     outMsg.data.event.timestamp = outBuf.vbuffer.timestamp();
     outMsg.data.event.sequence = outBuf.vbuffer.sequence();
-    notifyListeners(&outMsg);
+
+    // a frame of the ring if this one was captured after the request came
+    mZslFrame = ZslFrameRing::Frame();
+    bool zslStill = isZslStill(request);
+    if (zslStill && !mDevError && mFrameTimestamp > request->arrivalTime() &&
+        mZslRing.select(request->arrivalTime(), &mZslFrame)) {
+        outMsg.data.event.timestamp.tv_sec = mZslFrame.timestamp / 1000000000;
+        outMsg.data.event.timestamp.tv_usec = (mZslFrame.timestamp % 1000000000) / 1000;
+        outMsg.data.event.sequence = mZslFrame.sequence;
+        outMsg.data.event.result = mZslFrame.result;
+    }
+    // the other workers leave the shutter of a ZSL still to its worker
+    if (zslStill || !mMsg->cbMetadataMsg.zslShutter)
+        notifyListeners(&outMsg);
 
     LOGD("%s: %s, frame_id(%d), requestId(%d), index(%d)", __FUNCTION__, mName.c_str(), outBuf.vbuffer.sequence(), request->getId(), index);
 
@@ -421,30 +557,33 @@ status_t OutputFrameWorker::postRun()
     if (status != OK)
         goto exit;
 
-    // All done
-    if (mOutputBuffer == nullptr) {
-        std::shared_ptr<PostProcBuffer> inPostBuf = std::make_shared<PostProcBuffer> ();
-        inPostBuf->cambuf = mPostWorkingBuf->cambuf;
-        inPostBuf->request = mPostWorkingBuf->request;
-        mPostPipeline->processFrame(inPostBuf, outBufs, mMsg->pMsg.processingSettings);
+    if (mOutputBuffer.get()) {
+        postOutBuf = std::make_shared<PostProcBuffer> ();
+        postOutBuf->cambuf = mOutputBuffer;
+        postOutBuf->request = request;
+        outBufs.push_back(postOutBuf);
+        postOutBuf = nullptr;
+    } else if (!outBufs.empty()) {
         LOGI("@%s %d: Only listener include a buffer", __FUNCTION__, __LINE__);
-        goto exit;
     }
-    postOutBuf = std::make_shared<PostProcBuffer> ();
-    postOutBuf->cambuf = mOutputBuffer;
-    postOutBuf->request = request;
-    outBufs.push_back(postOutBuf);
-    postOutBuf = nullptr;
+
+    if (mZslRing.isEnabled())
+        processZslFrame(request, outBufs);
 
     // can't pass mPostWorkingBuf to processFrame becasuse the life of
     // mPostWorkingBuf should not be managered by PostProcPine. if pass
     // mPostWorkingBuf directly to processFrame, acquire postproc buffer in
     // @prepareRun maybe failed dute to the shared_ptr of mPostWorkingBuf can be
     // held by PostProcPipeline
-    tempBuf->cambuf = mPostWorkingBuf->cambuf;
-    tempBuf->request = mPostWorkingBuf->request;
+    if (!outBufs.empty()) {
+        tempBuf->cambuf = mPostWorkingBuf->cambuf;
+        tempBuf->request = mPostWorkingBuf->request;
+        mPostPipeline->processFrame(tempBuf, outBufs, mMsg->pMsg.processingSettings);
+    }
 
-    mPostPipeline->processFrame(tempBuf, outBufs, mMsg->pMsg.processingSettings);
+    // All done
+    if (mOutputBuffer == nullptr)
+        goto exit;
     stream = mOutputBuffer->getOwner();
 
     // call captureDone for the stream of the buffer
@@ -458,6 +597,8 @@ exit:
     mMsg = nullptr;
     mOutputBuffer = nullptr;
     mPostWorkingBuf = nullptr;
+    // the ring may reuse the slot once the post processing is done with it
+    mZslFrame = ZslFrameRing::Frame();
 
     if (status != OK)
         returnBuffers(false);
@@ -465,6 +606,38 @@ exit:
     return status;
 }
 
+/**
+ * Gives the JPEG outputs of |outBufs| the ZSL frame run() picked for the
+ * request, if any, and removes them from |outBufs|, then adds the frame
+ * dequeued for this request to the ring if the device wrote it into a slot.
+ * run() already reported the timestamp and 3A result of the picked frame.
+ */
+void OutputFrameWorker::processZslFrame(Camera3Request* request,
+                                        std::vector<std::shared_ptr<PostProcBuffer>>& outBufs)
+{
+    std::vector<std::shared_ptr<PostProcBuffer>> jpegBufs;
+    for (auto it = outBufs.begin(); mZslFrame.buffer.get() && it != outBufs.end();) {
+        if ((*it)->cambuf->format() == HAL_PIXEL_FORMAT_BLOB) {
+            jpegBufs.push_back(*it);
+            it = outBufs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!jpegBufs.empty()) {
+        LOGI("@%s: req %d takes ZSL frame %d instead of %d", __FUNCTION__,
+             request->getId(), mZslFrame.sequence, mFrameSequence);
+        std::shared_ptr<PostProcBuffer> inPostBuf = std::make_shared<PostProcBuffer> ();
+        inPostBuf->cambuf = mZslFrame.buffer;
+        inPostBuf->request = request;
+        mPostPipeline->processFrame(inPostBuf, jpegBufs, mMsg->pMsg.processingSettings);
+    }
+
+    mZslRing.commit(mPostWorkingBuf->cambuf, mFrameTimestamp, mFrameSequence,
+                    request->getId());
+}
+
 void OutputFrameWorker::returnBuffers(bool returnListenerBuffers)
 {
     if (!mMsg || !mMsg->cbMetadataMsg.request)
@@ -23,6 +23,7 @@
 #include "tasks/JpegEncodeTask.h"
 #include "NodeTypes.h"
 #include "PostProcessPipeline.h"
+#include "ZslFrameRing.h"
 namespace android {
 namespace camera2 {
 
@@ -36,6 +37,9 @@ public:
     void addListener(camera3_stream_t* stream);
     void attachStream(camera3_stream_t* stream);
     void clearListeners();
+    /* keep ZSL frames for the JPEG streams from the next configure() on */
+    void enableZsl(bool enable) { mZslEnabled = enable; }
+    void addZslResult(int reqId, const std::shared_ptr<const CameraMetadata> &result);
     virtual status_t configure(bool configChanged);
     status_t prepareRun(std::shared_ptr<DeviceMessage> msg);
     status_t run();
@@ -54,6 +58,10 @@ private:
     std::shared_ptr<CameraBuffer> getOutputBufferForListener();
     void returnBuffers(bool returnListenerBuffers);
     status_t configPostPipeLine();
+    void configZsl();
+    bool isZslStill(Camera3Request* request);
+    void processZslFrame(Camera3Request* request,
+                         std::vector<std::shared_ptr<PostProcBuffer>>& outBufs);
 
 private:
     std::vector<std::shared_ptr<CameraBuffer>> mOutputBuffers;
@@ -71,6 +79,13 @@ private:
     SharedItemPool<PostProcBuffer> mPostProcItemsPool;
     std::vector<std::shared_ptr<PostProcBuffer>> mPostWorkingBufs;
     std::shared_ptr<PostProcBuffer> mPostWorkingBuf;
+
+    // Last frames of a node that feeds a JPEG stream, empty unless ZSL is on
+    bool mZslEnabled;
+    ZslFrameRing mZslRing;
+    ZslFrameRing::Frame mZslFrame; /*!< encoded for the request of run() */
+    nsecs_t mFrameTimestamp;    /*!< of the frame dequeued by run() */
+    int mFrameSequence;
 };
 
 } /* namespace camera2 */
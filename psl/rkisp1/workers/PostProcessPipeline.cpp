@@ -27,6 +27,14 @@
 #include "FormatUtils.h"
 #include "TuningServer.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SW_LSC_USE_NEON
+#elif defined(__GNUC__)
+#define SW_LSC_USE_VECTOR_EXT
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+#endif
+
 #define ALIGN(value, x)	 ((value + (x-1)) & (~(x-1)))
 
 // disable mirror handling by default
@@ -80,6 +88,13 @@ PostProcBufferPools::createBufferPools(PostProcessPipeLine* pl, const FrameInfo&
         postprocbuf->fmt = outfmt;
     }
 
+    // the buffers themselves are taken from the camera's internal pool
+    // when frames flow, have it allocate them meanwhile
+    if (MemoryUtils::reserveInternalBuffers(pl->getCameraId(), outfmt.width,
+                                            outfmt.height, numBufs) != OK)
+        LOGW("@%s: failed to reserve %dx%d buffers", __FUNCTION__,
+             outfmt.width, outfmt.height);
+
     return OK;
 }
 
@@ -538,11 +553,13 @@ PostProcessUnit::processFrame(const std::shared_ptr<PostProcBuffer>& in,
         if (RgaCropScale::CropScaleNV12Or21(&rgain, &rgaout)) {
             LOGE("%s:  crop&scale by RGA failed...", __FUNCTION__);
             PERFORMANCE_ATRACE_NAME("SWCropScale");
-            ImageScalerCore::cropComposeUpscaleNV12_bl(
+            ImageScalerCore::cropScaleNV12Or21(
                              in->cambuf->data(), in->cambuf->height(), in->cambuf->width(),
+                             rgain.fmt == HAL_PIXEL_FORMAT_YCrCb_420_SP,
                              cropleft, croptop, cropw, croph,
-                             out->cambuf->data(), out->cambuf->height(), out->cambuf->width(),
-                             0, 0, out->cambuf->width(), out->cambuf->height());
+                             out->cambuf->data(), out->cambuf->width(), out->cambuf->height(),
+                             out->cambuf->width(),
+                             rgaout.fmt == HAL_PIXEL_FORMAT_YCrCb_420_SP, mirror);
         }
     }
 
@@ -1545,8 +1562,8 @@ PostProcessUnitSwLsc::PostProcessUnitSwLsc(const char* name, int type,
 }
 
 PostProcessUnitSwLsc::~PostProcessUnitSwLsc() {
-    if (mLscPara.u32_coef_pic_gr)
-        free(mLscPara.u32_coef_pic_gr);
+    if (mLscPara.u16_coef_pic_gr)
+        free(mLscPara.u16_coef_pic_gr);
 }
 
 status_t
@@ -1583,8 +1600,11 @@ PostProcessUnitSwLsc::processFrame(const std::shared_ptr<PostProcBuffer>& in,
 
 status_t
 PostProcessUnitSwLsc::prepare(const FrameInfo& outfmt, int bufNum) {
-    if (mLscPara.u32_coef_pic_gr)
-        free(mLscPara.u32_coef_pic_gr);
+    if (mLscPara.u16_coef_pic_gr)
+        free(mLscPara.u16_coef_pic_gr);
+    mLscPara.u16_coef_pic_gr = NULL;
+    mLscPara.coef_pic_size = 0;
+    mLscPara.coef_pic_valid = false;
 
     mLscPara.width = outfmt.width;
     mLscPara.height = outfmt.height;
@@ -1637,8 +1657,8 @@ PostProcessUnitSwLsc::prepare(const FrameInfo& outfmt, int bufNum) {
  * @Purpose    bilinear interpolation unit
  *
  * @param   u16_coef_blk     input raw data
- * @param   pu32_coef_pic    output coef after bilinear interplation
- * @param   u32_z_max        the total number of lsc coef table
+ * @param   pu16_coef_pic    output coef after bilinear interplation
+ * @param   u32_z            the lsc coef table to expand
  * @param   u32_y_max        height of image
  * @param   u32_x_max        width of image
  * @param   plsc_a    other parameters
@@ -1650,18 +1670,16 @@ PostProcessUnitSwLsc::prepare(const FrameInfo& outfmt, int bufNum) {
 void
 PostProcessUnitSwLsc::calcu_coef(lsc_para_t const * plsc_a,
                                  uint16_t u16_coef_blk[2][17][18],
-                                 uint32_t * pu32_coef_pic,
-                                 uint32_t u32_z_max,
+                                 uint16_t * pu16_coef_pic,
+                                 uint32_t u32_z,
                                  uint32_t u32_y_max,
                                  uint32_t u32_x_max) {
     int32_t i             ;
     uint32_t u32_tmp      ;
-    uint32_t u32_tmp2     ;
     uint8_t  u8_x_blk     ; // u32_x coordinate of block number of curent picture
     uint8_t  u8_y_blk     ; // u32_y coordinate of block number of curent picture
     uint16_t u16_x_base   ; // left up coordinate of curent block
     uint16_t u16_y_base   ; // left up coordinate of curent block
-    uint16_t u16_x_offset ; // u32_x coordinate offset of curent block
     uint16_t u16_y_offset ; // u32_x coordinate offset of curent block
 
     uint16_t u16_sizey_cur ;
@@ -1674,66 +1692,282 @@ PostProcessUnitSwLsc::calcu_coef(lsc_para_t const * plsc_a,
     uint16_t u16_coef_rd   ; // right down
     uint32_t u32_coef_l    ;
     uint32_t u32_coef_r    ;
-    uint32_t u32_coef      ;
-
-    for (i = 0; i < 2; i++) {
-        for (u16_y_base = 0, u8_y_blk = 0; u8_y_blk < 16; u8_y_blk++) {
-            u16_sizey_cur = (u8_y_blk<8)? plsc_a->sizey[u8_y_blk] : plsc_a->sizey[15-u8_y_blk];
-            u16_grady_cur = (u8_y_blk<8)? plsc_a->grady[u8_y_blk] : plsc_a->grady[15-u8_y_blk];
-            for (u16_x_base = 0, u8_x_blk = 0; u8_x_blk < 16; u8_x_blk++) {
-                u16_sizex_cur = (u8_x_blk<8)? plsc_a->sizex[u8_x_blk] : plsc_a->sizex[15-u8_x_blk];
-                u16_gradx_cur = (u8_x_blk<8)? plsc_a->gradx[u8_x_blk] : plsc_a->gradx[15-u8_x_blk];
-                u16_coef_lu   = u16_coef_blk[i][u8_y_blk][u8_x_blk]     ; // left up
-                u16_coef_ld   = u16_coef_blk[i][u8_y_blk+1][u8_x_blk]   ; // left down
-                u16_coef_ru   = u16_coef_blk[i][u8_y_blk][u8_x_blk+1]   ; // right up
-                u16_coef_rd   = u16_coef_blk[i][u8_y_blk+1][u8_x_blk+1] ; // right down
-                for (u16_y_offset = 0; u16_y_offset < u16_sizey_cur; u16_y_offset++) {
-                    u32_tmp    = abs(u16_coef_lu - u16_coef_ld);
-                    u32_tmp    = u32_tmp * u16_grady_cur;
-                    u32_tmp    = (u32_tmp + c_dy_round) >> c_dy_shift;
-                    u32_tmp    = u32_tmp * u16_y_offset;
-                    u32_tmp    = (u32_tmp + c_extend_round) >> c_lsc_corr_extend;
-                    u32_tmp    = (u32_tmp << (32-c_lsc_corr_bw)) >> (32-c_lsc_corr_bw);
-                    u32_coef_l = u16_coef_lu << c_corr_diff;
-                    u32_coef_l = (u16_coef_lu > u16_coef_ld)? (u32_coef_l - u32_tmp) : (u32_coef_l + u32_tmp);
-
-                    u32_tmp    = abs(u16_coef_ru - u16_coef_rd);
-                    u32_tmp    = u32_tmp * u16_grady_cur;
-                    u32_tmp    = (u32_tmp + c_dy_round) >> c_dy_shift;
-                    u32_tmp    = u32_tmp * u16_y_offset;
-                    u32_tmp    = (u32_tmp + c_extend_round) >> c_lsc_corr_extend;
-                    u32_tmp    = (u32_tmp << (32-c_lsc_corr_bw)) >> (32-c_lsc_corr_bw);
-                    u32_coef_r = u16_coef_ru << c_corr_diff;
-                    u32_coef_r = (u16_coef_ru > u16_coef_rd)? (u32_coef_r - u32_tmp) : (u32_coef_r + u32_tmp);
-
-                    u32_coef   = u32_coef_l << c_lsc_corr_extend;
-                    /* TODO */
-                    //u32_tmp = abs(u32_coef_r - u32_coef_l);
-                    u32_tmp = abs(int32_t(u32_coef_r - u32_coef_l));
-                    u32_tmp = u32_tmp * u16_gradx_cur;
-                    u32_tmp = (u32_tmp + c_dx_round) >> c_dx_shift;
-                    for (u16_x_offset = 0; u16_x_offset < u16_sizex_cur; u16_x_offset++) {
-                        u32_tmp2 = (u32_coef + c_extend_round) >> c_lsc_corr_extend;
-                        u32_tmp2 = (u32_tmp2 > ((2<<c_lsc_corr_bw)-1))? ((2<<c_lsc_corr_bw)-1) : u32_tmp2;
-                        *(pu32_coef_pic + i*u32_y_max*u32_x_max + (u16_y_base+u16_y_offset)*u32_x_max
-                                + (u16_x_base+u16_x_offset)) = (uint16_t)u32_tmp2;
-                        u32_coef = (u32_coef_l > u32_coef_r)? (u32_coef - u32_tmp) : (u32_coef + u32_tmp);
-                    }   // for u16_x_offset
-                }   // for u16_y_offset
-                u16_x_base += u16_sizex_cur;
-            }   // for u8_x_blk
-            u16_y_base += u16_sizey_cur;
-        }   // for u8_y_blk
-    }   // for i < 2
+    uint16_t * pu16_row    ;
+
+    i = u32_z;
+    for (u16_y_base = 0, u8_y_blk = 0; u8_y_blk < 16; u8_y_blk++) {
+        u16_sizey_cur = (u8_y_blk<8)? plsc_a->sizey[u8_y_blk] : plsc_a->sizey[15-u8_y_blk];
+        u16_grady_cur = (u8_y_blk<8)? plsc_a->grady[u8_y_blk] : plsc_a->grady[15-u8_y_blk];
+        for (u16_x_base = 0, u8_x_blk = 0; u8_x_blk < 16; u8_x_blk++) {
+            u16_sizex_cur = (u8_x_blk<8)? plsc_a->sizex[u8_x_blk] : plsc_a->sizex[15-u8_x_blk];
+            u16_gradx_cur = (u8_x_blk<8)? plsc_a->gradx[u8_x_blk] : plsc_a->gradx[15-u8_x_blk];
+            u16_coef_lu   = u16_coef_blk[i][u8_y_blk][u8_x_blk]     ; // left up
+            u16_coef_ld   = u16_coef_blk[i][u8_y_blk+1][u8_x_blk]   ; // left down
+            u16_coef_ru   = u16_coef_blk[i][u8_y_blk][u8_x_blk+1]   ; // right up
+            u16_coef_rd   = u16_coef_blk[i][u8_y_blk+1][u8_x_blk+1] ; // right down
+            for (u16_y_offset = 0; u16_y_offset < u16_sizey_cur; u16_y_offset++) {
+                u32_tmp    = abs(u16_coef_lu - u16_coef_ld);
+                u32_tmp    = u32_tmp * u16_grady_cur;
+                u32_tmp    = (u32_tmp + c_dy_round) >> c_dy_shift;
+                u32_tmp    = u32_tmp * u16_y_offset;
+                u32_tmp    = (u32_tmp + c_extend_round) >> c_lsc_corr_extend;
+                u32_tmp    = (u32_tmp << (32-c_lsc_corr_bw)) >> (32-c_lsc_corr_bw);
+                u32_coef_l = u16_coef_lu << c_corr_diff;
+                u32_coef_l = (u16_coef_lu > u16_coef_ld)? (u32_coef_l - u32_tmp) : (u32_coef_l + u32_tmp);
+
+                u32_tmp    = abs(u16_coef_ru - u16_coef_rd);
+                u32_tmp    = u32_tmp * u16_grady_cur;
+                u32_tmp    = (u32_tmp + c_dy_round) >> c_dy_shift;
+                u32_tmp    = u32_tmp * u16_y_offset;
+                u32_tmp    = (u32_tmp + c_extend_round) >> c_lsc_corr_extend;
+                u32_tmp    = (u32_tmp << (32-c_lsc_corr_bw)) >> (32-c_lsc_corr_bw);
+                u32_coef_r = u16_coef_ru << c_corr_diff;
+                u32_coef_r = (u16_coef_ru > u16_coef_rd)? (u32_coef_r - u32_tmp) : (u32_coef_r + u32_tmp);
+
+                /* TODO */
+                //u32_tmp = abs(u32_coef_r - u32_coef_l);
+                u32_tmp = abs(int32_t(u32_coef_r - u32_coef_l));
+                u32_tmp = u32_tmp * u16_gradx_cur;
+                u32_tmp = (u32_tmp + c_dx_round) >> c_dx_shift;
+                pu16_row = pu16_coef_pic
+                           + (u16_y_base+u16_y_offset)*u32_x_max + u16_x_base;
+                coef_ramp(pu16_row, u32_coef_l << c_lsc_corr_extend, u32_tmp,
+                          u32_coef_l > u32_coef_r, u16_sizex_cur);
+            }   // for u16_y_offset
+            u16_x_base += u16_sizex_cur;
+        }   // for u8_x_blk
+        u16_y_base += u16_sizey_cur;
+    }   // for u8_y_blk
 }
 
+/*****************************************************************************/
+/**
+ * @Purpose    expand one block row of the correction factor
+ *
+ * The horizontal interpolation inside a block is a linear ramp starting at
+ * |coef| and moving by |step| per pixel, so the lanes can be seeded with
+ * coef + k * step and all advanced together. uint32 wrap-around is kept
+ * identical to the scalar reference.
+ *
+ * @param   dst         output coef, |count| entries
+ * @param   coef        start value, extended by c_lsc_corr_extend bits
+ * @param   step        per pixel increment
+ * @param   decrease    ramp downwards if true
+ * @param   count       number of pixels
+ *
+ *****************************************************************************/
+void
+PostProcessUnitSwLsc::coef_ramp_c(uint16_t* dst, uint32_t coef, uint32_t step,
+                                  bool decrease, uint32_t count) {
+    uint32_t u32_tmp;
+
+    for (uint32_t k = 0; k < count; k++) {
+        u32_tmp = (coef + c_extend_round) >> c_lsc_corr_extend;
+        u32_tmp = (u32_tmp > ((2<<c_lsc_corr_bw)-1))? ((2<<c_lsc_corr_bw)-1) : u32_tmp;
+        dst[k] = (uint16_t)u32_tmp;
+        coef = decrease ? (coef - step) : (coef + step);
+    }
+}
+
+void
+PostProcessUnitSwLsc::coef_ramp(uint16_t* dst, uint32_t coef, uint32_t step,
+                                bool decrease, uint32_t count) {
+    uint32_t k = 0;
+
+#if defined(SW_LSC_USE_NEON)
+    const uint32_t d = decrease ? (0u - step) : step;
+    const uint32_t lanes[4] = { coef, coef + d, coef + 2 * d, coef + 3 * d };
+    const uint32x4_t vstep = vdupq_n_u32(4 * d);
+    const uint32x4_t vround = vdupq_n_u32(c_extend_round);
+    const uint32x4_t vmax = vdupq_n_u32((2<<c_lsc_corr_bw)-1);
+    uint32x4_t v = vld1q_u32(lanes);
+
+    for (; k + 4 <= count; k += 4) {
+        uint32x4_t r = vshrq_n_u32(vaddq_u32(v, vround), c_lsc_corr_extend);
+        vst1_u16(dst + k, vmovn_u32(vminq_u32(r, vmax)));
+        v = vaddq_u32(v, vstep);
+    }
+    coef += k * d;
+#elif defined(SW_LSC_USE_VECTOR_EXT)
+    const uint32_t d = decrease ? (0u - step) : step;
+    const v4u32 vstep = { 4 * d, 4 * d, 4 * d, 4 * d };
+    const v4u32 vround = { c_extend_round, c_extend_round, c_extend_round, c_extend_round };
+    const v4u32 vmax = { (2<<c_lsc_corr_bw)-1, (2<<c_lsc_corr_bw)-1,
+                         (2<<c_lsc_corr_bw)-1, (2<<c_lsc_corr_bw)-1 };
+    v4u32 v = { coef, coef + d, coef + 2 * d, coef + 3 * d };
+
+    for (; k + 4 <= count; k += 4) {
+        v4u32 r = (v + vround) >> c_lsc_corr_extend;
+        v4u32 m = (v4u32)(r > vmax);
+        r = (r & ~m) | (vmax & m);
+        dst[k] = r[0];
+        dst[k + 1] = r[1];
+        dst[k + 2] = r[2];
+        dst[k + 3] = r[3];
+        v += vstep;
+    }
+    coef += k * d;
+#endif
+
+    coef_ramp_c(dst + k, coef, step, decrease, count - k);
+}
+
+/*****************************************************************************/
+/**
+ * @Purpose    apply the expanded correction factor to 8bit luma
+ *
+ * out = sat16(((in << 8) * coef + c_frac_round) >> c_lsc_corr_frac_bw) >> 8,
+ * the product can not overflow 32 bits as coef is 16 bits wide.
+ *
+ * @param   indata      input luma
+ * @param   coef        expanded correction factor, one per pixel
+ * @param   outdata     output luma
+ * @param   count       number of pixels
+ *
+ *****************************************************************************/
+void
+PostProcessUnitSwLsc::apply_coef_c(const uint8_t* indata, const uint16_t* coef,
+                                   uint8_t* outdata, uint32_t count) {
+    uint32_t u32_data;
+
+    for (uint32_t k = 0; k < count; k++) {
+        u32_data = ((uint32_t)indata[k] << 8) * coef[k];
+        u32_data = (u32_data + c_frac_round) >> c_lsc_corr_frac_bw;
+        u32_data = (u32_data > 0xffff) ? 0xffff : u32_data;
+        outdata[k] = u32_data >> 8;
+    }
+}
+
+void
+PostProcessUnitSwLsc::apply_coef(const uint8_t* indata, const uint16_t* coef,
+                                 uint8_t* outdata, uint32_t count) {
+    uint32_t k = 0;
+
+#if defined(SW_LSC_USE_NEON)
+    const uint32x4_t vround = vdupq_n_u32(c_frac_round);
+
+    for (; k + 16 <= count; k += 16) {
+        uint8x16_t d = vld1q_u8(indata + k);
+        uint16x8_t l = vshll_n_u8(vget_low_u8(d), 8);
+        uint16x8_t h = vshll_n_u8(vget_high_u8(d), 8);
+        uint16x8_t cl = vld1q_u16(coef + k);
+        uint16x8_t ch = vld1q_u16(coef + k + 8);
+        uint32x4_t r0 = vmlal_u16(vround, vget_low_u16(l), vget_low_u16(cl));
+        uint32x4_t r1 = vmlal_u16(vround, vget_high_u16(l), vget_high_u16(cl));
+        uint32x4_t r2 = vmlal_u16(vround, vget_low_u16(h), vget_low_u16(ch));
+        uint32x4_t r3 = vmlal_u16(vround, vget_high_u16(h), vget_high_u16(ch));
+        uint16x8_t s0 = vcombine_u16(vqshrn_n_u32(r0, c_lsc_corr_frac_bw),
+                                     vqshrn_n_u32(r1, c_lsc_corr_frac_bw));
+        uint16x8_t s1 = vcombine_u16(vqshrn_n_u32(r2, c_lsc_corr_frac_bw),
+                                     vqshrn_n_u32(r3, c_lsc_corr_frac_bw));
+        vst1q_u8(outdata + k, vcombine_u8(vshrn_n_u16(s0, 8), vshrn_n_u16(s1, 8)));
+    }
+#elif defined(SW_LSC_USE_VECTOR_EXT)
+    const v4u32 vround = { c_frac_round, c_frac_round, c_frac_round, c_frac_round };
+    const v4u32 vmax = { 0xffff, 0xffff, 0xffff, 0xffff };
+
+    for (; k + 4 <= count; k += 4) {
+        v4u32 c = { coef[k], coef[k + 1], coef[k + 2], coef[k + 3] };
+        v4u32 v = { indata[k], indata[k + 1], indata[k + 2], indata[k + 3] };
+        v = ((v << 8) * c + vround) >> c_lsc_corr_frac_bw;
+        v4u32 m = (v4u32)(v > vmax);
+        v = ((v & ~m) | (vmax & m)) >> 8;
+        outdata[k] = v[0];
+        outdata[k + 1] = v[1];
+        outdata[k + 2] = v[2];
+        outdata[k + 3] = v[3];
+    }
+#endif
+
+    apply_coef_c(indata + k, coef + k, outdata + k, count - k);
+}
+
+/*****************************************************************************/
+/**
+ * @Purpose    hash of everything the expanded coef plane depends on
+ *
+ *****************************************************************************/
+uint32_t
+PostProcessUnitSwLsc::coef_tables_hash(lsc_para_t const * plsc_a, uint8_t u8_z)
+{
+    // FNV-1a
+    uint32_t u32_hash = 2166136261u;
+    const uint8_t *pu8_data[5] = {
+        (const uint8_t *)plsc_a->u16_coef_gr[u8_z],
+        (const uint8_t *)plsc_a->sizex,
+        (const uint8_t *)plsc_a->sizey,
+        (const uint8_t *)plsc_a->gradx,
+        (const uint8_t *)plsc_a->grady,
+    };
+    const size_t size[5] = {
+        sizeof(plsc_a->u16_coef_gr[u8_z]),
+        sizeof(plsc_a->sizex),
+        sizeof(plsc_a->sizey),
+        sizeof(plsc_a->gradx),
+        sizeof(plsc_a->grady),
+    };
+
+    for (int i = 0; i < 5; i++) {
+        for (size_t j = 0; j < size[i]; j++) {
+            u32_hash ^= pu8_data[i][j];
+            u32_hash *= 16777619u;
+        }
+    }
+
+    return u32_hash;
+}
+
+/*****************************************************************************/
+/**
+ * @Purpose    expand the selected coef table to a full resolution plane
+ *
+ * The plane only depends on the image size and on the block tables, so it
+ * is kept across frames and rebuilt only when one of them changes.
+ *
+ * @return     0 on success, -1 if the plane can't be allocated
+ *
+ *****************************************************************************/
+int
+PostProcessUnitSwLsc::update_coef_pic(lsc_para_t *plsc_a, uint32_t u32_width,
+                                      uint32_t u32_height)
+{
+    uint8_t u8_z = plsc_a->table_sel & 0x1;
+    uint32_t u32_hash = coef_tables_hash(plsc_a, u8_z);
+
+    if (plsc_a->coef_pic_valid &&
+        plsc_a->coef_pic_width == u32_width &&
+        plsc_a->coef_pic_height == u32_height &&
+        plsc_a->coef_pic_table_sel == u8_z &&
+        plsc_a->coef_pic_hash == u32_hash)
+        return 0;
+
+    size_t size = ((u32_width + 0xf) & ~0xf) * ((u32_height + 0xf) & ~0xf);
+    if (plsc_a->u16_coef_pic_gr == NULL || plsc_a->coef_pic_size < size) {
+        free(plsc_a->u16_coef_pic_gr);
+        plsc_a->coef_pic_size = 0;
+        plsc_a->u16_coef_pic_gr = (uint16_t*)malloc(size * sizeof(uint16_t));
+        if (plsc_a->u16_coef_pic_gr == NULL)
+            return -1;
+        plsc_a->coef_pic_size = size;
+    }
+
+    LOGI("%s: expand coef table %d for %dx%d", __FUNCTION__, u8_z, u32_width, u32_height);
+    calcu_coef(plsc_a, plsc_a->u16_coef_gr, plsc_a->u16_coef_pic_gr,
+               u8_z, u32_height, u32_width);
+
+    plsc_a->coef_pic_width = u32_width;
+    plsc_a->coef_pic_height = u32_height;
+    plsc_a->coef_pic_table_sel = u8_z;
+    plsc_a->coef_pic_hash = u32_hash;
+    plsc_a->coef_pic_valid = true;
+
+    return 0;
+}
 
 int PostProcessUnitSwLsc::lsc_config(void *para_v)
 {
     lsc_para_t *para= (lsc_para_t*)para_v;
     int32_t i ,x,y,z;
-    int32_t width_align16 = (para->width + 0xf) & ~0xf;
-    int32_t height_align16 = (para->height + 0xf) & ~0xf;
     /* this is for 1080p */
     uint16_t sizex[8] = {120 ,120 ,120 ,120 ,120, 120, 120, 120};
     uint16_t sizey[8] = {67 ,68 ,67 ,68, 67, 68, 67, 68};
@@ -1862,10 +2096,8 @@ int PostProcessUnitSwLsc::lsc_config(void *para_v)
         }
     }
 
-    para->u32_coef_pic_gr = (uint32_t*)malloc(2* width_align16 * height_align16 * sizeof(uint32_t));
-
-    if (para->u32_coef_pic_gr == NULL)
-        return -1;
+    // tables changed, expand the coef plane again on next frame
+    para->coef_pic_valid = false;
 
     return 0;
 
@@ -1891,58 +2123,12 @@ PostProcessUnitSwLsc::lsc(uint8_t *indata, uint16_t input_h_size, uint16_t input
                           uint8_t bayer_pat, lsc_para_t *lsc_para,
                           uint8_t *outdata, uint8_t  c_dw_si)
 {
-    //input_h_size
-    int32_t     index = 0;
-    uint16_t     (*u16_coef_gr)[17][18] = lsc_para->u16_coef_gr;
-
-    uint32_t *u32_coef_pic_gr;
-
-    u32_coef_pic_gr = lsc_para->u32_coef_pic_gr;
-    calcu_coef(lsc_para, u16_coef_gr, u32_coef_pic_gr, 2, input_v_size, input_h_size);
+    if (update_coef_pic(lsc_para, input_h_size, input_v_size) != 0)
+        return -1;
 
     /* uint16_t c_dw_si_shift = (1 << c_dw_si) - 1; */
-    //lens shading correction
-#if 0
-    uint16_t     u16_data;
-    for (index = 0 ; index < input_v_size * input_h_size; index++) {
-            u16_data = (uint16_t)(indata[index]) << 8;
-            u16_data = (u16_data * u32_coef_pic_gr[index] + c_frac_round) >> c_lsc_corr_frac_bw;
-            /* u16_data = (u16_data > c_dw_si_shift)? c_dw_si_shift : u16_data; */
-            outdata[index] = u16_data >> 8;
-    }
-#else
-    /* uint32_t   total = input_v_size * input_h_size; */
-    /* const uint32_t   c_frac_round_tmp = c_frac_round; */
-    /* asm volatile ( */
-    /* "0:                                                                   \n\t" */
-    /* "vld1.u8 d0, [%[indata]]!       @uint8x8                              \n\t" */
-    /* "vshll.u8 q2, d0, #8              @uint16x8 << 8                      \n\t" */
-
-    /* "vmovl.u16 q3, d4               @uint16x8 --> uint32x4                \n\t" */
-    /* "vmovl.u16 q4, d5               @uint16x8 --> uint32x4                \n\t" */
-
-    /* "vld1.u32 {q0, q1}, [%[u32_coef_pic_gr]]!                             \n\t" */
-    /* "vdup.32 q6, %[c_frac_round_tmp]    @uint32x4 c_frac_round            \n\t" */
-    /* "vdup.32 q7, %[c_frac_round_tmp]  @uint32x4 c_frac_round              \n\t" */
-
-    /* "vmla.u32 q6, q3, q0                                                  \n\t " */
-    /* "vmla.u32 q7, q4, q1                                                  \n\t" */
-
-    /* "vqshrn.u32 d0, q6, #12                                               \n\t" */
-    /* "vqshrn.u32 d1, q7, #12                                               \n\t" */
-
-    /* "vqshrn.u16 d2, q0, #8                                                \n\t" */
-
-    /* "vst1.u8 d2, [%[outdata]]!                                            \n\t" */
-
-    /* "add %[index], %[index], #8                                           \n\t" */
-    /* "cmp %[index], %[total]                                               \n\t" */
-    /* "blt 0b                                                               \n\t" */
-    /* : [outdata] "+r" (outdata), [index] "+r" (index), [total] "+r" (total), [u32_coef_pic_gr] "+r" (u32_coef_pic_gr) */
-    /* : [indata] "r" (indata), [c_frac_round_tmp] "r" (c_frac_round_tmp) */
-    /* : "cc", "memory", "q0", "q1", "q2", "q3", "q4", "q5", "q6", "q7" */
-    /* ); */
-#endif
+    //lens shading correction, results are saturated to 8 bits
+    apply_coef(indata, lsc_para->u16_coef_pic_gr, outdata, input_v_size * input_h_size);
 
     return 0;
 }
@@ -2075,11 +2261,13 @@ PostProcessUnitDigitalZoom::processFrame(const std::shared_ptr<PostProcBuffer>&
     if (RgaCropScale::CropScaleNV12Or21(&rgain, &rgaout)) {
         LOGW("%s: digital zoom by RGA failed, use arm instead...", __FUNCTION__);
         PERFORMANCE_ATRACE_NAME("SWCropScale");
-        ImageScalerCore::cropComposeUpscaleNV12_bl(
+        ImageScalerCore::cropScaleNV12Or21(
                          in->cambuf->data(), in->cambuf->height(), in->cambuf->width(),
+                         rgain.fmt == HAL_PIXEL_FORMAT_YCrCb_420_SP,
                          mapleft, maptop, mapwidth, mapheight,
-                         out->cambuf->data(), out->cambuf->height(), out->cambuf->width(),
-                         0, 0, out->cambuf->width(), out->cambuf->height());
+                         out->cambuf->data(), out->cambuf->width(), out->cambuf->height(),
+                         out->cambuf->width(),
+                         rgaout.fmt == HAL_PIXEL_FORMAT_YCrCb_420_SP, mirror_handing);
     }
 
     return OK;
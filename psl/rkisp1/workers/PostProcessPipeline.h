@@ -308,15 +308,37 @@ class PostProcessUnitSwLsc : public PostProcessUnit
         uint8_t table_sel; // lesns shade correction coef table set selection
         uint32_t width;
         uint32_t height;
-        uint32_t *u32_coef_pic_gr;
+        /* expanded coef plane of table_sel, cached across frames */
+        uint16_t *u16_coef_pic_gr;
+        size_t coef_pic_size;
+        bool coef_pic_valid;
+        uint32_t coef_pic_width;
+        uint32_t coef_pic_height;
+        uint8_t coef_pic_table_sel;
+        uint32_t coef_pic_hash;
     } lsc_para_t;
 
     static void calcu_coef(lsc_para_t const * plsc_a,
                            uint16_t u16_coef_blk[2][17][18],
-                           uint32_t * pu32_coef_pic,
-                           uint32_t u32_z_max,
+                           uint16_t * pu16_coef_pic,
+                           uint32_t u32_z,
                            uint32_t u32_y_max,
                            uint32_t u32_x_max);
+    /*
+     * SIMD kernels, NEON on arm, gcc vector extensions elsewhere. The *_c
+     * variants are the scalar reference and also handle the row tails.
+     */
+    static void coef_ramp(uint16_t* dst, uint32_t coef, uint32_t step,
+                          bool decrease, uint32_t count);
+    static void coef_ramp_c(uint16_t* dst, uint32_t coef, uint32_t step,
+                            bool decrease, uint32_t count);
+    static void apply_coef(const uint8_t* indata, const uint16_t* coef,
+                           uint8_t* outdata, uint32_t count);
+    static void apply_coef_c(const uint8_t* indata, const uint16_t* coef,
+                             uint8_t* outdata, uint32_t count);
+    static uint32_t coef_tables_hash(lsc_para_t const * plsc_a, uint8_t u8_z);
+    static int update_coef_pic(lsc_para_t *plsc_a, uint32_t u32_width,
+                               uint32_t u32_height);
     static int lsc_config(void *para_v);
     static int lsc(uint8_t *indata, uint16_t input_h_size,
                    uint16_t input_v_size,
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ZslFrameRing"
+
+#include <stdlib.h>
+#include "LogHelper.h"
+#include "Camera3V4l2Format.h"
+#include "ZslFrameRing.h"
+
+namespace android {
+namespace camera2 {
+
+const int ZslFrameRing::kMaxCapacity;
+const size_t ZslFrameRing::kMaxResultsAhead;
+
+int ZslFrameRing::configuredCapacity()
+{
+    char property_value[PROPERTY_VALUE_MAX] = {0};
+    property_get("persist.vendor.camera.zsl.frames", property_value, "0");
+    int frames = atoi(property_value);
+    if (frames < 0)
+        frames = 0;
+    if (frames > kMaxCapacity) {
+        LOGW("@%s: %d ZSL frames asked, keeping %d", __FUNCTION__, frames, kMaxCapacity);
+        frames = kMaxCapacity;
+    }
+    return frames;
+}
+
+ZslFrameRing::ZslFrameRing(int cameraId) :
+    mCameraId(cameraId)
+{
+}
+
+ZslFrameRing::~ZslFrameRing()
+{
+    deinit();
+}
+
+status_t ZslFrameRing::init(int capacity, V4L2Format &format, int memType)
+{
+    deinit();
+
+    std::lock_guard<std::mutex> l(mLock);
+    for (int i = 0; i < capacity; i++) {
+        std::shared_ptr<CameraBuffer> buffer;
+        if (memType == V4L2_MEMORY_DMABUF) {
+            buffer = MemoryUtils::allocateHandleBuffer(
+                    format.width(),
+                    format.height(),
+                    HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                    GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_CAMERA_WRITE);
+        } else {
+            buffer = MemoryUtils::allocateHeapBuffer(
+                    format.width(),
+                    format.height(),
+                    format.bytesperline(),
+                    format.pixelformat(),
+                    mCameraId,
+                    format.sizeimage());
+        }
+        if (buffer.get() == nullptr || (!buffer->isLocked() && buffer->lock() != OK)) {
+            LOGE("@%s: failed to allocate ZSL frame %d", __FUNCTION__, i);
+            mSlots.clear();
+            return NO_MEMORY;
+        }
+
+        Slot slot;
+        slot.buffer = buffer;
+        slot.timestamp = -1;
+        slot.sequence = -1;
+        slot.requestId = -1;
+        mSlots.push_back(slot);
+    }
+
+    LOGI("@%s: %d frames of %dx%d %s", __FUNCTION__, capacity, format.width(),
+         format.height(), v4l2Fmt2Str(format.pixelformat()));
+    return OK;
+}
+
+void ZslFrameRing::deinit()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    // buffers still held are freed by their last holder
+    mSlots.clear();
+    mResults.clear();
+}
+
+bool ZslFrameRing::isEnabled()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    return !mSlots.empty();
+}
+
+ZslFrameRing::Slot *ZslFrameRing::reserveLocked()
+{
+    Slot *oldest = nullptr;
+    for (auto &slot : mSlots) {
+        if (slot.buffer.use_count() > 1)
+            continue;
+        if (oldest == nullptr || slot.timestamp < oldest->timestamp)
+            oldest = &slot;
+    }
+    if (oldest == nullptr)
+        return nullptr;
+
+    oldest->timestamp = -1;
+    oldest->sequence = -1;
+    oldest->requestId = -1;
+    return oldest;
+}
+
+std::shared_ptr<CameraBuffer> ZslFrameRing::reserve()
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Slot *slot = reserveLocked();
+    if (slot == nullptr) {
+        LOGW("@%s: all %zu ZSL frames are in use", __FUNCTION__, mSlots.size());
+        return nullptr;
+    }
+    return slot->buffer;
+}
+
+bool ZslFrameRing::commit(const std::shared_ptr<CameraBuffer> &buffer,
+                          nsecs_t timestamp, int sequence, int requestId)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    for (auto &slot : mSlots) {
+        if (slot.buffer == buffer) {
+            slot.timestamp = timestamp;
+            slot.sequence = sequence;
+            slot.requestId = requestId;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ZslFrameRing::addResult(int requestId,
+                             const std::shared_ptr<const CameraMetadata> &result)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    if (mSlots.empty() || result.get() == nullptr)
+        return;
+
+    mResults.push_back(std::make_pair(requestId, result));
+    while (mResults.size() > mSlots.size() + kMaxResultsAhead)
+        mResults.pop_front();
+}
+
+bool ZslFrameRing::select(nsecs_t timestamp, Frame *frame)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    Slot *best = nullptr;
+    for (auto &slot : mSlots) {
+        if (slot.timestamp < 0 || slot.timestamp >= timestamp)
+            continue;
+        if (best == nullptr || slot.timestamp > best->timestamp)
+            best = &slot;
+    }
+    if (best == nullptr)
+        return false;
+
+    frame->buffer = best->buffer;
+    frame->timestamp = best->timestamp;
+    frame->sequence = best->sequence;
+    frame->result = nullptr;
+    for (const auto &it : mResults) {
+        if (it.first == best->requestId)
+            frame->result = it.second;
+    }
+    return true;
+}
+
+} /* namespace camera2 */
+} /* namespace android */
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PSL_RKISP1_WORKERS_ZSLFRAMERING_H_
+#define PSL_RKISP1_WORKERS_ZSLFRAMERING_H_
+
+#include <CameraMetadata.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "CameraBuffer.h"
+#include "Utils.h"
+#include "v4l2device.h"
+
+namespace android {
+namespace camera2 {
+
+/**
+ * \class ZslFrameRing
+ *
+ * The last few full resolution frames of an output node, kept for zero
+ * shutter lag still captures: a JPEG request takes a frame captured before
+ * it arrived instead of waiting for the next one, and the pipeline no longer
+ * has to be reconfigured for stills.
+ *
+ * A frame only gets into the ring by the device writing it straight into a
+ * slot returned by reserve(), frames are never copied in. A slot is only
+ * reused once nobody else holds its buffer, so a frame handed out by
+ * select() stays intact until the post processing that reads it drops it.
+ * The 3A results of the frames are kept by request id, so a still taken
+ * from the ring reports the exposure of the frame that is encoded.
+ *
+ * Thread safe.
+ */
+class ZslFrameRing {
+public:
+    /* frames asked for with persist.vendor.camera.zsl.frames, 0 if ZSL is off */
+    static int configuredCapacity();
+
+    explicit ZslFrameRing(int cameraId);
+    ~ZslFrameRing();
+
+    /**
+     * Allocates |capacity| buffers for frames of |format|, of a kind that
+     * can back V4L2 buffers of |memType|.
+     */
+    status_t init(int capacity, V4L2Format &format, int memType);
+    void deinit();
+    bool isEnabled();
+
+    /* buffer of the oldest free slot, emptied; nullptr if all are held */
+    std::shared_ptr<CameraBuffer> reserve();
+    /**
+     * |buffer| from reserve() now holds the frame of request |requestId|
+     * captured at |timestamp|, false if |buffer| is not one of the ring
+     */
+    bool commit(const std::shared_ptr<CameraBuffer> &buffer, nsecs_t timestamp,
+                int sequence, int requestId);
+    /* 3A result of request |requestId|, may come before or after its frame */
+    void addResult(int requestId, const std::shared_ptr<const CameraMetadata> &result);
+
+    struct Frame {
+        std::shared_ptr<CameraBuffer> buffer;
+        nsecs_t timestamp;
+        int sequence;
+        std::shared_ptr<const CameraMetadata> result; /*!< nullptr if not known */
+    };
+
+    /**
+     * The newest frame captured before |timestamp|, false if there is none.
+     */
+    bool select(nsecs_t timestamp, Frame *frame);
+
+private:
+    struct Slot {
+        std::shared_ptr<CameraBuffer> buffer;
+        nsecs_t timestamp;  /*!< -1 while the slot holds no frame */
+        int sequence;
+        int requestId;
+    };
+
+    Slot *reserveLocked();
+
+private:
+    /* a full resolution frame is tens of MB */
+    static const int kMaxCapacity = 6;
+    /* results come up to a pipeline depth ahead of their frames */
+    static const size_t kMaxResultsAhead = 8;
+
+    int mCameraId;
+    std::mutex mLock;           /*!< protects mSlots and mResults */
+    std::vector<Slot> mSlots;
+    std::deque<std::pair<int, std::shared_ptr<const CameraMetadata>>> mResults;
+};
+
+} /* namespace camera2 */
+} /* namespace android */
+
+#endif /* PSL_RKISP1_WORKERS_ZSLFRAMERING_H_ */
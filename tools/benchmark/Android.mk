@@ -0,0 +1,185 @@
+#
+# Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Included from the top level Android.mk, LOCAL_PATH is the HAL root.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := tools/benchmark/CameraHalBenchmark.cpp
+
+LOCAL_C_INCLUDES += \
+    system/media/camera/include \
+    hardware/libhardware/include
+
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils \
+    libui \
+    libhardware \
+    libcamera_metadata \
+    libdl
+
+ifeq (1,$(strip $(shell expr $(PLATFORM_VERSION) \>= 8.0)))
+    LOCAL_SHARED_LIBRARIES += liblog
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+LOCAL_MODULE := camera_hal_benchmark
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    tools/benchmark/JpegEncodeBenchmark.cpp \
+    common/jpeg/jpeg_compressor.cpp \
+    common/jpeg/JpegStripEncoder.cpp \
+    common/imageProcess/ColorConvertKernels.cpp \
+    common/imageProcess/StripeExecutor.cpp \
+    common/LogHelper.cpp \
+    common/LogHelperAndroid.cpp \
+    common/EnumPrinthelper.cpp
+
+LOCAL_C_INCLUDES += \
+    system/core/include
+
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter
+LOCAL_CPPFLAGS += \
+    -DNAMESPACE_DECLARATION=namespace\ android\ {\namespace\ camera2 \
+    -DNAMESPACE_DECLARATION_END=} \
+    -DUSING_DECLARED_NAMESPACE=using\ namespace\ android::camera2 \
+    -I$(LOCAL_PATH)/common \
+    -I$(LOCAL_PATH)/common/jpeg \
+    -I$(LOCAL_PATH)/common/imageProcess
+
+LOCAL_STATIC_LIBRARIES := libyuv_static
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils \
+    libjpeg
+
+ifeq (1,$(strip $(shell expr $(PLATFORM_VERSION) \>= 8.0)))
+    LOCAL_SHARED_LIBRARIES += liblog
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+LOCAL_MODULE := camera_jpeg_benchmark
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    tools/benchmark/MessageQueueBenchmark.cpp \
+    common/LogHelper.cpp \
+    common/LogHelperAndroid.cpp \
+    common/EnumPrinthelper.cpp
+
+LOCAL_C_INCLUDES += \
+    system/core/include
+
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter
+LOCAL_CPPFLAGS += \
+    -DNAMESPACE_DECLARATION=namespace\ android\ {\namespace\ camera2 \
+    -DNAMESPACE_DECLARATION_END=} \
+    -DUSING_DECLARED_NAMESPACE=using\ namespace\ android::camera2 \
+    -I$(LOCAL_PATH)/common
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils
+
+ifeq (1,$(strip $(shell expr $(PLATFORM_VERSION) \>= 8.0)))
+    LOCAL_SHARED_LIBRARIES += liblog
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+LOCAL_MODULE := camera_msgqueue_benchmark
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    tools/benchmark/ColorConvertBenchmark.cpp \
+    common/imageProcess/ColorConvertKernels.cpp \
+    common/LogHelper.cpp \
+    common/LogHelperAndroid.cpp \
+    common/EnumPrinthelper.cpp
+
+LOCAL_C_INCLUDES += \
+    system/core/include
+
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter
+LOCAL_CPPFLAGS += \
+    -DNAMESPACE_DECLARATION=namespace\ android\ {\namespace\ camera2 \
+    -DNAMESPACE_DECLARATION_END=} \
+    -DUSING_DECLARED_NAMESPACE=using\ namespace\ android::camera2 \
+    -I$(LOCAL_PATH)/common \
+    -I$(LOCAL_PATH)/common/imageProcess
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils
+
+ifeq (1,$(strip $(shell expr $(PLATFORM_VERSION) \>= 8.0)))
+    LOCAL_SHARED_LIBRARIES += liblog
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+LOCAL_MODULE := camera_colorconvert_benchmark
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    tools/benchmark/BufferMappingCacheTest.cpp \
+    psl/rkisp1/BufferMappingCache.cpp \
+    common/LogHelper.cpp \
+    common/LogHelperAndroid.cpp \
+    common/EnumPrinthelper.cpp
+
+LOCAL_C_INCLUDES += \
+    system/core/include
+
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter
+LOCAL_CPPFLAGS += \
+    -DNAMESPACE_DECLARATION=namespace\ android\ {\namespace\ camera2 \
+    -DNAMESPACE_DECLARATION_END=} \
+    -DUSING_DECLARED_NAMESPACE=using\ namespace\ android::camera2 \
+    -I$(LOCAL_PATH)/common \
+    -I$(LOCAL_PATH)/include \
+    -I$(LOCAL_PATH)/psl/rkisp1
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils
+
+ifeq (1,$(strip $(shell expr $(PLATFORM_VERSION) \>= 8.0)))
+    LOCAL_SHARED_LIBRARIES += liblog
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+LOCAL_MODULE := camera_buffer_cache_test
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
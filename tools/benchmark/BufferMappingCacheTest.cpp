@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * camera_buffer_cache_test
+ *
+ * Checks that BufferMappingCache never hands out the mapping of a buffer
+ * the framework has freed when the handle address is reused for another
+ * buffer. Plain files stand in for the dma-bufs and the buffer manager is
+ * a fake that tracks registrations, so no gralloc is needed.
+ * The exit status is 2 if any check fails.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <set>
+
+#include "BufferMappingCache.h"
+#include "arc/camera_buffer_manager.h"
+
+using android::camera2::BufferMappingCache;
+
+namespace {
+
+class FakeBufferManager : public arc::CameraBufferManager {
+public:
+    int Allocate(size_t, size_t, uint32_t, uint32_t, arc::BufferType,
+                 buffer_handle_t*, uint32_t*) override { return -1; }
+    int Free(buffer_handle_t) override { return -1; }
+    int Register(buffer_handle_t buffer) override {
+        registered.insert(buffer);
+        imports++;
+        return 0;
+    }
+    int Deregister(buffer_handle_t buffer) override {
+        return registered.erase(buffer) ? 0 : -1;
+    }
+    int Lock(buffer_handle_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t,
+             void**) override { return -1; }
+    int LockYCbCr(buffer_handle_t, uint32_t, uint32_t, uint32_t, uint32_t,
+                  uint32_t, struct android_ycbcr*) override { return -1; }
+    int Unlock(buffer_handle_t) override { return 0; }
+    int FlushCache(buffer_handle_t) override { return 0; }
+    int InvalidateCache(buffer_handle_t) override { return 0; }
+    int GetHandleFd(buffer_handle_t buffer) override { return buffer->data[0]; }
+
+    std::set<buffer_handle_t> registered;
+    int imports = 0;
+};
+
+FakeBufferManager gManager;
+int gFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            gFailures++; \
+        } \
+    } while (0)
+
+/* a new "buffer": an unlinked file of its own */
+int newBufferFd()
+{
+    FILE *f = tmpfile();
+    if (f == nullptr)
+        return -1;
+    int fd = dup(fileno(f));
+    fclose(f);
+    return fd;
+}
+
+/* gives |handle| a new buffer, the way a freed and reallocated handle does */
+void replaceBuffer(native_handle_t *handle)
+{
+    close(handle->data[0]);
+    handle->data[0] = newBufferFd();
+}
+
+void testReusedAddress()
+{
+    BufferMappingCache cache;
+    native_handle_t *handle = native_handle_create(1, 2);
+    handle->data[0] = newBufferFd();
+    handle->data[1] = 640;
+    handle->data[2] = 480;
+
+    // imported once, then served from the cache
+    buffer_handle_t first = cache.acquire(handle);
+    CHECK(first != nullptr && first != handle);
+    CHECK(gManager.registered.count(first) == 1);
+    cache.setMapping(first, &gFailures, sizeof(gFailures));
+    cache.release(first);
+    CHECK(cache.acquire(handle) == first);
+    CHECK(gManager.imports == 1);
+    cache.release(first);
+
+    // same address, another buffer: the old clone and mapping must go
+    replaceBuffer(handle);
+    buffer_handle_t second = cache.acquire(handle);
+    CHECK(second != nullptr);
+    CHECK(gManager.imports == 2 && gManager.registered.size() == 1);
+    void *data = nullptr;
+    unsigned int size = 0;
+    CHECK(!cache.getMapping(second, &data, &size));
+
+    // replaced while in use: the old clone lives until it is released
+    replaceBuffer(handle);
+    buffer_handle_t third = cache.acquire(handle);
+    CHECK(third != nullptr && third != second);
+    CHECK(gManager.imports == 3 && gManager.registered.count(second) == 1);
+    cache.release(second);
+    CHECK(gManager.registered.count(second) == 0);
+    cache.release(third);
+
+    // same fd and file, other ints: what two buffers sharing an inode look like
+    handle->data[1] = 1280;
+    handle->data[2] = 720;
+    buffer_handle_t fourth = cache.acquire(handle);
+    CHECK(fourth != nullptr);
+    CHECK(gManager.imports == 4 && gManager.registered.size() == 1);
+    cache.release(fourth);
+
+    // identical contents are the same buffer
+    CHECK(cache.acquire(handle) == fourth);
+    CHECK(gManager.imports == 4);
+    cache.release(fourth);
+
+    cache.clear();
+    CHECK(gManager.registered.empty());
+
+    native_handle_close(handle);
+    native_handle_delete(handle);
+}
+
+void testUnsupportedKernel()
+{
+    BufferMappingCache cache;
+    native_handle_t *handle = native_handle_create(1, 0);
+    handle->data[0] = newBufferFd();
+
+    CHECK(cache.acquire(handle) == nullptr);
+    CHECK(gManager.registered.empty());
+
+    native_handle_close(handle);
+    native_handle_delete(handle);
+}
+
+} // namespace
+
+namespace arc {
+
+CameraBufferManager* CameraBufferManager::GetInstance()
+{
+    return &gManager;
+}
+
+} // namespace arc
+
+int main()
+{
+    if (BufferMappingCache::isSupported()) {
+        testReusedAddress();
+    } else {
+        fprintf(stderr, "no per-buffer dma-buf inodes, checking the cache is off\n");
+        testUnsupportedKernel();
+    }
+
+    fprintf(stderr, "%s, %d failures\n", gFailures ? "FAILED" : "passed", gFailures);
+    return gFailures ? 2 : 0;
+}
@@ -0,0 +1,1058 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * camera_hal_benchmark
+ *
+ * Drives the camera HAL through the camera3 device API with scripted stream
+ * configurations and reports, per scenario, request to shutter and request
+ * to final result latency, sustained frame rate, frame interval jitter and
+ * the CPU time the process spent per frame. The report is JSON so runs can
+ * be kept and compared over time.
+ *
+ * Scenarios:
+ *  preview        one preview stream
+ *  preview_video  preview and video record streams
+ *  jpeg_burst     preview and a JPEG on every request
+ *  reprocess      a YUV capture fed back as the input of a JPEG request
+ *
+ * With --virtual the HAL runs over the virtual rkisp1 kernel (see
+ * VirtualKernel), so no camera hardware is needed. That needs an eng or
+ * userdebug build of the HAL. vendor.camera.virtual is only set while the
+ * benchmark runs.
+ *
+ * It runs on the device only: the HAL is loaded with hw_get_module() and the
+ * stream buffers are gralloc GraphicBuffers, and neither exists on a host.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cutils/properties.h>
+#include <hardware/camera3.h>
+#include <hardware/gralloc.h>
+#include <hardware/hardware.h>
+#include <system/camera_metadata.h>
+#include <ui/GraphicBuffer.h>
+
+using android::GraphicBuffer;
+using android::sp;
+
+namespace {
+
+const int kBufferTimeoutMs = 5000;      /* no buffer came back in time */
+const int kResultTimeoutMs = 5000;      /* no result came back in time */
+
+struct Options {
+    const char *halPath;
+    int cameraId;
+    int frames;
+    int warmup;
+    int previewWidth;
+    int previewHeight;
+    int videoWidth;
+    int videoHeight;
+    bool useVirtual;
+    const char *outPath;
+    std::vector<std::string> scenarios;
+};
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t cpuTimeNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((int64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL +
+           ((int64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+bool parseSize(const char *str, int *width, int *height)
+{
+    return sscanf(str, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+}
+
+/**
+ * Sets a system property for the lifetime of the object, then puts the
+ * previous value back.
+ */
+class ScopedProperty {
+public:
+    ScopedProperty(const char *name, const char *value) :
+        mName(name)
+    {
+        char old[PROPERTY_VALUE_MAX] = {0};
+        property_get(name, old, "");
+        mOldValue = old;
+        mSet = property_set(name, value) == 0;
+    }
+
+    ~ScopedProperty()
+    {
+        if (mSet && property_set(mName.c_str(), mOldValue.c_str()) != 0)
+            fprintf(stderr, "failed to restore %s to \"%s\"\n", mName.c_str(),
+                    mOldValue.c_str());
+    }
+
+    bool isSet() const { return mSet; }
+
+private:
+    std::string mName;
+    std::string mOldValue;
+    bool mSet;
+};
+
+/**
+ * Summary of a set of samples in milliseconds, percentiles by nearest rank.
+ */
+struct Stats {
+    size_t count;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double stddev;
+
+    explicit Stats(std::vector<int64_t> samplesNs) :
+        count(samplesNs.size()), mean(0), p50(0), p90(0), p99(0), max(0), stddev(0)
+    {
+        if (samplesNs.empty())
+            return;
+
+        std::sort(samplesNs.begin(), samplesNs.end());
+        double sum = 0;
+        for (int64_t s : samplesNs)
+            sum += s;
+        mean = sum / count;
+        double var = 0;
+        for (int64_t s : samplesNs)
+            var += (s - mean) * (s - mean);
+        stddev = sqrt(var / count) / 1e6;
+        mean /= 1e6;
+        p50 = percentile(samplesNs, 50);
+        p90 = percentile(samplesNs, 90);
+        p99 = percentile(samplesNs, 99);
+        max = samplesNs.back() / 1e6;
+    }
+
+    static double percentile(const std::vector<int64_t> &sorted, int p)
+    {
+        size_t rank = (sorted.size() * p + 99) / 100;
+        if (rank > 0)
+            rank--;
+        return sorted[std::min(rank, sorted.size() - 1)] / 1e6;
+    }
+
+    std::string toJson() const
+    {
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "{\"count\": %zu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+                 "\"p99\": %.3f, \"max\": %.3f, \"stddev\": %.3f}",
+                 count, mean, p50, p90, p99, max, stddev);
+        return buf;
+    }
+};
+
+/**
+ * Gralloc buffers of one stream, handed to the HAL and back.
+ */
+class BufferPool {
+public:
+    int allocate(camera3_stream_t *stream, int count, uint32_t width,
+                 uint32_t height, uint32_t usage)
+    {
+        for (int i = 0; i < count; i++) {
+            sp<GraphicBuffer> gb = new GraphicBuffer(width, height,
+                                                     stream->format, usage);
+            if (gb->initCheck() != android::NO_ERROR) {
+                fprintf(stderr, "failed to allocate %ux%u format 0x%x usage 0x%x\n",
+                        width, height, stream->format, usage);
+                return -ENOMEM;
+            }
+            mBuffers.push_back(gb);
+            mFree.push_back(&mBuffers.back()->handle);
+        }
+        return 0;
+    }
+
+    buffer_handle_t *acquire()
+    {
+        std::unique_lock<std::mutex> l(mLock);
+        if (!mCond.wait_for(l, std::chrono::milliseconds(kBufferTimeoutMs),
+                            [this] { return !mFree.empty(); }))
+            return nullptr;
+        buffer_handle_t *handle = mFree.back();
+        mFree.pop_back();
+        return handle;
+    }
+
+    /* takes a buffer that is known to be free */
+    bool take(buffer_handle_t *handle)
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        auto it = std::find(mFree.begin(), mFree.end(), handle);
+        if (it == mFree.end())
+            return false;
+        mFree.erase(it);
+        return true;
+    }
+
+    void release(buffer_handle_t *handle)
+    {
+        {
+            std::lock_guard<std::mutex> l(mLock);
+            mFree.push_back(handle);
+        }
+        mCond.notify_one();
+    }
+
+private:
+    std::vector<sp<GraphicBuffer>> mBuffers;
+    std::vector<buffer_handle_t*> mFree;
+    std::mutex mLock;
+    std::condition_variable mCond;
+};
+
+struct StreamSpec {
+    int streamType;
+    int format;
+    int width;
+    int height;
+    uint32_t usage;         /* consumer side usage, as the framework sets it */
+};
+
+struct Scenario {
+    std::string name;
+    int requestTemplate;
+    std::vector<StreamSpec> streams;
+    std::vector<int> outputs;   /* streams every request fills */
+    bool reprocess;
+};
+
+/**
+ * What the HAL said about one request.
+ */
+struct FrameRecord {
+    int kind;               /* index in Benchmark::kKindNames */
+    int64_t requestNs;
+    int64_t shutterNs;
+    int64_t sensorTs;
+    int64_t finalNs;
+    int pendingBuffers;
+    bool inputPending;
+    bool metadataDone;
+    bool error;
+};
+
+class Benchmark : public camera3_callback_ops {
+public:
+    enum {
+        KIND_CAPTURE,
+        KIND_REPROCESS,
+        KIND_COUNT
+    };
+
+    Benchmark(const Options &options, camera_module_t *module) :
+        mOptions(options),
+        mModule(module),
+        mDevice(nullptr),
+        mStaticMeta(nullptr),
+        mPartialResultCount(1),
+        mJpegMaxSize(0),
+        mInputPool(nullptr),
+        mCompleted(0)
+    {
+        camera3_callback_ops::process_capture_result = sProcessCaptureResult;
+        camera3_callback_ops::notify = sNotify;
+    }
+
+    int init();
+    std::string run(const Scenario &scenario);
+    bool buildScenario(const std::string &name, Scenario *scenario);
+
+private:
+    static void sProcessCaptureResult(const camera3_callback_ops *ops,
+                                      const camera3_capture_result *result);
+    static void sNotify(const camera3_callback_ops *ops,
+                        const camera3_notify_msg *msg);
+    void processCaptureResult(const camera3_capture_result *result);
+    void notify(const camera3_notify_msg *msg);
+
+    bool findSize(int format, int maxWidth, int maxHeight, int *width, int *height);
+    int openDevice();
+    void closeDevice();
+    int submit(uint32_t frameNumber, int kind, const camera_metadata_t *settings,
+               camera3_stream_buffer_t *input,
+               std::vector<camera3_stream_buffer_t> &outputs);
+    bool waitFrame(uint32_t frameNumber);
+    bool waitAll();
+    std::string report(const Scenario &scenario,
+                       const std::vector<camera3_stream_t> &streams,
+                       int64_t cpuNs, const char *error);
+
+private:
+    static const char *kKindNames[KIND_COUNT];
+
+    const Options &mOptions;
+    camera_module_t *mModule;
+    camera3_device_t *mDevice;
+    const camera_metadata_t *mStaticMeta;
+    int mPartialResultCount;
+    int mJpegMaxSize;
+
+    std::map<camera3_stream_t*, std::unique_ptr<BufferPool>> mPools;
+    /* pool the input buffers of reprocess requests go back to */
+    BufferPool *mInputPool;
+
+    std::mutex mLock;               /* protects the frame records */
+    std::condition_variable mCond;
+    std::map<uint32_t, FrameRecord> mFrames;
+    uint32_t mCompleted;
+};
+
+const char *Benchmark::kKindNames[KIND_COUNT] = { "capture", "reprocess" };
+
+void Benchmark::sProcessCaptureResult(const camera3_callback_ops *ops,
+                                      const camera3_capture_result *result)
+{
+    const_cast<Benchmark*>(static_cast<const Benchmark*>(ops))->processCaptureResult(result);
+}
+
+void Benchmark::sNotify(const camera3_callback_ops *ops,
+                        const camera3_notify_msg *msg)
+{
+    const_cast<Benchmark*>(static_cast<const Benchmark*>(ops))->notify(msg);
+}
+
+void Benchmark::processCaptureResult(const camera3_capture_result *result)
+{
+    int64_t now = nowNs();
+
+    for (uint32_t i = 0; i < result->num_output_buffers; i++) {
+        const camera3_stream_buffer_t &buf = result->output_buffers[i];
+        auto pool = mPools.find(buf.stream);
+        if (pool != mPools.end())
+            pool->second->release(buf.buffer);
+    }
+    if (result->input_buffer != nullptr && mInputPool != nullptr)
+        mInputPool->release(result->input_buffer->buffer);
+
+    std::lock_guard<std::mutex> l(mLock);
+    auto it = mFrames.find(result->frame_number);
+    if (it == mFrames.end()) {
+        fprintf(stderr, "result for unknown frame %u\n", result->frame_number);
+        return;
+    }
+    FrameRecord &frame = it->second;
+    bool wasDone = frame.finalNs != 0;
+
+    frame.pendingBuffers -= result->num_output_buffers;
+    for (uint32_t i = 0; i < result->num_output_buffers; i++) {
+        if (result->output_buffers[i].status != CAMERA3_BUFFER_STATUS_OK)
+            frame.error = true;
+    }
+    if (result->input_buffer != nullptr)
+        frame.inputPending = false;
+    if (result->result != nullptr &&
+        (int)result->partial_result >= mPartialResultCount)
+        frame.metadataDone = true;
+
+    if (!wasDone && frame.pendingBuffers <= 0 && !frame.inputPending &&
+        (frame.metadataDone || frame.error)) {
+        frame.finalNs = now;
+        mCompleted++;
+        mCond.notify_all();
+    }
+}
+
+void Benchmark::notify(const camera3_notify_msg *msg)
+{
+    int64_t now = nowNs();
+    std::lock_guard<std::mutex> l(mLock);
+
+    if (msg->type == CAMERA3_MSG_SHUTTER) {
+        auto it = mFrames.find(msg->message.shutter.frame_number);
+        if (it != mFrames.end()) {
+            it->second.shutterNs = now;
+            it->second.sensorTs = msg->message.shutter.timestamp;
+        }
+    } else if (msg->type == CAMERA3_MSG_ERROR) {
+        auto it = mFrames.find(msg->message.error.frame_number);
+        if (it == mFrames.end())
+            return;
+        FrameRecord &frame = it->second;
+        frame.error = true;
+        // no metadata follows these, buffers still come back with errors
+        if (msg->message.error.error_code == CAMERA3_MSG_ERROR_REQUEST ||
+            msg->message.error.error_code == CAMERA3_MSG_ERROR_RESULT)
+            frame.metadataDone = true;
+        if (frame.finalNs == 0 && frame.pendingBuffers <= 0 && !frame.inputPending) {
+            frame.finalNs = now;
+            mCompleted++;
+            mCond.notify_all();
+        }
+    }
+}
+
+int Benchmark::init()
+{
+    int cameras = mModule->get_number_of_cameras();
+    if (mOptions.cameraId >= cameras) {
+        fprintf(stderr, "camera %d not found, %d cameras\n", mOptions.cameraId, cameras);
+        return -ENODEV;
+    }
+
+    struct camera_info info;
+    memset(&info, 0, sizeof(info));
+    int status = mModule->get_camera_info(mOptions.cameraId, &info);
+    if (status != 0 || info.static_camera_characteristics == nullptr) {
+        fprintf(stderr, "failed to get info of camera %d (%d)\n", mOptions.cameraId, status);
+        return status != 0 ? status : -ENODEV;
+    }
+    mStaticMeta = info.static_camera_characteristics;
+
+    camera_metadata_ro_entry_t entry;
+    if (find_camera_metadata_ro_entry(mStaticMeta, ANDROID_REQUEST_PARTIAL_RESULT_COUNT,
+                                      &entry) == 0 && entry.count == 1)
+        mPartialResultCount = entry.data.i32[0];
+    if (find_camera_metadata_ro_entry(mStaticMeta, ANDROID_JPEG_MAX_SIZE,
+                                      &entry) == 0 && entry.count == 1)
+        mJpegMaxSize = entry.data.i32[0];
+
+    return 0;
+}
+
+/**
+ * Largest output size of the format that fits in maxWidth x maxHeight,
+ * any size when those are 0.
+ */
+bool Benchmark::findSize(int format, int maxWidth, int maxHeight,
+                         int *width, int *height)
+{
+    camera_metadata_ro_entry_t entry;
+    if (find_camera_metadata_ro_entry(mStaticMeta,
+                                      ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS,
+                                      &entry) != 0)
+        return false;
+
+    int64_t best = 0;
+    for (size_t i = 0; i + 3 < entry.count; i += 4) {
+        const int32_t *cfg = &entry.data.i32[i];
+        if (cfg[0] != format ||
+            cfg[3] != ANDROID_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT)
+            continue;
+        if (maxWidth > 0 && (cfg[1] > maxWidth || cfg[2] > maxHeight))
+            continue;
+        int64_t area = (int64_t)cfg[1] * cfg[2];
+        if (area > best) {
+            best = area;
+            *width = cfg[1];
+            *height = cfg[2];
+        }
+    }
+    return best > 0;
+}
+
+bool Benchmark::buildScenario(const std::string &name, Scenario *scenario)
+{
+    int pw = mOptions.previewWidth, ph = mOptions.previewHeight;
+    if (pw == 0 && !findSize(HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, 1920, 1080, &pw, &ph))
+        return false;
+
+    StreamSpec preview = { CAMERA3_STREAM_OUTPUT, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                           pw, ph, GRALLOC_USAGE_HW_TEXTURE };
+
+    scenario->name = name;
+    scenario->reprocess = false;
+    scenario->streams.clear();
+    scenario->outputs.clear();
+
+    if (name == "preview") {
+        scenario->requestTemplate = CAMERA3_TEMPLATE_PREVIEW;
+        scenario->streams.push_back(preview);
+    } else if (name == "preview_video") {
+        int vw = mOptions.videoWidth, vh = mOptions.videoHeight;
+        if (vw == 0 && !findSize(HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, 1920, 1080, &vw, &vh))
+            return false;
+        StreamSpec video = { CAMERA3_STREAM_OUTPUT, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+                             vw, vh, GRALLOC_USAGE_HW_VIDEO_ENCODER };
+        scenario->requestTemplate = CAMERA3_TEMPLATE_VIDEO_RECORD;
+        scenario->streams.push_back(preview);
+        scenario->streams.push_back(video);
+    } else if (name == "jpeg_burst") {
+        int jw, jh;
+        if (!findSize(HAL_PIXEL_FORMAT_BLOB, 0, 0, &jw, &jh))
+            return false;
+        StreamSpec jpeg = { CAMERA3_STREAM_OUTPUT, HAL_PIXEL_FORMAT_BLOB,
+                            jw, jh, GRALLOC_USAGE_SW_READ_OFTEN };
+        scenario->requestTemplate = CAMERA3_TEMPLATE_STILL_CAPTURE;
+        scenario->streams.push_back(preview);
+        scenario->streams.push_back(jpeg);
+    } else if (name == "reprocess") {
+        int yw, yh, jw, jh;
+        if (!findSize(HAL_PIXEL_FORMAT_YCbCr_420_888, 0, 0, &yw, &yh) ||
+            !findSize(HAL_PIXEL_FORMAT_BLOB, 0, 0, &jw, &jh))
+            return false;
+        // the yuv buffers are captured into and then sent back as input
+        StreamSpec input = { CAMERA3_STREAM_INPUT, HAL_PIXEL_FORMAT_YCbCr_420_888,
+                             yw, yh, 0 };
+        StreamSpec yuv = { CAMERA3_STREAM_OUTPUT, HAL_PIXEL_FORMAT_YCbCr_420_888,
+                           yw, yh, GRALLOC_USAGE_SW_READ_OFTEN };
+        StreamSpec jpeg = { CAMERA3_STREAM_OUTPUT, HAL_PIXEL_FORMAT_BLOB,
+                            jw, jh, GRALLOC_USAGE_SW_READ_OFTEN };
+        scenario->requestTemplate = CAMERA3_TEMPLATE_STILL_CAPTURE;
+        scenario->reprocess = true;
+        scenario->streams.push_back(input);
+        scenario->streams.push_back(yuv);
+        scenario->streams.push_back(jpeg);
+        return true;
+    } else {
+        return false;
+    }
+
+    for (size_t i = 0; i < scenario->streams.size(); i++)
+        scenario->outputs.push_back(i);
+    return true;
+}
+
+int Benchmark::openDevice()
+{
+    char id[8];
+    snprintf(id, sizeof(id), "%d", mOptions.cameraId);
+
+    hw_device_t *device = nullptr;
+    int status = mModule->common.methods->open(&mModule->common, id, &device);
+    if (status != 0 || device == nullptr) {
+        fprintf(stderr, "failed to open camera %s (%d)\n", id, status);
+        return status != 0 ? status : -ENODEV;
+    }
+    mDevice = reinterpret_cast<camera3_device_t*>(device);
+
+    status = mDevice->ops->initialize(mDevice, this);
+    if (status != 0) {
+        fprintf(stderr, "failed to initialize camera %s (%d)\n", id, status);
+        closeDevice();
+    }
+    return status;
+}
+
+void Benchmark::closeDevice()
+{
+    if (mDevice == nullptr)
+        return;
+    mDevice->common.close(&mDevice->common);
+    mDevice = nullptr;
+}
+
+int Benchmark::submit(uint32_t frameNumber, int kind, const camera_metadata_t *settings,
+                      camera3_stream_buffer_t *input,
+                      std::vector<camera3_stream_buffer_t> &outputs)
+{
+    for (auto &out : outputs) {
+        out.buffer = mPools.at(out.stream)->acquire();
+        if (out.buffer == nullptr) {
+            fprintf(stderr, "frame %u: no buffer of stream %p came back\n",
+                    frameNumber, out.stream);
+            return -ETIMEDOUT;
+        }
+        out.status = CAMERA3_BUFFER_STATUS_OK;
+        out.acquire_fence = -1;
+        out.release_fence = -1;
+    }
+
+    camera3_capture_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.frame_number = frameNumber;
+    request.settings = settings;
+    request.input_buffer = input;
+    request.num_output_buffers = outputs.size();
+    request.output_buffers = outputs.data();
+
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        FrameRecord &frame = mFrames[frameNumber];
+        memset(&frame, 0, sizeof(frame));
+        frame.kind = kind;
+        frame.pendingBuffers = outputs.size();
+        frame.inputPending = input != nullptr;
+        frame.requestNs = nowNs();
+    }
+
+    // blocks while the HAL has as many requests in flight as it takes
+    int status = mDevice->ops->process_capture_request(mDevice, &request);
+    if (status != 0)
+        fprintf(stderr, "frame %u: process_capture_request failed (%d)\n",
+                frameNumber, status);
+    return status;
+}
+
+bool Benchmark::waitFrame(uint32_t frameNumber)
+{
+    std::unique_lock<std::mutex> l(mLock);
+    return mCond.wait_for(l, std::chrono::milliseconds(kResultTimeoutMs),
+                          [this, frameNumber] { return mFrames[frameNumber].finalNs != 0; });
+}
+
+bool Benchmark::waitAll()
+{
+    std::unique_lock<std::mutex> l(mLock);
+    while (mCompleted < mFrames.size()) {
+        uint32_t before = mCompleted;
+        // give up only when nothing at all comes back for a while
+        if (!mCond.wait_for(l, std::chrono::milliseconds(kResultTimeoutMs),
+                            [this, before] { return mCompleted != before; }))
+            return false;
+    }
+    return true;
+}
+
+std::string Benchmark::run(const Scenario &scenario)
+{
+    const char *error = nullptr;
+    int64_t cpuStart = cpuTimeNs(), cpuNs = 0;
+
+    mFrames.clear();
+    mCompleted = 0;
+    mPools.clear();
+    mInputPool = nullptr;
+
+    std::vector<camera3_stream_t> streams(scenario.streams.size());
+    std::vector<camera3_stream_t*> streamList;
+    for (size_t i = 0; i < scenario.streams.size(); i++) {
+        const StreamSpec &spec = scenario.streams[i];
+        camera3_stream_t &stream = streams[i];
+        memset(&stream, 0, sizeof(stream));
+        stream.stream_type = spec.streamType;
+        stream.width = spec.width;
+        stream.height = spec.height;
+        stream.format = spec.format;
+        stream.usage = spec.usage;
+        streamList.push_back(&stream);
+    }
+
+    camera3_stream_configuration_t config;
+    memset(&config, 0, sizeof(config));
+    config.num_streams = streamList.size();
+    config.streams = streamList.data();
+    config.operation_mode = CAMERA3_STREAM_CONFIGURATION_NORMAL_MODE;
+
+    if (openDevice() != 0)
+        return report(scenario, streams, 0, "open failed");
+
+    do {
+        if (mDevice->ops->configure_streams(mDevice, &config) != 0) {
+            error = "configure_streams failed";
+            break;
+        }
+
+        for (size_t i = 0; i < streams.size() && error == nullptr; i++) {
+            camera3_stream_t &stream = streams[i];
+            if (stream.stream_type == CAMERA3_STREAM_INPUT)
+                continue;
+            uint32_t usage = stream.usage;
+            uint32_t width = stream.width, height = stream.height;
+            if (stream.format == HAL_PIXEL_FORMAT_BLOB) {
+                width = mJpegMaxSize > 0 ? mJpegMaxSize : width * height * 3 / 2;
+                height = 1;
+            }
+            if (scenario.reprocess && stream.format == HAL_PIXEL_FORMAT_YCbCr_420_888)
+                usage |= streams[0].usage;
+            std::unique_ptr<BufferPool> pool(new BufferPool);
+            if (pool->allocate(&stream, std::max<int>(stream.max_buffers, 1),
+                               width, height, usage) != 0)
+                error = "buffer allocation failed";
+            mPools[&stream].reset(pool.release());
+        }
+        if (error != nullptr)
+            break;
+        if (scenario.reprocess)
+            mInputPool = mPools[&streams[1]].get();
+
+        const camera_metadata_t *settings =
+            mDevice->ops->construct_default_request_settings(mDevice,
+                                                             scenario.requestTemplate);
+        const camera_metadata_t *previewSettings =
+            mDevice->ops->construct_default_request_settings(mDevice,
+                                                             CAMERA3_TEMPLATE_PREVIEW);
+        if (settings == nullptr || previewSettings == nullptr) {
+            error = "no default request settings";
+            break;
+        }
+
+        uint32_t frameNumber = 0;
+        for (int i = 0; i < mOptions.warmup + mOptions.frames && error == nullptr; i++) {
+            if (i == mOptions.warmup)
+                cpuStart = cpuTimeNs();
+
+            if (!scenario.reprocess) {
+                std::vector<camera3_stream_buffer_t> outputs;
+                for (int s : scenario.outputs) {
+                    camera3_stream_buffer_t out;
+                    memset(&out, 0, sizeof(out));
+                    out.stream = &streams[s];
+                    outputs.push_back(out);
+                }
+                // null settings repeat the previous ones
+                if (submit(frameNumber++, KIND_CAPTURE, i == 0 ? settings : nullptr,
+                           nullptr, outputs) != 0)
+                    error = "request failed";
+                continue;
+            }
+
+            // capture a yuv frame, then reprocess it into a jpeg
+            std::vector<camera3_stream_buffer_t> outputs(1);
+            memset(&outputs[0], 0, sizeof(outputs[0]));
+            outputs[0].stream = &streams[1];
+            uint32_t captureFrame = frameNumber++;
+            if (submit(captureFrame, KIND_CAPTURE, previewSettings, nullptr, outputs) != 0) {
+                error = "request failed";
+                break;
+            }
+            if (!waitFrame(captureFrame)) {
+                error = "capture timed out";
+                break;
+            }
+            // the capture came back, take its buffer out of the pool again
+            buffer_handle_t *input = outputs[0].buffer;
+            if (!mInputPool->take(input)) {
+                error = "captured buffer not returned";
+                break;
+            }
+
+            camera3_stream_buffer_t inputBuffer;
+            memset(&inputBuffer, 0, sizeof(inputBuffer));
+            inputBuffer.stream = &streams[0];
+            inputBuffer.buffer = input;
+            inputBuffer.status = CAMERA3_BUFFER_STATUS_OK;
+            inputBuffer.acquire_fence = -1;
+            inputBuffer.release_fence = -1;
+            memset(&outputs[0], 0, sizeof(outputs[0]));
+            outputs[0].stream = &streams[2];
+            if (submit(frameNumber++, KIND_REPROCESS, settings, &inputBuffer, outputs) != 0)
+                error = "reprocess request failed";
+        }
+
+        if (error == nullptr && !waitAll())
+            error = "results timed out";
+        cpuNs = cpuTimeNs() - cpuStart;
+    } while (0);
+
+    if (mDevice != nullptr && mDevice->ops->flush != nullptr)
+        mDevice->ops->flush(mDevice);
+    closeDevice();
+
+    std::string json = report(scenario, streams, cpuNs, error);
+    mPools.clear();
+    return json;
+}
+
+std::string Benchmark::report(const Scenario &scenario,
+                              const std::vector<camera3_stream_t> &streams,
+                              int64_t cpuNs, const char *error)
+{
+    std::lock_guard<std::mutex> l(mLock);
+    std::string json;
+    char buf[512];
+
+    json += "    {\n      \"name\": \"" + scenario.name + "\",\n      \"streams\": [";
+    for (size_t i = 0; i < streams.size(); i++) {
+        snprintf(buf, sizeof(buf),
+                 "%s{\"type\": \"%s\", \"format\": %d, \"width\": %u, \"height\": %u, "
+                 "\"max_buffers\": %u}",
+                 i ? ", " : "",
+                 streams[i].stream_type == CAMERA3_STREAM_INPUT ? "input" : "output",
+                 streams[i].format, streams[i].width, streams[i].height,
+                 streams[i].max_buffers);
+        json += buf;
+    }
+    json += "],\n";
+
+    // steady state is everything after the warm up requests
+    uint32_t firstSteady = scenario.reprocess ? mOptions.warmup * 2 : mOptions.warmup;
+    std::vector<int64_t> shutter[KIND_COUNT], finalLatency[KIND_COUNT];
+    std::vector<int64_t> intervals, sensorIntervals;
+    int64_t firstDone = 0, lastDone = 0, prevDone = 0, prevSensor = 0;
+    int frames = 0, errors = 0, incomplete = 0;
+
+    for (auto &it : mFrames) {
+        const FrameRecord &frame = it.second;
+        if (frame.error)
+            errors++;
+        if (frame.finalNs == 0)
+            incomplete++;
+        if (it.first < firstSteady || frame.finalNs == 0)
+            continue;
+
+        if (frame.shutterNs != 0)
+            shutter[frame.kind].push_back(frame.shutterNs - frame.requestNs);
+        finalLatency[frame.kind].push_back(frame.finalNs - frame.requestNs);
+
+        // reprocess runs are paced by the jpegs they deliver
+        if (scenario.reprocess && frame.kind != KIND_REPROCESS)
+            continue;
+        if (prevDone != 0)
+            intervals.push_back(frame.finalNs - prevDone);
+        if (prevSensor != 0 && frame.sensorTs != 0)
+            sensorIntervals.push_back(frame.sensorTs - prevSensor);
+        prevDone = frame.finalNs;
+        prevSensor = frame.sensorTs;
+        if (firstDone == 0)
+            firstDone = frame.finalNs;
+        lastDone = frame.finalNs;
+        frames++;
+    }
+
+    double fps = lastDone > firstDone ? (frames - 1) * 1e9 / (lastDone - firstDone) : 0;
+    double cpuPerFrame = frames > 0 ? cpuNs / 1e6 / frames : 0;
+    double cpuLoad = lastDone > firstDone ? (double)cpuNs / (lastDone - firstDone) : 0;
+
+    snprintf(buf, sizeof(buf),
+             "      \"status\": \"%s\",\n"
+             "      \"requests\": %zu,\n"
+             "      \"warmup\": %d,\n"
+             "      \"frames\": %d,\n"
+             "      \"errors\": %d,\n"
+             "      \"incomplete\": %d,\n"
+             "      \"fps\": %.2f,\n"
+             "      \"cpu_ms_per_frame\": %.3f,\n"
+             "      \"cpu_load\": %.3f,\n",
+             error ? error : "ok", mFrames.size(), mOptions.warmup, frames, errors,
+             incomplete, fps, cpuPerFrame, cpuLoad);
+    json += buf;
+
+    json += "      \"latency_ms\": {";
+    bool first = true;
+    for (int k = 0; k < KIND_COUNT; k++) {
+        if (finalLatency[k].empty())
+            continue;
+        json += first ? "\n" : ",\n";
+        json += std::string("        \"") + kKindNames[k] + "\": {\n";
+        json += "          \"shutter\": " + Stats(shutter[k]).toJson() + ",\n";
+        json += "          \"final\": " + Stats(finalLatency[k]).toJson() + "\n        }";
+        first = false;
+    }
+    json += first ? "},\n" : "\n      },\n";
+    json += "      \"interval_ms\": " + Stats(intervals).toJson() + ",\n";
+    json += "      \"sensor_interval_ms\": " + Stats(sensorIntervals).toJson() + "\n";
+    json += "    }";
+    return json;
+}
+
+camera_module_t *loadModule(const char *path)
+{
+    if (path == nullptr) {
+        const hw_module_t *module = nullptr;
+        if (hw_get_module(CAMERA_HARDWARE_MODULE_ID, &module) != 0)
+            return nullptr;
+        return reinterpret_cast<camera_module_t*>(const_cast<hw_module_t*>(module));
+    }
+
+    void *handle = dlopen(path, RTLD_NOW);
+    if (handle == nullptr) {
+        fprintf(stderr, "dlopen %s: %s\n", path, dlerror());
+        return nullptr;
+    }
+    // the module stays loaded until exit
+    return static_cast<camera_module_t*>(dlsym(handle, HAL_MODULE_INFO_SYM_AS_STR));
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --scenario NAME  preview, preview_video, jpeg_burst, reprocess or all;\n"
+            "                   may be repeated, default all\n"
+            "  --frames N       measured requests per scenario, default 300\n"
+            "  --warmup N       requests before measuring, default 30\n"
+            "  --camera ID      default 0\n"
+            "  --preview WxH    default largest up to 1920x1080\n"
+            "  --video WxH      default largest up to 1920x1080\n"
+            "  --hal PATH       load the HAL from PATH instead of hw_get_module\n"
+            "  --virtual        run over the virtual kernel, no hardware needed\n"
+            "                   (debuggable builds only)\n"
+            "  --out FILE       write the report to FILE instead of stdout\n",
+            argv0);
+}
+
+bool parseOptions(int argc, char *argv[], Options *options)
+{
+    static const struct option longOptions[] = {
+        { "scenario", required_argument, nullptr, 's' },
+        { "frames",   required_argument, nullptr, 'n' },
+        { "warmup",   required_argument, nullptr, 'w' },
+        { "camera",   required_argument, nullptr, 'c' },
+        { "preview",  required_argument, nullptr, 'p' },
+        { "video",    required_argument, nullptr, 'v' },
+        { "hal",      required_argument, nullptr, 'l' },
+        { "virtual",  no_argument,       nullptr, 'V' },
+        { "out",      required_argument, nullptr, 'o' },
+        { "help",     no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    options->halPath = nullptr;
+    options->cameraId = 0;
+    options->frames = 300;
+    options->warmup = 30;
+    options->previewWidth = options->previewHeight = 0;
+    options->videoWidth = options->videoHeight = 0;
+    options->useVirtual = false;
+    options->outPath = nullptr;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+        case 's':
+            if (strcmp(optarg, "all") == 0) {
+                options->scenarios.insert(options->scenarios.end(),
+                    { "preview", "preview_video", "jpeg_burst", "reprocess" });
+            } else {
+                options->scenarios.push_back(optarg);
+            }
+            break;
+        case 'n':
+            options->frames = atoi(optarg);
+            break;
+        case 'w':
+            options->warmup = atoi(optarg);
+            break;
+        case 'c':
+            options->cameraId = atoi(optarg);
+            break;
+        case 'p':
+            if (!parseSize(optarg, &options->previewWidth, &options->previewHeight))
+                return false;
+            break;
+        case 'v':
+            if (!parseSize(optarg, &options->videoWidth, &options->videoHeight))
+                return false;
+            break;
+        case 'l':
+            options->halPath = optarg;
+            break;
+        case 'V':
+            options->useVirtual = true;
+            break;
+        case 'o':
+            options->outPath = optarg;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (options->scenarios.empty())
+        options->scenarios = { "preview", "preview_video", "jpeg_burst", "reprocess" };
+    return options->frames > 1 && options->warmup >= 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // must be set before the HAL probes the devices, restored on every return
+    std::unique_ptr<ScopedProperty> virtualKernel;
+    if (options.useVirtual) {
+        virtualKernel.reset(new ScopedProperty("vendor.camera.virtual", "1"));
+        if (!virtualKernel->isSet())
+            fprintf(stderr, "failed to enable the virtual kernel, using the devices\n");
+    }
+
+    camera_module_t *module = loadModule(options.halPath);
+    if (module == nullptr) {
+        fprintf(stderr, "camera HAL module not found\n");
+        return 1;
+    }
+    if (module->init != nullptr && module->common.module_api_version >=
+        CAMERA_MODULE_API_VERSION_2_4 && module->init() != 0) {
+        fprintf(stderr, "camera HAL module init failed\n");
+        return 1;
+    }
+
+    Benchmark benchmark(options, module);
+    if (benchmark.init() != 0)
+        return 1;
+
+    std::string json = "{\n";
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "  \"camera\": %d,\n  \"module\": \"%s\",\n  \"virtual\": %s,\n"
+             "  \"time\": %lld,\n  \"scenarios\": [\n",
+             options.cameraId, module->common.name,
+             options.useVirtual ? "true" : "false", (long long)time(nullptr));
+    json += buf;
+
+    int failed = 0;
+    for (size_t i = 0; i < options.scenarios.size(); i++) {
+        Scenario scenario;
+        if (!benchmark.buildScenario(options.scenarios[i], &scenario)) {
+            fprintf(stderr, "scenario %s not supported by camera %d\n",
+                    options.scenarios[i].c_str(), options.cameraId);
+            failed++;
+            continue;
+        }
+        fprintf(stderr, "running %s\n", scenario.name.c_str());
+        std::string result = benchmark.run(scenario);
+        if (result.find("\"status\": \"ok\"") == std::string::npos)
+            failed++;
+        if (json.back() == '}')
+            json += ",\n";
+        json += result;
+    }
+    json += "\n  ]\n}\n";
+
+    FILE *out = stdout;
+    if (options.outPath != nullptr) {
+        out = fopen(options.outPath, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "failed to open %s: %s\n", options.outPath, strerror(errno));
+            return 1;
+        }
+    }
+    fputs(json.c_str(), out);
+    if (out != stdout)
+        fclose(out);
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * camera_colorconvert_benchmark
+ *
+ * Runs every color conversion kernel set the CPU supports against the
+ * scalar reference, then times them:
+ *  conformance  each primitive on random data for every length up to
+ *               --max-len and at every source/destination misalignment up
+ *               to 15 bytes, output and guard bytes compared with scalar
+ *  throughput   each primitive over the rows of a --size frame, in MPix/s
+ *               (output elements per second)
+ * The report is JSON, like camera_hal_benchmark. The exit status is 2 if
+ * any kernel set disagrees with the reference.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ColorConvertKernels.h"
+
+USING_DECLARED_NAMESPACE;
+
+namespace {
+
+const int kGuard = 32;
+const int kMaxMisalign = 16;
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void fillRandom(std::vector<uint8_t> &buf, uint32_t seed)
+{
+    for (auto &b : buf) {
+        seed = seed * 1103515245 + 12345;
+        b = (seed >> 16) & 0xFF;
+    }
+}
+
+enum Primitive {
+    INTERLEAVE,
+    DEINTERLEAVE,
+    PICK2,
+    PICK4,
+    YUYV_TO_VU,
+    PRIMITIVE_MAX
+};
+
+const char *kPrimitiveNames[PRIMITIVE_MAX] = {
+    "interleave", "deinterleave", "pick2", "pick4", "yuyvToVU"
+};
+
+/*
+ * Runs |p| for |n| output elements, reading from |src| and writing |dst|
+ * (and |dst2| for deinterleave). Returns the bytes written to |dst|.
+ */
+int runPrimitive(const ColorConvertKernels &k, Primitive p, uint8_t *dst,
+                 uint8_t *dst2, const uint8_t *src, int offset, int n)
+{
+    switch (p) {
+    case INTERLEAVE:
+        k.interleave(dst, src, src + n, n);
+        return 2 * n;
+    case DEINTERLEAVE:
+        k.deinterleave(dst, dst2, src, n);
+        return n;
+    case PICK2:
+        k.pick2(dst, src, n);
+        return n;
+    case PICK4:
+        k.pick4(dst, src, offset, n);
+        return n;
+    case YUYV_TO_VU:
+        k.yuyvToVU(dst, src, n);
+        return 2 * n;
+    default:
+        return 0;
+    }
+}
+
+/* compares |k| with the scalar kernels, returns the number of mismatches */
+int checkConformance(const ColorConvertKernels &k, int maxLen, std::string &firstError)
+{
+    const ColorConvertKernels &ref = getScalarColorConvertKernels();
+    int errors = 0;
+    size_t srcSize = 4 * maxLen + kMaxMisalign + kGuard;
+    size_t dstSize = 2 * maxLen + kMaxMisalign + 2 * kGuard;
+    std::vector<uint8_t> src(srcSize);
+    std::vector<uint8_t> out(dstSize), out2(dstSize), expect(dstSize), expect2(dstSize);
+
+    for (int p = 0; p < PRIMITIVE_MAX; p++) {
+        for (int n = 0; n <= maxLen; n++) {
+            for (int mis = 0; mis < kMaxMisalign; mis++) {
+                fillRandom(src, n * 131 + mis * 7 + p);
+                for (int offset = 0; offset < (p == PICK4 ? 4 : 1); offset++) {
+                    // guard bytes catch writes past the n elements
+                    std::fill(out.begin(), out.end(), 0xA5);
+                    std::fill(out2.begin(), out2.end(), 0xA5);
+                    std::fill(expect.begin(), expect.end(), 0xA5);
+                    std::fill(expect2.begin(), expect2.end(), 0xA5);
+                    runPrimitive(ref, (Primitive)p, expect.data() + kGuard + mis,
+                                 expect2.data() + kGuard + mis, src.data() + mis,
+                                 offset, n);
+                    runPrimitive(k, (Primitive)p, out.data() + kGuard + mis,
+                                 out2.data() + kGuard + mis, src.data() + mis,
+                                 offset, n);
+                    if (out == expect && out2 == expect2)
+                        continue;
+                    if (errors++ == 0) {
+                        char buf[128];
+                        snprintf(buf, sizeof(buf), "%s n=%d misalign=%d offset=%d",
+                                 kPrimitiveNames[p], n, mis, offset);
+                        firstError = buf;
+                    }
+                }
+            }
+        }
+    }
+
+    return errors;
+}
+
+/* output elements per second over |rows| rows of |width| */
+double measureThroughput(const ColorConvertKernels &k, Primitive p, int width,
+                         int rows, int iterations)
+{
+    std::vector<uint8_t> src(4 * width * rows + kGuard);
+    std::vector<uint8_t> dst(2 * width * rows + kGuard), dst2(width * rows + kGuard);
+    fillRandom(src, 1);
+
+    // warm the caches and the page tables
+    for (int r = 0; r < rows; r++)
+        runPrimitive(k, p, dst.data() + 2 * width * r, dst2.data() + width * r,
+                     src.data() + 4 * width * r, 1, width);
+
+    int64_t start = nowNs();
+    for (int i = 0; i < iterations; i++) {
+        for (int r = 0; r < rows; r++)
+            runPrimitive(k, p, dst.data() + 2 * width * r, dst2.data() + width * r,
+                         src.data() + 4 * width * r, 1, width);
+    }
+    int64_t elapsed = nowNs() - start;
+
+    return elapsed > 0 ? (double)width * rows * iterations * 1e9 / elapsed : 0;
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --size WxH        frame timed, default 4208x3120\n"
+            "  --iterations N    frames per measurement, default 5\n"
+            "  --max-len N       longest row checked, default 256\n"
+            "  --out FILE        write the report to FILE instead of stdout\n",
+            argv0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    static const struct option longOptions[] = {
+        { "size",       required_argument, nullptr, 's' },
+        { "iterations", required_argument, nullptr, 'n' },
+        { "max-len",    required_argument, nullptr, 'l' },
+        { "out",        required_argument, nullptr, 'o' },
+        { "help",       no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int width = 4208, height = 3120;
+    int iterations = 5;
+    int maxLen = 256;
+    const char *outPath = nullptr;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+        case 's':
+            if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'l':
+            maxLen = atoi(optarg);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || iterations < 1 || maxLen < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<const ColorConvertKernels*> kernels = getSupportedColorConvertKernels();
+    // the primitives work on one plane row, chroma rows are half as many
+    int rows = height / 2;
+
+    std::string json;
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\n  \"width\": %d,\n  \"rows\": %d,\n  \"iterations\": %d,\n"
+             "  \"max_len\": %d,\n  \"selected\": \"%s\",\n  \"kernels\": [\n",
+             width, rows, iterations, maxLen, getColorConvertKernels().name);
+    json += buf;
+
+    bool allMatch = true;
+    std::vector<double> scalarRate(PRIMITIVE_MAX, 0);
+    for (size_t i = 0; i < kernels.size(); i++) {
+        const ColorConvertKernels &k = *kernels[i];
+        std::string firstError;
+        int errors = i == 0 ? 0 : checkConformance(k, maxLen, firstError);
+        allMatch = allMatch && errors == 0;
+
+        snprintf(buf, sizeof(buf),
+                 "%s    {\"name\": \"%s\", \"mismatches\": %d, \"first_mismatch\": \"%s\",\n"
+                 "     \"mpix_per_sec\": {",
+                 i > 0 ? ",\n" : "", k.name, errors, firstError.c_str());
+        json += buf;
+        fprintf(stderr, "%s: %s\n", k.name,
+                errors ? ("MISMATCH " + firstError).c_str() : "matches scalar");
+
+        for (int p = 0; p < PRIMITIVE_MAX; p++) {
+            double rate = measureThroughput(k, (Primitive)p, width, rows, iterations);
+            if (i == 0)
+                scalarRate[p] = rate;
+            snprintf(buf, sizeof(buf), "%s\"%s\": %.1f", p > 0 ? ", " : "",
+                     kPrimitiveNames[p], rate / 1e6);
+            json += buf;
+            fprintf(stderr, "    %-12s %8.1f MPix/s  x%.2f\n", kPrimitiveNames[p],
+                    rate / 1e6, scalarRate[p] > 0 ? rate / scalarRate[p] : 0);
+        }
+        json += "}}";
+    }
+    json += "\n  ]\n}\n";
+
+    FILE *file = stdout;
+    if (outPath != nullptr) {
+        file = fopen(outPath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "failed to open %s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+    fputs(json.c_str(), file);
+    if (file != stdout)
+        fclose(file);
+
+    return allMatch ? 0 : 2;
+}
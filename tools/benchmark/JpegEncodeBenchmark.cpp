@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * camera_jpeg_benchmark
+ *
+ * Times the software JPEG encoder of the HAL (JpegStripEncoder) on one
+ * YU12, NV12 or NV21 image for every strip count from 1 up to the stripe
+ * pool size, and checks the output of each run against encodes of the YU12
+ * image:
+ *  1 strip    identical to JpegCompressor::CompressImage()
+ *  N strips   identical to one compressor writing a restart marker after
+ *             every MCU row
+ * The semi-planar layouts only match when the width is a multiple of 16,
+ * below that the YU12 encode reads past the chroma rows.
+ * The report is JSON, like camera_hal_benchmark.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "JpegStripEncoder.h"
+#include "StripeExecutor.h"
+
+USING_DECLARED_NAMESPACE;
+
+namespace {
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* gradients with some noise, so the entropy coder has work to do */
+void makeImage(std::vector<uint8_t> &image, int width, int height)
+{
+    uint32_t seed = 1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            image[y * width + x] = (x * 3 + y * 5 + ((seed >> 16) & 31)) & 0xFF;
+        }
+    }
+    for (size_t i = width * height; i < image.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (i * 7 + ((seed >> 16) & 15)) & 0xFF;
+    }
+}
+
+/* YU12 to the semi-planar layouts, U first for NV12 */
+void interleaveChroma(std::vector<uint8_t> &image, int width, int height, bool nv21)
+{
+    size_t quarter = width * height / 4;
+    std::vector<uint8_t> chroma(image.begin() + width * height, image.end());
+    uint8_t *dst = image.data() + width * height;
+    for (size_t i = 0; i < quarter; i++) {
+        dst[2 * i] = chroma[nv21 ? quarter + i : i];
+        dst[2 * i + 1] = chroma[nv21 ? i : quarter + i];
+    }
+}
+
+bool readImage(const char *path, std::vector<uint8_t> &image)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    size_t n = fread(image.data(), 1, image.size(), file);
+    fclose(file);
+    if (n != image.size()) {
+        fprintf(stderr, "%s holds %zu bytes, a YU12 frame needs %zu\n",
+                path, n, image.size());
+        return false;
+    }
+    return true;
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --size WxH        image size, default 4208x3120\n"
+            "  --input FILE      YU12 frame of that size, default a generated one\n"
+            "  --format F        layout handed to the encoder: yu12 (default),\n"
+            "                    nv12 or nv21\n"
+            "  --quality Q       default 95\n"
+            "  --iterations N    encodes per strip count, default 10\n"
+            "  --max-strips N    default the stripe pool size\n"
+            "  --out FILE        write the report to FILE instead of stdout\n",
+            argv0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    static const struct option longOptions[] = {
+        { "size",       required_argument, nullptr, 's' },
+        { "input",      required_argument, nullptr, 'i' },
+        { "format",     required_argument, nullptr, 'f' },
+        { "quality",    required_argument, nullptr, 'q' },
+        { "iterations", required_argument, nullptr, 'n' },
+        { "max-strips", required_argument, nullptr, 'm' },
+        { "out",        required_argument, nullptr, 'o' },
+        { "help",       no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int width = 4208, height = 3120;
+    int quality = 95;
+    int iterations = 10;
+    int maxStrips = StripeExecutor::concurrency();
+    const char *inputPath = nullptr;
+    const char *outPath = nullptr;
+    std::string format = "yu12";
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+        case 's':
+            if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'i':
+            inputPath = optarg;
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 'q':
+            quality = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'm':
+            maxStrips = atoi(optarg);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || width % 8 || height % 2 ||
+        quality < 1 || quality > 100 || iterations < 1 || maxStrips < 1 ||
+        (format != "yu12" && format != "nv12" && format != "nv21")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> image(width * height * 3 / 2);
+    if (inputPath != nullptr) {
+        if (!readImage(inputPath, image))
+            return 1;
+    } else {
+        makeImage(image, width, height);
+    }
+
+    // references for the byte comparison
+    uint32_t outSize = image.size() + 65536;
+    std::vector<uint8_t> plain(outSize), restart(outSize), out(outSize);
+    uint32_t plainSize = 0, restartSize = 0;
+    arc::JpegCompressor reference;
+    if (!reference.CompressImage(image.data(), width, height, quality, nullptr, 0,
+                                 outSize, plain.data(), &plainSize) ||
+        !reference.CompressStrip(arc::YuvImage::FromYU12(image.data(), width, height),
+                                 0, height, quality, (width + 15) / 16, nullptr, 0,
+                                 outSize, restart.data(), &restartSize)) {
+        fprintf(stderr, "reference encode failed\n");
+        return 1;
+    }
+
+    arc::YuvImage input = arc::YuvImage::FromYU12(image.data(), width, height);
+    if (format != "yu12") {
+        interleaveChroma(image, width, height, format == "nv21");
+        input.layout = format == "nv12" ? arc::YuvImage::NV12 : arc::YuvImage::NV21;
+    }
+
+    std::string json;
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\n  \"width\": %d,\n  \"height\": %d,\n  \"format\": \"%s\",\n"
+             "  \"quality\": %d,\n  \"iterations\": %d,\n  \"pool_threads\": %d,\n"
+             "  \"runs\": [\n",
+             width, height, format.c_str(), quality, iterations,
+             StripeExecutor::concurrency());
+    json += buf;
+
+    arc::JpegCompressor compressor;
+    JpegStripEncoder encoder;
+    bool allMatch = true;
+    double singleMs = 0;
+    for (int strips = 1; strips <= maxStrips; strips++) {
+        std::vector<int64_t> times;
+        uint32_t size = 0;
+        bool ok = true;
+        for (int i = 0; i < iterations && ok; i++) {
+            int64_t start = nowNs();
+            ok = encoder.compress(compressor, input, quality, strips,
+                                  nullptr, 0, outSize, out.data(), &size);
+            times.push_back(nowNs() - start);
+        }
+
+        const std::vector<uint8_t> &expected = strips == 1 ? plain : restart;
+        uint32_t expectedSize = strips == 1 ? plainSize : restartSize;
+        bool match = ok && size == expectedSize &&
+                     memcmp(out.data(), expected.data(), size) == 0;
+        allMatch = allMatch && match;
+
+        std::sort(times.begin(), times.end());
+        double sum = 0;
+        for (int64_t t : times)
+            sum += t;
+        double meanMs = sum / times.size() / 1e6;
+        if (strips == 1)
+            singleMs = meanMs;
+
+        snprintf(buf, sizeof(buf),
+                 "%s    {\"strips\": %d, \"ok\": %s, \"matches_reference\": %s, "
+                 "\"bytes\": %u, \"mean_ms\": %.2f, \"min_ms\": %.2f, "
+                 "\"p50_ms\": %.2f, \"max_ms\": %.2f, \"speedup\": %.2f}",
+                 strips > 1 ? ",\n" : "", strips, ok ? "true" : "false",
+                 match ? "true" : "false", size, meanMs, times.front() / 1e6,
+                 times[times.size() / 2] / 1e6, times.back() / 1e6,
+                 meanMs > 0 ? singleMs / meanMs : 0);
+        json += buf;
+        fprintf(stderr, "%d strips: %.2f ms%s\n", strips, meanMs,
+                match ? "" : " OUTPUT MISMATCH");
+    }
+    json += "\n  ]\n}\n";
+
+    FILE *file = stdout;
+    if (outPath != nullptr) {
+        file = fopen(outPath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "failed to open %s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+    fputs(json.c_str(), file);
+    if (file != stdout)
+        fclose(file);
+
+    return allMatch ? 0 : 2;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2017, Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * camera_msgqueue_benchmark
+ *
+ * Compares the two MessageQueue backends, the mutex protected list and the
+ * SPSC ring, with one producer and one consumer thread:
+ *  burst   the producer sends back to back, reports the throughput
+ *  paced   the producer sends one message every --period-us, so the
+ *          consumer is asleep when it arrives like the HAL threads at frame
+ *          rate, reports the send to receive latency
+ * Messages carry a shared_ptr like the HAL messages do. Every message is
+ * checked to arrive once and in order. The report is JSON, like
+ * camera_hal_benchmark.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MessageQueue.h"
+
+USING_DECLARED_NAMESPACE;
+
+namespace {
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+enum MessageId {
+    MESSAGE_ID_DATA = 0,
+    MESSAGE_ID_MAX
+};
+
+struct Message {
+    MessageId id;
+    unsigned int seq;
+    int64_t sentNs;
+    std::shared_ptr<int> payload;
+};
+
+struct Result {
+    bool ok;
+    double msgsPerSec;
+    double p50Us;
+    double p99Us;
+    double maxUs;
+};
+
+/* one producer, one consumer, |periodUs| 0 sends back to back */
+Result run(unsigned int ringCapacity, int count, int periodUs)
+{
+    MessageQueue<Message, MessageId> queue("BenchQueue", 0, ringCapacity);
+    std::shared_ptr<int> payload = std::make_shared<int>(0);
+    std::vector<int64_t> latencies(count);
+    Result result = { true, 0, 0, 0, 0 };
+
+    int64_t start = nowNs();
+    std::thread producer([&] {
+        int64_t next = nowNs();
+        for (int i = 0; i < count; i++) {
+            if (periodUs) {
+                next += periodUs * 1000LL;
+                while (nowNs() < next)
+                    std::this_thread::sleep_for(std::chrono::microseconds(
+                            std::max<int64_t>((next - nowNs()) / 1000, 1)));
+            }
+            Message msg;
+            msg.id = MESSAGE_ID_DATA;
+            msg.seq = i;
+            msg.payload = payload;
+            msg.sentNs = nowNs();
+            queue.send(&msg);
+        }
+    });
+
+    for (int i = 0; i < count; i++) {
+        Message msg;
+        queue.receive(&msg);
+        latencies[i] = nowNs() - msg.sentNs;
+        if (msg.seq != (unsigned int)i || msg.payload != payload)
+            result.ok = false;
+    }
+    int64_t elapsed = nowNs() - start;
+    producer.join();
+
+    // the queue must not keep references to received messages
+    if (payload.use_count() != 1)
+        result.ok = false;
+
+    std::sort(latencies.begin(), latencies.end());
+    result.msgsPerSec = elapsed > 0 ? count * 1e9 / elapsed : 0;
+    result.p50Us = latencies[count / 2] / 1e3;
+    result.p99Us = latencies[(size_t)count * 99 / 100] / 1e3;
+    result.maxUs = latencies.back() / 1e3;
+    return result;
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --count N         messages per burst run, default 1000000\n"
+            "  --paced-count N   messages per paced run, default 2000\n"
+            "  --period-us N     paced send period, default 1000\n"
+            "  --ring N          ring capacity, default 16\n"
+            "  --out FILE        write the report to FILE instead of stdout\n",
+            argv0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    static const struct option longOptions[] = {
+        { "count",       required_argument, nullptr, 'c' },
+        { "paced-count", required_argument, nullptr, 'p' },
+        { "period-us",   required_argument, nullptr, 't' },
+        { "ring",        required_argument, nullptr, 'r' },
+        { "out",         required_argument, nullptr, 'o' },
+        { "help",        no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int count = 1000000;
+    int pacedCount = 2000;
+    int periodUs = 1000;
+    int ringCapacity = 16;
+    const char *outPath = nullptr;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+        case 'c':
+            count = atoi(optarg);
+            break;
+        case 'p':
+            pacedCount = atoi(optarg);
+            break;
+        case 't':
+            periodUs = atoi(optarg);
+            break;
+        case 'r':
+            ringCapacity = atoi(optarg);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (count < 1 || pacedCount < 1 || periodUs < 1 || ringCapacity < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string json;
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\n  \"count\": %d,\n  \"paced_count\": %d,\n  \"period_us\": %d,\n"
+             "  \"ring_capacity\": %d,\n  \"runs\": [\n",
+             count, pacedCount, periodUs, ringCapacity);
+    json += buf;
+
+    bool allOk = true;
+    bool first = true;
+    for (const char *mode : { "burst", "paced" }) {
+        bool paced = strcmp(mode, "paced") == 0;
+        for (unsigned int ring : { 0u, (unsigned int)ringCapacity }) {
+            Result r = run(ring, paced ? pacedCount : count, paced ? periodUs : 0);
+            allOk = allOk && r.ok;
+            snprintf(buf, sizeof(buf),
+                     "%s    {\"mode\": \"%s\", \"backend\": \"%s\", \"ok\": %s, "
+                     "\"msgs_per_sec\": %.0f, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+                     "\"max_us\": %.2f}",
+                     first ? "" : ",\n", mode, ring ? "ring" : "list",
+                     r.ok ? "true" : "false", r.msgsPerSec, r.p50Us, r.p99Us,
+                     r.maxUs);
+            json += buf;
+            first = false;
+            fprintf(stderr, "%s %s: %.0f msgs/s, p50 %.2f us, p99 %.2f us%s\n",
+                    mode, ring ? "ring" : "list", r.msgsPerSec, r.p50Us, r.p99Us,
+                    r.ok ? "" : " ORDER OR REFERENCE ERROR");
+        }
+    }
+    json += "\n  ]\n}\n";
+
+    FILE *file = stdout;
+    if (outPath != nullptr) {
+        file = fopen(outPath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "failed to open %s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+    fputs(json.c_str(), file);
+    if (file != stdout)
+        fclose(file);
+
+    return allOk ? 0 : 2;
+}